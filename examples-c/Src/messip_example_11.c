@@ -0,0 +1,203 @@
+/**
+ * @file messip_example_11.c
+ *
+ **/
+
+/**
+ * @mainpage messip - Examples programs - No. 11
+ *
+ * MessIP : Message Passing over TCP/IP \n
+ * Copyright (C) 2001-2007  Olivier Singla \n
+ * http://messip.sourceforge.net/ \n\n
+ *
+ * Server:
+ * - connect to the messip manager
+ * - create 3 channels ('red', 'green', 'blue'), and put them in a channel set
+ * - receive the messages of all the channels with a single call, without polling
+ * - reply back to each message on the channel it has been received on
+ *
+ * Client:
+ * - connect to the messip manager
+ * - locate the 3 channels
+ * - send 3 messages on each channel, without waiting for the replies (asynchronous sends)
+ * - then wait for the 9 replies, in whatever order they come back
+ *
+ **/
+
+#define _XOPEN_SOURCE 500
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <assert.h>
+#include <sys/wait.h>
+
+#include "messip.h"
+
+static time_t now0 = 0;
+#include "example_utils.h"
+
+#define NB_CHANNELS		3
+#define NB_SENDS		3		// Per channel
+
+static const char *names[NB_CHANNELS] = { "red", "green", "blue" };
+
+/**
+ *  Server-side function
+ *
+ *  @param argc Number of arguments
+ *  @param argv List of the arguments (array)
+ *  @return 0 if no error
+ */
+static int server( int argc, char *argv[] ) {
+	messip_channel_t	*chs[NB_CHANNELS];
+	messip_channel_t	*ch;
+	char				rec_buff[ 80 ];
+	char				reply_buff[ 80 ];
+	int32_t				type;
+	int					index, n;
+	int					nb_received = 0, nb_disconnected = 0;
+
+	/*--- Connect to the messip manager ---*/
+	display( "Server", "Start process\n" );
+	messip_init( );
+	messip_id_t id;
+	strcpy( id, "ex11/p1" );
+    messip_cnx_t *cnx = messip_connect( NULL, id, MESSIP_NOTIMEOUT );
+    if ( !cnx ) {
+        cancel( "Unable to find messip manager\n" );
+    }
+
+	/*--- Create the channels, all of them in one set ---*/
+	messip_channelset_t *set = messip_channelset_create( );
+	if ( !set )
+		cancel( "Unable to create a channel set\n" );
+	for ( n = 0; n < NB_CHANNELS; n++ ) {
+		chs[n] = messip_channel_create( cnx, names[n], MESSIP_NOTIMEOUT, 0 );
+		if ( !chs[n] )
+			cancel( "Unable to create channel '%s'\n", names[n] );
+		if ( messip_channelset_add( set, chs[n] ) == -1 )
+			cancel( "Unable to add channel '%s' to the set\n", names[n] );
+	}
+	display( "Server", "%d channels created\n", NB_CHANNELS );
+
+	/*--- Receive on all the channels, until the client has gone ---*/
+	while ( nb_disconnected < NB_CHANNELS ) {
+		memset( rec_buff, 0, sizeof( rec_buff ) );
+		index = messip_channelset_receive( set, &ch, &type, rec_buff, sizeof( rec_buff ), 30000 );
+		if ( index == MESSIP_MSG_TIMEOUT )
+			cancel( "No message received within 30 seconds\n" );
+		if ( index == -1 ) {
+			fprintf( stderr, "Error on receive message on the channel set\n" );
+			return -1;
+		}
+		if ( ( index == MESSIP_MSG_DISCONNECT ) || ( index == MESSIP_MSG_DISMISSED ) ) {
+			display( "Server", "client disconnected from channel '%s'\n", ch->name );
+			nb_disconnected++;
+			continue;
+		}
+		if ( index < 0 )
+			continue;
+		display( "Server", "received '%s' type=%d on channel '%s' index=%d\n",
+			rec_buff, type, ch->name, index );
+		assert( !strcmp( rec_buff, ch->name ) );
+		sprintf( reply_buff, "%s-%d", ch->name, type );
+		messip_reply( ch, index, type * 10, reply_buff, strlen( reply_buff ) + 1, MESSIP_NOTIMEOUT );
+		nb_received++;
+	}
+	assert( nb_received == NB_CHANNELS * NB_SENDS );
+
+	/*--- Done ---*/
+	messip_channelset_destroy( set );
+	for ( n = 0; n < NB_CHANNELS; n++ )
+		messip_channel_delete( chs[n], MESSIP_NOTIMEOUT );
+	display( "Server", "End process\n" );
+	return 0;
+}                               // server
+
+/**
+ *  Client-side function
+ *
+ *  @param argc Number of arguments
+ *  @param argv List of the arguments (array)
+ *  @return 0 if no error
+ */
+static int client( int argc, char *argv[] ) {
+	messip_channel_t	*chs[NB_CHANNELS];
+	messip_request_t	*reqs[NB_CHANNELS * NB_SENDS];
+	char				rec_buff[NB_CHANNELS * NB_SENDS][ 80 ];
+	char				expected[ 80 ];
+	int					n, k;
+
+	/*--- Connect to the messip manager ---*/
+	messip_init( );
+	display( "Client", "start process\n" );
+	messip_id_t id;
+	strcpy( id, "ex11/p2" );
+    messip_cnx_t *cnx = messip_connect( NULL, id, MESSIP_NOTIMEOUT );
+    if ( !cnx ) {
+        cancel( "Unable to find messip manager\n" );
+    }
+
+	/*--- Localize the channels ---*/
+	for ( n = 0; n < NB_CHANNELS; n++ ) {
+		chs[n] = NULL;
+		for ( time_t t0 = time( NULL ); time( NULL ) - t0 < 10; ) {
+			chs[n] = messip_channel_connect( cnx, names[n], MESSIP_NOTIMEOUT );
+			if ( chs[n] )
+				break;
+			sleep( 1 );
+		}
+		if ( !chs[n] )
+			cancel( "Unable to localize channel '%s'\n", names[n] );
+	}
+	display( "Client", "%d channels located\n", NB_CHANNELS );
+
+	/*--- Send all the messages, without waiting for any reply ---*/
+	for ( k = 0; k < NB_CHANNELS * NB_SENDS; k++ ) {
+		n = k % NB_CHANNELS;
+		reqs[k] = messip_send_async( chs[n], k, ( void * ) names[n], strlen( names[n] ) + 1,
+			rec_buff[k], sizeof( rec_buff[k] ) );
+		if ( !reqs[k] )
+			cancel( "Unable to send message %d on channel '%s'\n", k, names[n] );
+	}
+	display( "Client", "%d messages sent\n", NB_CHANNELS * NB_SENDS );
+
+	/*--- Then collect the replies, as they complete ---*/
+	for ( int nb_replies = 0; nb_replies < NB_CHANNELS * NB_SENDS; nb_replies++ ) {
+		k = messip_wait( reqs, NB_CHANNELS * NB_SENDS, 10000 );
+		if ( k == MESSIP_MSG_TIMEOUT )
+			cancel( "No reply received within 10 seconds\n" );
+		if ( k == -1 )
+			cancel( "Error while waiting for the replies (errno=%d)\n", errno );
+		display( "Client", "reply to message %d: status=%d answer=%d '%s'\n",
+			k, reqs[k]->status, reqs[k]->answer, rec_buff[k] );
+		sprintf( expected, "%s-%d", names[k % NB_CHANNELS], k );
+		assert( reqs[k]->status == 0 );
+		assert( reqs[k]->answer == k * 10 );
+		assert( !strcmp( rec_buff[k], expected ) );
+		messip_request_release( reqs[k] );
+		reqs[k] = NULL;
+	}
+
+	/*--- Disconnect from the channels ---*/
+	for ( n = 0; n < NB_CHANNELS; n++ )
+		messip_channel_disconnect( chs[n], MESSIP_NOTIMEOUT );
+
+	display( "Client", "End process\n" );
+	return 0;
+}                               // client
+
+/**
+ *  Main function
+ *
+ *  @param argc Number of arguments
+ *  @param argv List of the arguments (array)
+ *  @return 0 if no error
+ */
+int main( int argc, char *argv[] ) {
+    return exec_server_client( argc, argv, server, client );
+}                               // main
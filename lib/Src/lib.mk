@@ -1,10 +1,10 @@
 include ../common.mk
 
-OBJS = messip_utils.o messip_lib.o 
+OBJS = messip_utils.o messip_lib.o messip_uring.o messip_shm.o messip_pool.o messip_timer.o messip_sockbuf.o messip_wire.o
 TARGET = libmessip.so
 LIBS = 
 CFLAGS += $(if $(filter 1 YES, $(DEBUG)), -g -O0, -g0 -O2)
-CFLAGS += -D TIMER_USE_SIGEV_THREAD=0 -D TIMER_USE_SIGEV_SIGNAL=1
+CFLAGS += -D MESSIP_USE_IO_URING=1
 CFLAGS += -fPIC
 LDFLAGS += 
 include ../compile.mk	
@@ -13,6 +13,7 @@
 #include <unistd.h>
 #include <sys/select.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -54,6 +55,7 @@ typedef int SOCKET;
 
 #define	MESSIP_MAXLEN_ID 8
 #define	MESSIP_CHANNEL_NAME_MAXLEN	47
+#define	MESSIP_SUN_PATH_MAXLEN	32	// Abstract AF_UNIX name, without its leading NUL
 
 typedef char messip_id_t[MESSIP_MAXLEN_ID + 1];
 
@@ -65,6 +67,7 @@ typedef struct messip_cnx {
     SOCKET sockfd;
     messip_id_t remote_id;
     struct messip_cnx *prev;
+    pthread_mutex_t lock;       // Serializes the requests sent to the messip manager
 } messip_cnx_t;
 
 
@@ -73,8 +76,10 @@ typedef struct messip_channel_t {
     messip_cnx_t *cnx;
     int32_t f_already_connected;
     messip_id_t remote_id;
-    int32_t recv_sockfd_sz;
-    SOCKET recv_sockfd[FD_SETSIZE];
+    int32_t recv_sockfd_sz;     // Nb of sockets registered in epoll_fd (listening socket included)
+    SOCKET recv_sockfd;         // Listening socket
+    SOCKET recv_sockfd_unix;    // Listening socket for same-host clients (abstract AF_UNIX), or -1
+    int epoll_fd;               // Receive engine: listening socket + accepted client sockets
     int remote_port;
     in_port_t sin_port;
     in_addr_t sin_addr;
@@ -86,11 +91,66 @@ typedef struct messip_channel_t {
     int32_t datalen;            // Length of data transmitted
     int32_t datalenr;           // Length of data read
     void **receive_allmsg;      // Dynamic buffer, if receive buffer was to small
-    int *receive_allmsg_sz;     // Size allocated for these Dynamic buffer
-    int nb_timers;
-    int mgr_sockfd;             // Socket in the messip_mgr
+    int *receive_allmsg_sz;     // Size allocated for these Dynamic buffer (size of the message)
+    int32_t *receive_offset;    // Bytes of each message already given to the server
+    int32_t *receive_flag;      // Flag of each message not replied yet (MESSIP_FLAG_BUFFERED: not acknowledged yet)
+    uint32_t *receive_reqid;    // Request id of each message not replied yet
+    int32_t *receive_sender;    // Number of the sender of each message not replied yet (compact header), or -1 (legacy)
+    int32_t *slots_next;        // Next free index, after each free index (-1: last one)
+    uint64_t slots_free;        // Free indexes: ABA tag (32 high bits), first free index + 1 (32 low bits, 0: none)
+    int32_t serve;              // Server: several threads receive and reply at the same time (messip_channel_set_serve)
+    SOCKET *rx_ready;           // Server: sockets whose next message is read ahead already (epoll does not report it)
+    int32_t nb_rx_ready;
+    int32_t rx_ready_sz;
+    int32_t receive_mode;       // MESSIP_RECEIVE_COPY or MESSIP_RECEIVE_LAZY
+    int32_t buffered_unacked;   // Server: buffered messages received, not acknowledged yet...
+    SOCKET buffered_unacked_sockfd; // ...on this socket
+    int32_t buffered_unacked_sender;    // ...from this sender (compact header), or -1 (legacy)
+    int32_t buffered_mode;      // Client: MESSIP_BUFFERED_MANAGER or MESSIP_BUFFERED_DIRECT
+    int32_t buffered_credits;   // Client: buffered messages which can be sent directly, without waiting
+    struct messip_pool *pool;   // Buffers allocated by the library, or NULL (heap)
+    struct messip_timer_queue *timers;  // Server: expirations of the timers created on the channel, or NULL
+    uint64_t mgr_handle;        // Handle of the channel in the messip_mgr
+    struct messip_uring *uring; // io_uring engine, or NULL (plain socket calls)
+    struct messip_shm *shm;     // Shared-memory transport (same host), or NULL
+    int32_t shm_slot;           // Client: slot owned in the shared-memory segment
+    int32_t *new_shm_slot;      // Server: slot of each message not replied yet, or -1
+    uint32_t next_reqid;        // Client: id of the last asynchronous send
+    int32_t wire_version;       // Client: headers on the socket (MESSIP_WIRE_UNKNOWN until the first send)
+    int32_t wire_sender;        // Client: number given by the server, sent in the compact headers
+    struct messip_wire_ids *wire_ids;   // Server: ids of the clients using the compact headers, by number
+    char sun_path[MESSIP_SUN_PATH_MAXLEN];  // Client: AF_UNIX socket of the server (same host), or ""
+    struct messip_threads *threads; // Client: connection of each sending thread (thread-safe mode), or NULL
+    struct messip_request *requests;    // Client: asynchronous sends waiting for their reply, oldest first
 } messip_channel_t;
 
+/*
+ * Set of channels, to receive on all of them at the same time (messip_channelset_receive)
+ */
+typedef struct messip_channelset {
+    int epoll_fd;               // Watches the epoll instance of each channel
+    int nb_channels;
+    messip_channel_t **channels;
+} messip_channelset_t;
+
+/*
+ * Asynchronous send (messip_send_async), in flight or complete
+ */
+typedef struct messip_request {
+    struct messip_channel_t *ch;
+    uint32_t reqid;             // Sent with the message, and back with the reply
+    int32_t done;               // Complete: replied, or failed
+    int32_t status;             // 0 if replied, -1 if an error occurred
+    int32_t error;              // errno, if status is -1
+    int32_t answer;             // Answer of the server
+    int32_t datalen;            // Length of the reply sent by the server
+    int32_t datalenr;           // Length of the reply stored into reply_buffer
+    void *reply_buffer;
+    int32_t reply_maxlen;
+    int32_t released;           // Released before its reply came: discarded then
+    struct messip_request *next;
+} messip_request_t;
+
 #  define MESSIP_MSG_DISCONNECT		-2
 #  define MESSIP_MSG_DISMISSED		-3
 #  define MESSIP_MSG_TIMEOUT			-4
@@ -98,6 +158,16 @@ typedef struct messip_channel_t {
 #  define MESSIP_MSG_NOREPLY			-6
 #  define MESSIP_MSG_DEATH_PROCESS	-7
 
+/*
+ * Header of a message, returned by messip_receive_header()
+ */
+typedef struct {
+    int32_t type;
+    int32_t datalen;            // Length of the payload
+    messip_id_t id;             // Sender
+    int32_t noreply;            // Asynchronous message (messip_buffered_send): no reply expected
+} messip_msginfo_t;
+
 
 // -----------------------
 // Prototypes of functions
@@ -105,6 +175,17 @@ typedef struct messip_channel_t {
 
 #  define MESSIP_NOTIMEOUT		-1
 
+#  define MESSIP_ENGINE_SOCKET		0
+#  define MESSIP_ENGINE_IO_URING	1
+
+#  define MESSIP_RECEIVE_COPY		0	// Whole message kept until messip_reply() (default)
+#  define MESSIP_RECEIVE_LAZY		1	// Part not fitting the buffer is read by messip_receive_more()
+
+#  define MESSIP_BUFFERED_MANAGER	0	// Asynchronous messages are queued by the messip manager (default)
+#  define MESSIP_BUFFERED_DIRECT	1	// Sent straight to the server, with credit-based flow control
+
+#  define MESSIP_IOV_MAX			16	// Segments of a message given to messip_sendv() or messip_replyv()
+
 #  ifdef __cplusplus
 extern "C" {
 #  endif
@@ -124,16 +205,71 @@ extern "C" {
 
     int messip_channel_ping( messip_channel_t * ch, int msec_timeout );
 
+    int messip_channel_set_engine( messip_channel_t * ch, int engine );
+
+    int messip_channel_enable_shm( messip_channel_t * ch, int nb_slots, int slot_size );
+
+    int messip_channel_set_receive_mode( messip_channel_t * ch, int mode );
+
+    int messip_channel_set_buffered_mode( messip_channel_t * ch, int mode );
+
+    int messip_channel_enable_pool( messip_channel_t * ch );
+
+    void messip_buffer_release( messip_channel_t * ch, void *buffer );
+
+    int messip_channel_set_threadsafe( messip_channel_t * ch );
+
+    int messip_channel_set_serve( messip_channel_t * ch, int nb_slots );
+
+    messip_channel_t *messip_channel_self( messip_channel_t * ch );
+
     int messip_receive( messip_channel_t * ch, int32_t *type, void *buffer, int maxlen, int msec_timeout );
 
+    int messip_receive_more( messip_channel_t * ch, int index, void *buffer, int maxlen );
+
+    int messip_receive_header( messip_channel_t * ch, messip_msginfo_t * info, int msec_timeout );
+
+    int messip_receive_payload( messip_channel_t * ch, int index, const struct iovec *iov, int iovcnt );
+
+    messip_channelset_t *messip_channelset_create( void );
+
+    void messip_channelset_destroy( messip_channelset_t * set );
+
+    int messip_channelset_add( messip_channelset_t * set, messip_channel_t * ch );
+
+    int messip_channelset_remove( messip_channelset_t * set, messip_channel_t * ch );
+
+    int messip_channelset_receive( messip_channelset_t * set, messip_channel_t ** ch,
+       int32_t *type, void *rec_buffer, int maxlen, int msec_timeout );
+
     int messip_reply( messip_channel_t * ch, int index, int32_t answer, void *reply_buffer, int reply_len, int msec_timeout );
 
+    int messip_replyv( messip_channel_t * ch, int index, int32_t answer,
+       const struct iovec *reply_iov, int reply_iovcnt, int msec_timeout );
+
     int messip_send( messip_channel_t * ch,
        int32_t type,
        void *send_buffer, int send_len, int32_t *answer, void *reply_buffer, int reply_maxlen, int msec_timeout );
 
+    int messip_sendv( messip_channel_t * ch,
+       int32_t type,
+       const struct iovec *send_iov, int send_iovcnt, int32_t *answer, void *reply_buffer, int reply_maxlen, int msec_timeout );
+
+    messip_request_t *messip_send_async( messip_channel_t * ch,
+       int32_t type, void *send_buffer, int send_len, void *reply_buffer, int reply_maxlen );
+
+    messip_request_t *messip_sendv_async( messip_channel_t * ch,
+       int32_t type, const struct iovec *send_iov, int send_iovcnt, void *reply_buffer, int reply_maxlen );
+
+    int messip_wait( messip_request_t ** requests, int nb_requests, int msec_timeout );
+
+    void messip_request_release( messip_request_t * req );
+
     int32_t messip_buffered_send( messip_channel_t * ch, int32_t type, void *send_buffer, int send_len, int msec_timeout );
 
+    int32_t messip_buffered_sendv( messip_channel_t * ch, int32_t type,
+       const struct iovec *send_iov, int send_iovcnt, int msec_timeout );
+
     timer_t messip_timer_create( messip_channel_t * ch, int32_t type, int msec_1st_shot, int msec_rep_shot, int msec_timeout );
 
     int messip_timer_delete( messip_channel_t * ch, timer_t timer_id );
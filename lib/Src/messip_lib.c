@@ -40,8 +40,10 @@
  * A channel is identified by a name, which must be unique over the whole network. It’s perfectly fine to create several channels 
  * for a given process, but because you can receive messages on one specific channel and this operation is (usually) blocking 
  * (i.e. you’ll usually wait until you get a message over this channel), in practice a thread will create and manage only 
- * a channel at a time. In the future, it will be possible to receive messages on several channels at the same time. Note that you could poll, 
- * but it’s often not very efficient.
+ * a channel at a time. To receive messages on several channels at the same time, put them into a set 
+ * (see messip_channelset_create) and wait with messip_channelset_receive - there is no polling involved.
+ * Conversely, several threads can serve the same channel, each one receiving and replying on its own 
+ * (see messip_channel_set_serve).
  * 
  * Prior to send any message to a server (whatever it is a Synchronous or an Asynchronous Message), a client must find the channel. 
  * That means that the server must know the name that identifies the channel. In order to be able to further communicate with the server, 
@@ -66,7 +68,9 @@
  *    Because of this, there is no reply from the server. Therefore, you can’t assume that the message has been received by the server. 
  *    When the server has created the channel (where he receive messages), he has specified a parameter which is the maximum number 
  *    of messages that can be buffered. Asynchronous Message are slower than Synchronous Message because they are copied twice: 
- *    from the client to the Messip manager, then from the Messip manager to the server.
+ *    from the client to the Messip manager, then from the Messip manager to the server. 
+ *    Unless the client selects MESSIP_BUFFERED_DIRECT (see messip_channel_set_buffered_mode): its Asynchronous Messages are 
+ *    then sent straight to the server, as Synchronous Messages are, and the manager is not involved.
  * 
  * @see messip_disconnect(), messip_channel_create(), messip_channel_disconnect()
  **/
@@ -80,34 +84,48 @@
 #include <string.h>
 #include <fcntl.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/un.h>
+#include <poll.h>
 
 #include "messip.h"
 #include "messip_private.h"
 
 #include "messip_utils.h"
-
-#if !defined(TIMER_USE_SIGEV_THREAD) || !defined(TIMER_USE_SIGEV_SIGNAL)
-#error Both TIMER_USE_SIGEV_THREAD and TIMER_USE_SIGEV_SIGNAL must be defined !
-#endif
-
-#if (TIMER_USE_SIGEV_THREAD!=0) && (TIMER_USE_SIGEV_THREAD!=1)
-#error TIMER_USE_SIGEV_THREAD must be either 0 or 1 !
-#endif
-
-#if (TIMER_USE_SIGEV_SIGNAL!=0) && (TIMER_USE_SIGEV_SIGNAL!=1)
-#error TIMER_USE_SIGEV_SIGNAL must be either 0 or 1 !
-#endif
-
-#if (TIMER_USE_SIGEV_THREAD==TIMER_USE_SIGEV_SIGNAL)
-#error Either TIMER_USE_SIGEV_THREAD and TIMER_USE_SIGEV_SIGNAL must be set !
-#endif
-
-typedef struct list_connect_s {
-    char name[MESSIP_CHANNEL_NAME_MAXLEN + 1];	///< TBD
-    messip_channel_t *info;						///< TBD
-} list_connect_t;
-static list_connect_t *list_connect;	///< TBD
-static int nb_list_connect;				///< TBD
+#include "messip_uring.h"
+#include "messip_shm.h"
+#include "messip_pool.h"
+#include "messip_timer.h"
+#include "messip_sockbuf.h"
+#include "messip_wire.h"
+
+static messip_hash_t *list_connect;	///< Connections to channels, by name of channel
+static pthread_mutex_t list_connect_mutex = PTHREAD_MUTEX_INITIALIZER;	///< Protects list_connect
+
+/*
+ * Thread-safe mode of a channel (see messip_channel_set_threadsafe): 
+ * each sending thread has its own copy of the channel, with its own socket
+ */
+typedef struct thread_cnx {
+    messip_channel_t ch;        // Copy of the channel, used by one thread at a time
+    struct messip_threads *threads;
+    struct thread_cnx *next_free;   // Connections of the threads which have exited
+    struct thread_cnx *next;    // All the connections
+} thread_cnx_t;
+
+struct messip_threads {
+    pthread_key_t key;          // Connection of the calling thread
+    pthread_mutex_t mutex;
+    thread_cnx_t *free;
+    thread_cnx_t *all;
+    char sun_path[MESSIP_SUN_PATH_MAXLEN];  // Server's AF_UNIX socket, or "" (TCP/IP)
+};
+
+static int buffered_credits_wait( messip_channel_t *ch, int wanted, int msec_timeout );
+static int datareply_read( messip_channel_t *ch, messip_datareply_t *datareply, uint32_t *reqid );
+static int shm_attach( messip_channel_t *ch, int msec_timeout );
 
 static unsigned log_level = MESSIP_LOG_ERROR | MESSIP_LOG_WARNING;	///< TBD
 
@@ -122,7 +140,6 @@ static unsigned log_level = MESSIP_LOG_ERROR | MESSIP_LOG_WARNING;	///< TBD
  */
 void messip_init( void ) { 
     list_connect = NULL ;
-    nb_list_connect = 0;
 }                               // messip_init
 
 /**
@@ -208,6 +225,418 @@ int messip_select( int fd, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
     return status;
 }                               // messip_select
 
+/**
+ * Wait until a socket is ready for reading or writing
+ * 
+ * Unlike select(), this works whatever the value of the file descriptor
+ * (i.e. also beyond FD_SETSIZE). This function handles EINTR.
+ * 
+ * @param sockfd Socket file descriptor
+ * @param events POLLIN or POLLOUT
+ * @param msec_timeout Timeout expressed in milliseconds, or MESSIP_NOTIMEOUT
+ * @return
+ *  - 1 if the socket is ready
+ *  - 0 if the operation timed out
+ *  - -1 if an error occurred (errno is set)
+ */
+int messip_wait_ready( SOCKET sockfd, short events, int msec_timeout ) {
+    struct pollfd pfd;
+    int status;
+
+    pfd.fd = sockfd;
+    pfd.events = events;
+    do {
+        status = poll( &pfd, 1, ( msec_timeout == MESSIP_NOTIMEOUT ) ? -1 : msec_timeout );
+    } while ( ( status == -1 ) && ( errno == EINTR ) );
+    return status;
+}                               // messip_wait_ready
+
+/**
+ * Register a socket into the receive engine of a channel
+ * 
+ * @param epoll_fd epoll instance owned by the channel
+ * @param sockfd Socket file descriptor to watch for input
+ * @return 0 if no error, or -1 if an error occurred (errno is set)
+ */
+static int epoll_add( int epoll_fd, SOCKET sockfd ) {
+    struct epoll_event event;
+    memset( &event, 0, sizeof( event ) );
+    event.events = EPOLLIN;
+    event.data.fd = sockfd;
+    return epoll_ctl( epoll_fd, EPOLL_CTL_ADD, sockfd, &event );
+}                               // epoll_add
+
+/**
+ * A client socket can deliver its next message: remember it if this message has been read ahead
+ * already (see messip_sockbuf_readv), since epoll does not report the socket anymore. 
+ * Serve mode does not read ahead.
+ * 
+ * @param ch Channel owning the socket
+ * @param sockfd Socket file descriptor
+ */
+static void channel_read_ahead( messip_channel_t *ch, SOCKET sockfd ) {
+    SOCKET *rx_ready;
+    int n;
+
+    if ( ch->serve || ( messip_sockbuf_pending( sockfd ) == 0 ) )
+        return;
+    for ( n = 0; n < ch->nb_rx_ready; n++ )
+        if ( ch->rx_ready[n] == sockfd )
+            return;
+    if ( ch->nb_rx_ready == ch->rx_ready_sz ) {
+        rx_ready = ( SOCKET * ) realloc( ch->rx_ready, sizeof( SOCKET ) * ( ch->rx_ready_sz + 8 ) );
+        if ( rx_ready == NULL )
+            return;
+        ch->rx_ready = rx_ready;
+        ch->rx_ready_sz += 8;
+    }
+    ch->rx_ready[ch->nb_rx_ready++] = sockfd;
+}                               // channel_read_ahead
+
+/**
+ * Forget a socket remembered by channel_read_ahead(): it is being read, or closed
+ * 
+ * @param ch Channel owning the socket
+ * @param sockfd Socket file descriptor
+ */
+static void channel_read_ahead_done( messip_channel_t *ch, SOCKET sockfd ) {
+    for ( int n = 0; n < ch->nb_rx_ready; n++ ) {
+        if ( ch->rx_ready[n] == sockfd ) {
+            ch->rx_ready[n] = ch->rx_ready[--ch->nb_rx_ready];
+            return;
+        }
+    }                           // for (n)
+}                               // channel_read_ahead_done
+
+/**
+ * Remove a client socket from the receive engine of a channel, then close it
+ * (its slot in the shared-memory segment, if any, is released)
+ * 
+ * @param ch Channel owning the socket
+ * @param sockfd Socket file descriptor
+ */
+static void channel_close_socket( messip_channel_t *ch, SOCKET sockfd ) {
+    if ( ch->buffered_unacked_sockfd == sockfd )
+        ch->buffered_unacked = 0;
+    if ( ch->shm != NULL )
+        messip_shm_slot_release( ch->shm, sockfd );
+    epoll_ctl( ch->epoll_fd, EPOLL_CTL_DEL, sockfd, NULL );
+    channel_read_ahead_done( ch, sockfd );
+    messip_sockbuf_reset( sockfd );
+    if ( ch->uring != NULL )
+        messip_uring_forget( ch->uring, sockfd );
+    shutdown( sockfd, SHUT_RDWR );
+    closesocket( sockfd );
+    __atomic_sub_fetch( &ch->recv_sockfd_sz, 1, __ATOMIC_RELAXED );
+}                               // channel_close_socket
+
+/**
+ * Delete all the timers of a channel, and stop watching the timerfd
+ * 
+ * @param ch Channel which was returned by messip_channel_create()
+ */
+static void channel_timers_release( messip_channel_t *ch ) {
+    if ( ch->timers == NULL )
+        return;
+    epoll_ctl( ch->epoll_fd, EPOLL_CTL_DEL, messip_timer_engine_fd(  ), NULL );
+    epoll_ctl( ch->epoll_fd, EPOLL_CTL_DEL, messip_timer_queue_fd( ch->timers ), NULL );
+    messip_timer_queue_destroy( ch->timers );
+    ch->timers = NULL;
+}                               // channel_timers_release
+
+/**
+ * Watch a socket accepted by a channel. In serve mode, the socket is reported to one 
+ * receiving thread only (EPOLLONESHOT), and is not reported anymore until channel_rearm().
+ * 
+ * @param ch Channel owning the socket
+ * @param sockfd Socket file descriptor
+ * @return 0 if no error, or -1 if an error occurred (errno is set)
+ */
+static int channel_watch( messip_channel_t *ch, SOCKET sockfd ) {
+    struct epoll_event event;
+    memset( &event, 0, sizeof( event ) );
+    event.events = ( ch->serve ) ? EPOLLIN | EPOLLONESHOT : EPOLLIN;
+    event.data.fd = sockfd;
+    return epoll_ctl( ch->epoll_fd, EPOLL_CTL_ADD, sockfd, &event );
+}                               // channel_watch
+
+/**
+ * Serve mode: report again a socket whose message has been handled (replied, acknowledged...), 
+ * so that the next message on it goes to whichever thread is receiving. 
+ * Otherwise the socket is always watched: only a message read ahead has to be remembered.
+ * 
+ * @param ch Channel owning the socket
+ * @param sockfd Socket file descriptor (listening or accepted)
+ */
+static void channel_rearm( messip_channel_t *ch, SOCKET sockfd ) {
+    struct epoll_event event;
+    if ( !ch->serve ) {
+        channel_read_ahead( ch, sockfd );
+        return;
+    }
+    memset( &event, 0, sizeof( event ) );
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.fd = sockfd;
+    epoll_ctl( ch->epoll_fd, EPOLL_CTL_MOD, sockfd, &event );
+}                               // channel_rearm
+
+/**
+ * Give back an index returned by messip_receive() (lock-free, several threads can do it at the same time)
+ * 
+ * @param ch Channel returned by messip_channel_create()
+ * @param index Index which is not used anymore
+ */
+static void slot_put( messip_channel_t *ch, int index ) {
+    uint64_t head, next;
+
+    ch->new_sockfd[index] = -1;
+    head = __atomic_load_n( &ch->slots_free, __ATOMIC_ACQUIRE );
+    do {
+        __atomic_store_n( &ch->slots_next[index], ( int32_t ) ( uint32_t ) head - 1, __ATOMIC_RELAXED );
+        next = ( ( ( head >> 32 ) + 1 ) << 32 ) | ( uint32_t ) ( index + 1 );
+    } while ( !__atomic_compare_exchange_n( &ch->slots_free, &head, next, 1, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE ) );
+}                               // slot_put
+
+/**
+ * Add indexes to a channel (none of them is in use then, unless in serve mode, where
+ * this is done before the threads start to receive)
+ * 
+ * @param ch Channel returned by messip_channel_create()
+ * @param nb_slots New number of indexes
+ * @return 0 if no error, or -1 if out of memory (errno is set)
+ */
+static int slots_grow( messip_channel_t *ch, int nb_slots ) {
+    int k;
+
+#define SLOTS_REALLOC( array ) \
+    do { \
+        void *p = realloc( ch->array, nb_slots * sizeof( *ch->array ) ); \
+        if ( p == NULL ) { \
+            errno = ENOMEM; \
+            return -1; \
+        } \
+        ch->array = p; \
+    } while ( 0 )
+
+    SLOTS_REALLOC( new_sockfd );
+    SLOTS_REALLOC( new_shm_slot );
+    SLOTS_REALLOC( receive_allmsg );
+    SLOTS_REALLOC( receive_allmsg_sz );
+    SLOTS_REALLOC( receive_offset );
+    SLOTS_REALLOC( receive_flag );
+    SLOTS_REALLOC( receive_reqid );
+    SLOTS_REALLOC( receive_sender );
+    SLOTS_REALLOC( slots_next );
+#undef SLOTS_REALLOC
+
+    for ( k = ch->new_sockfd_sz; k < nb_slots; k++ ) {
+        ch->new_shm_slot[k] = -1;
+        ch->receive_allmsg[k] = NULL;
+        ch->receive_allmsg_sz[k] = 0;
+        ch->receive_offset[k] = 0;
+        ch->receive_flag[k] = 0;
+        ch->receive_reqid[k] = 0;
+        ch->receive_sender[k] = -1;
+    }
+    for ( k = nb_slots - 1; k >= ch->new_sockfd_sz; k-- )
+        slot_put( ch, k );
+    ch->new_sockfd_sz = nb_slots;
+    return 0;
+}                               // slots_grow
+
+/**
+ * Free the arrays allocated by slots_grow()
+ * 
+ * @param ch Channel returned by messip_channel_create()
+ */
+static void slots_release( messip_channel_t *ch ) {
+    free( ch->new_sockfd );
+    free( ch->new_shm_slot );
+    free( ch->receive_allmsg );
+    free( ch->receive_allmsg_sz );
+    free( ch->receive_offset );
+    free( ch->receive_flag );
+    free( ch->receive_reqid );
+    free( ch->receive_sender );
+    free( ch->slots_next );
+}                               // slots_release
+
+/**
+ * Get an index, to be returned by messip_receive() (lock-free, several threads can do it at the same time)
+ * 
+ * @param ch Channel returned by messip_channel_create()
+ * @return The index, or -1 if none is free (errno is set: ENOBUFS in serve mode, where the
+ *    number of indexes is fixed, ENOMEM otherwise)
+ */
+static int slot_get( messip_channel_t *ch ) {
+    uint64_t head, next;
+    int index;
+
+    head = __atomic_load_n( &ch->slots_free, __ATOMIC_ACQUIRE );
+    for ( ;; ) {
+        if ( ( uint32_t ) head == 0 ) {
+            if ( ch->serve ) {
+                errno = ENOBUFS;
+                return -1;
+            }
+            if ( slots_grow( ch, ch->new_sockfd_sz + 1 ) == -1 )
+                return -1;
+            head = __atomic_load_n( &ch->slots_free, __ATOMIC_ACQUIRE );
+            continue;
+        }
+        index = ( uint32_t ) head - 1;
+        next = ( ( ( head >> 32 ) + 1 ) << 32 )
+           | ( uint32_t ) ( __atomic_load_n( &ch->slots_next[index], __ATOMIC_RELAXED ) + 1 );
+        if ( __atomic_compare_exchange_n( &ch->slots_free, &head, next, 1, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE ) )
+            return index;
+    }                           // for (;;)
+}                               // slot_get
+
+/**
+ * Total length of the segments of a message
+ * 
+ * @param iov Segments
+ * @param iovcnt Number of segments
+ * @return Number of bytes
+ */
+static size_t iov_length( const struct iovec *iov, int iovcnt ) {
+    size_t len = 0;
+    for ( int n = 0; n < iovcnt; n++ )
+        len += iov[n].iov_len;
+    return len;
+}                               // iov_length
+
+/**
+ * Compute when a timeout expires
+ * 
+ * @param deadline Set to the expiration date (CLOCK_MONOTONIC)
+ * @param msec_timeout Timeout expressed in milliseconds, 0, or MESSIP_NOTIMEOUT
+ */
+static void deadline_set( struct timespec *deadline, int msec_timeout ) {
+    if ( msec_timeout <= 0 )
+        return;
+    clock_gettime( CLOCK_MONOTONIC, deadline );
+    deadline->tv_sec += msec_timeout / 1000;
+    deadline->tv_nsec += ( msec_timeout % 1000 ) * 1000000L;
+    if ( deadline->tv_nsec >= 1000000000L ) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}                               // deadline_set
+
+/**
+ * Time left before a timeout expires, to give to poll() or epoll_wait()
+ * 
+ * @param deadline Set by deadline_set()
+ * @param msec_timeout Timeout given to deadline_set()
+ * @return Milliseconds left (0 once expired), or -1 if there is no timeout
+ */
+static int deadline_remaining( const struct timespec *deadline, int msec_timeout ) {
+    struct timespec now;
+    long msec;
+
+    if ( msec_timeout == MESSIP_NOTIMEOUT )
+        return -1;
+    if ( msec_timeout <= 0 )
+        return 0;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    msec = ( deadline->tv_sec - now.tv_sec ) * 1000 + ( deadline->tv_nsec - now.tv_nsec ) / 1000000L;
+    return ( msec > 0 ) ? msec : 0;
+}                               // deadline_remaining
+
+/**
+ * Fill in the header of a message returned by messip_receive_header()
+ * 
+ * @param info Header to fill in
+ * @param datasend Message received
+ */
+static void msginfo_set( messip_msginfo_t *info, const messip_datasend_t *datasend ) {
+    info->type = datasend->type;
+    info->datalen = datasend->datalen;
+    IDCPY( info->id, datasend->id );
+    info->noreply = ( datasend->flag == MESSIP_FLAG_BUFFERED );
+}                               // msginfo_set
+
+/**
+ * Allocate a buffer on behalf of the caller, or to keep a message until messip_reply()
+ * 
+ * @param ch Channel
+ * @param size Size of the buffer
+ * @return The buffer, or NULL if an error occurred
+ */
+static void *buffer_alloc( messip_channel_t *ch, size_t size ) {
+    if ( ch->pool != NULL )
+        return messip_pool_alloc( ch->pool, size );
+    return malloc( size );
+}                               // buffer_alloc
+
+/**
+ * Free a buffer returned by buffer_alloc()
+ * 
+ * @param ch Channel
+ * @param buffer Buffer to free (NULL is valid)
+ */
+static void buffer_free( messip_channel_t *ch, void *buffer ) {
+    if ( ch->pool != NULL )
+        messip_pool_release( buffer );
+    else
+        free( buffer );
+}                               // buffer_free
+
+/**
+ * Create the listening socket used by same-host clients: an abstract AF_UNIX socket,
+ * whose name is chosen by the kernel (autobind)
+ * 
+ * @param name Set to the abstract name of the socket, without its leading NUL
+ * @return The listening socket, or -1 if an error occurred (errno is set)
+ */
+static SOCKET listen_unix( char name[MESSIP_SUN_PATH_MAXLEN] ) {
+    struct sockaddr_un sun_addr;
+    socklen_t sun_len;
+
+    SOCKET sockfd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+    if ( sockfd < 0 )
+        return -1;
+    memset( &sun_addr, 0, sizeof( sun_addr ) );
+    sun_addr.sun_family = AF_UNIX;
+    sun_len = sizeof( sun_addr );
+    if ( ( bind( sockfd, ( struct sockaddr * ) &sun_addr, sizeof( sa_family_t ) ) < 0 )
+       || ( getsockname( sockfd, ( struct sockaddr * ) &sun_addr, &sun_len ) < 0 )
+       || ( sun_len <= offsetof( struct sockaddr_un, sun_path ) + 1 )
+       || ( sun_len - offsetof( struct sockaddr_un, sun_path ) - 1 >= MESSIP_SUN_PATH_MAXLEN )
+       || ( listen( sockfd, 8 ) < 0 ) ) {
+        closesocket( sockfd );
+        return -1;
+    }
+    sun_len -= offsetof( struct sockaddr_un, sun_path ) + 1;
+    memcpy( name, &sun_addr.sun_path[1], sun_len );
+    name[sun_len] = 0;
+    return sockfd;
+}                               // listen_unix
+
+/**
+ * Connect to the abstract AF_UNIX socket of a channel owned by a server running on the same host
+ * 
+ * @param name Abstract name of the socket, without its leading NUL
+ * @return The connected socket, or -1 if an error occurred (errno is set)
+ */
+static SOCKET connect_unix( const char *name ) {
+    struct sockaddr_un sun_addr;
+    size_t len = strlen( name );
+
+    SOCKET sockfd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+    if ( sockfd < 0 )
+        return -1;
+    memset( &sun_addr, 0, sizeof( sun_addr ) );
+    sun_addr.sun_family = AF_UNIX;
+    memcpy( &sun_addr.sun_path[1], name, len );
+    if ( connect( sockfd, ( const struct sockaddr * ) &sun_addr, offsetof( struct sockaddr_un, sun_path ) + 1 + len ) < 0 ) {
+        closesocket( sockfd );
+        return -1;
+    }
+    return sockfd;
+}                               // connect_unix
+
 /**
  * Connection to the messip manager (messip_mgr) 
  * 
@@ -222,6 +651,7 @@ int messip_select( int fd, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
  * @return  A pointer to a messip_cnx_t structure (that will be used next on a channel creation or connection),
  *	or -1 if an error occurred (errno is set).
  * - ETIMEDOUT Occurs if the messip manager did not answer the connection request within the provided time.
+ * - ENOMEM Occurs if the messip manager is out of memory.
  * 
  * @note From the same thread, only one connection to the messip manager will be allowed.
  * 
@@ -257,6 +687,7 @@ messip_cnx_t *messip_connect( char *mgr_ref, messip_id_t const id, int msec_time
     if ( cnx == NULL )
         return NULL;
     memset( cnx, 0, sizeof( messip_cnx_t ) );
+    pthread_mutex_init( &cnx->lock, NULL );
 
     /*--- Create socket ---*/
     cnx->sockfd = socket( AF_INET, SOCK_STREAM, 0 );
@@ -288,15 +719,7 @@ messip_cnx_t *messip_connect( char *mgr_ref, messip_id_t const id, int msec_time
     int status = connect( cnx->sockfd, ( const struct sockaddr * ) &server, sizeof( server ) );
     if ( ( msec_timeout != MESSIP_NOTIMEOUT ) && ( status ) ) {
         if ( errno == EINPROGRESS ) {
-            fd_set ready;
-            FD_ZERO( &ready );
-            FD_SET( cnx->sockfd, &ready );
-            struct timeval tv;
-            tv.tv_sec = msec_timeout / 1000;
-            tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-            status = select( ( int ) cnx->sockfd + 1, NULL, &ready, NULL, &tv );    // <&>
-            assert( status != -1 );
-            if ( !FD_ISSET( cnx->sockfd, &ready ) ) {
+            if ( messip_wait_ready( cnx->sockfd, POLLOUT, msec_timeout ) <= 0 ) {
                 closesocket( cnx->sockfd );
                 free( cnx );
                 errno = ETIMEDOUT;
@@ -322,15 +745,7 @@ messip_cnx_t *messip_connect( char *mgr_ref, messip_id_t const id, int msec_time
 
     /*--- Ready to write ? ---*/
     if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        fd_set ready;
-        FD_ZERO( &ready );
-        FD_SET( cnx->sockfd, &ready );
-        struct timeval tv;
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) cnx->sockfd + 1, NULL, &ready, NULL, &tv );    // <&>
-        assert( status != -1 );
-        if ( !FD_ISSET( cnx->sockfd, &ready ) ) {
+        if ( messip_wait_ready( cnx->sockfd, POLLOUT, msec_timeout ) <= 0 ) {
             closesocket( cnx->sockfd );
             free( cnx );
             errno = ETIMEDOUT;
@@ -353,15 +768,7 @@ messip_cnx_t *messip_connect( char *mgr_ref, messip_id_t const id, int msec_time
 
     /*--- Ready to read ? ---*/
     if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        fd_set ready;
-        FD_ZERO( &ready );
-        FD_SET( cnx->sockfd, &ready );
-        struct timeval tv;
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) cnx->sockfd, &ready, NULL, NULL, &tv );    // <&>
-        assert( status != -1 );
-        if ( !FD_ISSET( cnx->sockfd, &ready ) ) {
+        if ( messip_wait_ready( cnx->sockfd, POLLIN, msec_timeout ) <= 0 ) {
             closesocket( cnx->sockfd );
             free( cnx );
             errno = ETIMEDOUT;
@@ -375,7 +782,14 @@ messip_cnx_t *messip_connect( char *mgr_ref, messip_id_t const id, int msec_time
     iovec[0].iov_len = sizeof( reply );
     status = messip_readv( cnx->sockfd, iovec, 1 );
     assert( status == sizeof( messip_reply_connect_t ) );
-    assert( reply.ok == MESSIP_OK );
+
+    /*--- The messip manager is out of memory ? ---*/
+    if ( reply.ok != MESSIP_OK ) {
+        closesocket( cnx->sockfd );
+        free( cnx );
+        errno = ENOMEM;
+        return NULL;
+    }
     IDCPY( cnx->remote_id, id );
 
     // Ok
@@ -431,9 +845,6 @@ messip_channel_t *messip_channel_create( messip_cnx_t *cnx, const char *name, in
     struct sockaddr_in sock_name;
     socklen_t sock_namelen;
     messip_channel_t *ch;
-    fd_set ready;
-    struct timeval tv;
-    int k;
     int32_t op;
     messip_send_channel_create_t msgsend;
     messip_reply_channel_create_t reply;
@@ -468,16 +879,38 @@ messip_channel_t *messip_channel_create( messip_cnx_t *cnx, const char *name, in
 
     listen( sockfd, 8 );
 
+    /*--- Same-host clients will rather connect on an abstract AF_UNIX socket ---*/
+    SOCKET sockfd_unix = listen_unix( msgsend.sun_path );
+    if ( sockfd_unix == -1 )
+        msgsend.sun_path[0] = 0;
+    strcpy( msgsend.host_ident, get_host_ident(  ) );
+
+    /*--- Allocate the channel first: the messip manager then has nothing to undo if memory is short ---*/
+    ch = ( messip_channel_t * ) calloc( 1, sizeof( messip_channel_t ) );
+    if ( ( ch == NULL ) || ( slots_grow( ch, 1 ) == -1 ) ) {
+        if ( ch != NULL ) {
+            slots_release( ch );
+            free( ch );
+        }
+        closesocket( sockfd );
+        if ( sockfd_unix != -1 )
+            closesocket( sockfd_unix );
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    /*--- Other threads may be talking to the messip manager too ---*/
+    pthread_mutex_lock( &cnx->lock );
+
     /*--- Ready to write ? ---*/
     if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( cnx->sockfd, &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) cnx->sockfd + 1, NULL, &ready, NULL, &tv );    // <&>
-        assert( status != -1 );
-        if ( !FD_ISSET( cnx->sockfd, &ready ) ) {
+        if ( messip_wait_ready( cnx->sockfd, POLLOUT, msec_timeout ) <= 0 ) {
+            pthread_mutex_unlock( &cnx->lock );
+            slots_release( ch );
+            free( ch );
             closesocket( sockfd );
+            if ( sockfd_unix != -1 )
+                closesocket( sockfd_unix );
             errno = ETIMEDOUT;
             return NULL;
         }
@@ -502,14 +935,13 @@ messip_channel_t *messip_channel_create( messip_cnx_t *cnx, const char *name, in
 
     /*--- Ready to read ? ---*/
     if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( cnx->sockfd, &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) cnx->sockfd + 1, &ready, NULL, NULL, &tv );    // <&>
-        assert( status != -1 );
-        if ( !FD_ISSET( cnx->sockfd, &ready ) ) {
+        if ( messip_wait_ready( cnx->sockfd, POLLIN, msec_timeout ) <= 0 ) {
+            pthread_mutex_unlock( &cnx->lock );
+            slots_release( ch );
+            free( ch );
             closesocket( sockfd );
+            if ( sockfd_unix != -1 )
+                closesocket( sockfd_unix );
             errno = ETIMEDOUT;
             return NULL;
         }
@@ -519,36 +951,76 @@ messip_channel_t *messip_channel_create( messip_cnx_t *cnx, const char *name, in
     iovec[0].iov_base = &reply;
     iovec[0].iov_len = sizeof( reply );
     dcount = messip_readv( cnx->sockfd, iovec, 1 );
+    pthread_mutex_unlock( &cnx->lock );
     messip_log( MESSIP_LOG_INFO, "channel_create: reply status= %d \n", status );
     assert( dcount == sizeof( messip_reply_channel_create_t ) );
 
     /*--- Channel creation failed ? ---*/
     if ( reply.ok == MESSIP_NOK ) {
+        slots_release( ch );
+        free( ch );
+        closesocket( sockfd );
+        if ( sockfd_unix != -1 )
+            closesocket( sockfd_unix );
+        return NULL;
+    }
+
+    /*--- Receive engine: sockets are registered once, then only ready ones are reported ---*/
+    int epoll_fd = epoll_create1( EPOLL_CLOEXEC );
+    if ( epoll_fd == -1 ) {
+        slots_release( ch );
+        free( ch );
+        closesocket( sockfd );
+        if ( sockfd_unix != -1 )
+            closesocket( sockfd_unix );
+        return NULL;
+    }
+    if ( ( epoll_add( epoll_fd, sockfd ) == -1 ) || ( ( sockfd_unix != -1 ) && ( epoll_add( epoll_fd, sockfd_unix ) == -1 ) ) ) {
+        close( epoll_fd );
+        slots_release( ch );
+        free( ch );
         closesocket( sockfd );
+        if ( sockfd_unix != -1 )
+            closesocket( sockfd_unix );
         return NULL;
     }
 
     /*--- Ok ---*/
-    ch = ( messip_channel_t * ) malloc( sizeof( messip_channel_t ) );
     strcpy( ch->name, name );
     ch->cnx = cnx;
     IDCPY( ch->remote_id, cnx->remote_id );
     ch->sin_port = reply.sin_port;
     ch->sin_addr = reply.sin_addr;
     strcpy( ch->sin_addr_str, reply.sin_addr_str );
-    ch->recv_sockfd_sz = 0;
-    ch->recv_sockfd[ch->recv_sockfd_sz++] = sockfd;
+    ch->mgr_handle = reply.handle;
+    ch->epoll_fd = epoll_fd;
+    ch->recv_sockfd = sockfd;
+    ch->recv_sockfd_unix = sockfd_unix;
+    ch->recv_sockfd_sz = ( sockfd_unix != -1 ) ? 2 : 1;
     ch->send_sockfd = -1;
+    ch->uring = NULL;
+    ch->shm = NULL;
+    ch->shm_slot = MESSIP_SHM_SLOT_NONE;
     ch->nb_replies_pending = 0;
-    ch->new_sockfd_sz = 1;
-    ch->new_sockfd = ( SOCKET * ) malloc( sizeof( int ) * ch->new_sockfd_sz );
-    ch->receive_allmsg = ( void ** ) malloc( sizeof( void ** ) * ch->new_sockfd_sz );
-    ch->receive_allmsg_sz = ( int * ) malloc( sizeof( int * ) * ch->new_sockfd_sz );
-    for ( k = 0; k < ch->new_sockfd_sz; k++ ) {
-        ch->new_sockfd[k] = -1;
-        ch->receive_allmsg[k] = NULL;
-        ch->receive_allmsg_sz[k] = 0;
-    }
+    ch->next_reqid = 0;
+    ch->requests = NULL;
+    ch->threads = NULL;
+    ch->sun_path[0] = '\0';
+    ch->receive_mode = MESSIP_RECEIVE_COPY;
+    ch->buffered_unacked = 0;
+    ch->buffered_unacked_sockfd = -1;
+    ch->buffered_unacked_sender = -1;
+    ch->buffered_mode = MESSIP_BUFFERED_MANAGER;
+    ch->buffered_credits = MESSIP_BUFFERED_CREDITS;
+    ch->pool = NULL;
+    ch->timers = NULL;
+    ch->wire_version = MESSIP_WIRE_LEGACY;
+    ch->wire_sender = 0;
+    ch->wire_ids = messip_wire_ids_create(  );
+    ch->serve = 0;
+    ch->rx_ready = NULL;
+    ch->nb_rx_ready = 0;
+    ch->rx_ready_sz = 0;
 
     return ch;
 }                               // messip_channel_create
@@ -574,22 +1046,21 @@ messip_channel_t *messip_channel_create( messip_cnx_t *cnx, const char *name, in
 int messip_channel_delete( messip_channel_t *ch, int msec_timeout ) {
     int status;
     ssize_t dcount;
-    fd_set ready;
-    struct timeval tv;
     int32_t op;
     messip_send_channel_delete_t msgsend;
     messip_reply_channel_delete_t reply;
     struct iovec iovec[2];
 
+    /*--- Its timers go away with the channel ---*/
+    channel_timers_release( ch );
+
+    /*--- Other threads may be talking to the messip manager too ---*/
+    pthread_mutex_lock( &ch->cnx->lock );
+
     /*--- Ready to write ? ---*/
     if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( ch->cnx->sockfd, &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) ch->cnx->sockfd + 1, NULL, &ready, NULL, &tv );    // <&>
-        assert( status != -1 );
-        if ( !FD_ISSET( ch->cnx->sockfd, &ready ) ) {
+        if ( messip_wait_ready( ch->cnx->sockfd, POLLOUT, msec_timeout ) <= 0 ) {
+            pthread_mutex_unlock( &ch->cnx->lock );
             errno = ETIMEDOUT;
             return -1;
         }
@@ -599,8 +1070,7 @@ int messip_channel_delete( messip_channel_t *ch, int msec_timeout ) {
     op = MESSIP_OP_CHANNEL_DELETE;
     iovec[0].iov_base = &op;
     iovec[0].iov_len = sizeof( int32_t );
-    IDCPY( msgsend.id, ch->remote_id );
-    strcpy( msgsend.name, ch->name );
+    msgsend.handle = ch->mgr_handle;
     iovec[1].iov_base = &msgsend;
     iovec[1].iov_len = sizeof( msgsend );
     status = messip_writev( ch->cnx->sockfd, iovec, 2 );
@@ -609,13 +1079,8 @@ int messip_channel_delete( messip_channel_t *ch, int msec_timeout ) {
 
     /*--- Ready to read ? ---*/
     if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( ch->cnx->sockfd, &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) ch->cnx->sockfd + 1, &ready, NULL, NULL, &tv );    // <&>
-        assert( status != -1 );
-        if ( !FD_ISSET( ch->cnx->sockfd, &ready ) ) {
+        if ( messip_wait_ready( ch->cnx->sockfd, POLLIN, msec_timeout ) <= 0 ) {
+            pthread_mutex_unlock( &ch->cnx->lock );
             errno = ETIMEDOUT;
             return -1;
         }
@@ -625,6 +1090,7 @@ int messip_channel_delete( messip_channel_t *ch, int msec_timeout ) {
     iovec[0].iov_base = &reply;
     iovec[0].iov_len = sizeof( reply );
     dcount = messip_readv( ch->cnx->sockfd, iovec, 1 );
+    pthread_mutex_unlock( &ch->cnx->lock );
     messip_log( MESSIP_LOG_INFO, "channel_delete: reply status= %d \n", dcount );
     assert( dcount == sizeof( messip_reply_channel_delete_t ) );
 
@@ -633,34 +1099,94 @@ int messip_channel_delete( messip_channel_t *ch, int msec_timeout ) {
 }                               // messip_channel_delete
 
 /**
- * Enables a client to connect to a channel owned by a server. Prior to send any message to a server,
- * this operation must be performed by a client.  
+ * Open the socket used to send messages to the server owning a channel
  * 
- * messip_channel_connect must be called only by a client (sending messages), 
- * but not by a server (receiving messages). It’s perfectly valid to have the same process 
- * acting both as server and client: in this case, there will be a thread for the server, 
- * and another thread for the client.
+ * @param info Channel being connected (sin_port and sin_addr are set)
+ * @param sun_path AF_UNIX socket of the server, if it runs on the same host, or ""
+ * @return 0 if no error (send_sockfd and shm_slot are set), or -1 if an error occurred
+ */
+static int channel_open_socket( messip_channel_t *info, const char *sun_path ) {
+    info->send_sockfd = -1;
+    info->shm_slot = MESSIP_SHM_SLOT_NONE;
+    if ( sun_path[0] ) {
+        info->send_sockfd = connect_unix( sun_path );
+        if ( info->send_sockfd != -1 )
+            info->shm_slot = MESSIP_SHM_SLOT_UNKNOWN;
+    }
+    if ( info->send_sockfd == -1 ) {
+
+        /*--- Create socket ---*/
+        info->send_sockfd = socket( AF_INET, SOCK_STREAM, 0 );
+//      logg( NULL, "%s: send_sockfd = %d \n", __FUNCTION__, info->send_sockfd );
+        if ( info->send_sockfd < 0 ) {
+            printf( "Unable to open a socket!\015\012" );
+            fflush( stdout );
+            return -1;
+        }
+        fcntl( info->send_sockfd, F_SETFL, FD_CLOEXEC );
+
+        /*--- Connect socket using name specified ---*/
+        struct sockaddr_in sockaddr;
+        memset( &sockaddr, 0, sizeof( sockaddr ) );
+        sockaddr.sin_family = AF_INET;
+        sockaddr.sin_port = htons( info->sin_port );
+        sockaddr.sin_addr.s_addr = info->sin_addr;
+        if ( connect( info->send_sockfd, ( const struct sockaddr * ) &sockaddr, sizeof( sockaddr ) ) < 0 ) {
+            printf( "%s %d:\015\012\tUnable to connect to host %s, port %d (name=%s)\015\012",
+               __FILE__, __LINE__, inet_ntoa( sockaddr.sin_addr ), info->sin_port, info->name );
+            fflush( stdout );
+            closesocket( info->send_sockfd );
+            info->send_sockfd = -1;
+            return -1;
+        }
+    }                           // if
+    return 0;
+}                               // channel_open_socket
+
+/**
+ * A thread using a channel in thread-safe mode has exited: its connection can be given to another thread
  * 
- * @param cnx connection (to the messip manager) structure which was returned by messip_connect() 
- * @param name name that identify the channel you want to connect to. This name is unique.
- * @param msec_timeout if not 0, is a timeout (expressed in milliseconds) where the function exits 
- * 		if connection with the messip manager fails.
- *  
- * @return A pointer to a messip_channel_t structure (that will be used next when sending messages on this channel), 
- *   or -1 if an error occurred (errno is then set):
- *      - ETIMEDOUT occurs if either the messip manage and the server owning the channel 
- *        did not answered the connection request within the expressed time.
+ * @param value Connection of the thread
+ */
+static void thread_cnx_release( void *value ) {
+    thread_cnx_t *tc = ( thread_cnx_t * ) value;
+    struct messip_threads *threads = tc->threads;
+
+    pthread_mutex_lock( &threads->mutex );
+    tc->next_free = threads->free;
+    threads->free = tc;
+    pthread_mutex_unlock( &threads->mutex );
+}                               // thread_cnx_release
+
+/**
+ * Close the connections of all the threads (the channel is disconnected)
  * 
- * @note
- *   Only one active connection to the same channel can be performed by a given thread.
+ * @param threads Thread-safe mode of the channel
+ */
+static void threads_destroy( struct messip_threads *threads ) {
+    thread_cnx_t *tc;
+
+    pthread_key_delete( threads->key );
+    while ( ( tc = threads->all ) != NULL ) {
+        threads->all = tc->next;
+        messip_sockbuf_reset( tc->ch.send_sockfd );
+        closesocket( tc->ch.send_sockfd );
+        if ( tc->ch.uring != NULL )
+            messip_uring_destroy( tc->ch.uring );
+        free( tc );
+    }                           // while
+    pthread_mutex_destroy( &threads->mutex );
+    free( threads );
+}                               // threads_destroy
+
+/**
+ * messip_channel_connect(), once the connection with the messip manager is locked
  * 
- * @see messip_channel_create(), messip_channel_disconnect(), messip_receive(), messip_send()
+ * @see messip_channel_connect()
  */
-messip_channel_t *messip_channel_connect( messip_cnx_t *cnx, const char *name, int msec_timeout ) {
+static messip_channel_t *channel_connect( messip_cnx_t *cnx, const char *name, int msec_timeout ) {
     int status;
     messip_channel_t *info;
-    fd_set ready;
-    struct timeval tv;
     messip_datasend_t datasend;
     ssize_t dcount;
     int32_t op;
@@ -670,13 +1196,7 @@ messip_channel_t *messip_channel_connect( messip_cnx_t *cnx, const char *name, i
 
     /*--- Ready to write ? ---*/
     if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( cnx->sockfd, &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) FD_SETSIZE, NULL, &ready, NULL, &tv );
-        assert( status != -1 );
-        if ( !FD_ISSET( cnx->sockfd, &ready ) ) {
+        if ( messip_wait_ready( cnx->sockfd, POLLOUT, msec_timeout ) <= 0 ) {
             errno = ETIMEDOUT;
             return NULL;
         }
@@ -700,13 +1220,7 @@ messip_channel_t *messip_channel_connect( messip_cnx_t *cnx, const char *name, i
 
     /*--- Ready to read ? ---*/
     if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( cnx->sockfd, &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) FD_SETSIZE, &ready, NULL, NULL, &tv );
-        assert( status != -1 );
-        if ( !FD_ISSET( cnx->sockfd, &ready ) ) {
+        if ( messip_wait_ready( cnx->sockfd, POLLIN, msec_timeout ) <= 0 ) {
             errno = ETIMEDOUT;
             return NULL;
         }
@@ -736,67 +1250,79 @@ messip_channel_t *messip_channel_connect( messip_cnx_t *cnx, const char *name, i
 
     /*--- Use an existant connection or create a new one ---*/
     if ( msgreply.f_already_connected ) {
-        int n, found;
-
-        for ( found = 0, n = 0; n < nb_list_connect; n++ ) {
-            if ( !strcmp( list_connect[n].name, name ) ) {
-                found = 1;
-                break;
-            }
-        }
-        assert( found == 1 );
-        info = list_connect[n].info;
+        pthread_mutex_lock( &list_connect_mutex );
+        info = ( messip_channel_t * ) messip_hash_get( list_connect, name );
+        pthread_mutex_unlock( &list_connect_mutex );
+        assert( info != NULL );
         info->f_already_connected = 1;
 
     }
     else {
 
-        /*--- Ok ---*/
-        info = ( messip_channel_t * ) malloc( sizeof( messip_channel_t ) );
+        /*--- Ok (what only a server uses stays cleared) ---*/
+        info = ( messip_channel_t * ) calloc( 1, sizeof( messip_channel_t ) );
+        if ( info == NULL ) {
+            errno = ENOMEM;
+            return NULL;
+        }
         info->f_already_connected = 0;
+        info->recv_sockfd = -1;
+        info->recv_sockfd_unix = -1;
+        info->epoll_fd = -1;
+        info->receive_mode = MESSIP_RECEIVE_COPY;
         info->cnx = cnx;
         IDCPY( info->remote_id, msgreply.id );
         info->sin_port = msgreply.sin_port;
         info->sin_addr = msgreply.sin_addr;
         strcpy( info->sin_addr_str, msgreply.sin_addr_str );
         strcpy( info->name, name );
-        info->mgr_sockfd = msgreply.mgr_sockfd;
-
-        /*--- Create socket ---*/
-        info->send_sockfd = socket( AF_INET, SOCK_STREAM, 0 );
-//      logg( NULL, "%s: send_sockfd = %d \n", __FUNCTION__, info->send_sockfd );
-        if ( info->send_sockfd < 0 ) {
-            printf( "Unable to open a socket!\015\012" );
-            fflush( stdout );
+        info->mgr_handle = msgreply.handle;
+        info->uring = NULL;
+        info->shm = NULL;
+        info->new_shm_slot = NULL;
+        info->receive_offset = NULL;
+        info->receive_flag = NULL;
+        info->receive_reqid = NULL;
+        info->receive_sender = NULL;
+        info->next_reqid = 0;
+        info->wire_version = MESSIP_WIRE_UNKNOWN;
+        info->wire_sender = 0;
+        info->wire_ids = NULL;
+        info->requests = NULL;
+        info->nb_replies_pending = 0;
+        info->pool = NULL;
+        info->timers = NULL;
+        info->serve = 0;
+        info->buffered_unacked = 0;
+        info->buffered_unacked_sockfd = -1;
+        info->buffered_unacked_sender = -1;
+        info->buffered_mode = MESSIP_BUFFERED_MANAGER;
+        info->buffered_credits = MESSIP_BUFFERED_CREDITS;
+
+        /*--- Server on the same host: use its AF_UNIX socket, rather than TCP/IP ---*/
+        info->threads = NULL;
+        if ( !msgreply.sun_path[0] || strcmp( msgreply.host_ident, get_host_ident(  ) ) )
+            msgreply.sun_path[0] = '\0';
+        if ( channel_open_socket( info, msgreply.sun_path ) == -1 ) {
+            free( info );
             return NULL;
         }
-        fcntl( info->send_sockfd, F_SETFL, FD_CLOEXEC );
+        strcpy( info->sun_path, msgreply.sun_path );
 
-        /*--- Connect socket using name specified ---*/
-        struct sockaddr_in sockaddr;
-        memset( &sockaddr, 0, sizeof( sockaddr ) );
-        sockaddr.sin_family = AF_INET;
-        sockaddr.sin_port = htons( info->sin_port );
-        sockaddr.sin_addr.s_addr = info->sin_addr;
-        if ( connect( info->send_sockfd, ( const struct sockaddr * ) &sockaddr, sizeof( sockaddr ) ) < 0 ) {
-            printf( "%s %d:\015\012\tUnable to connect to host %s, port %d (name=%s)\015\012",
-               __FILE__, __LINE__, inet_ntoa( sockaddr.sin_addr ), info->sin_port, name );
-            fflush( stdout );
+        /*--- Update list of connections to channels ---*/
+        pthread_mutex_lock( &list_connect_mutex );
+        if ( list_connect == NULL )
+            list_connect = messip_hash_create( 0 );
+        if ( ( list_connect == NULL ) || ( messip_hash_put( list_connect, info->name, info ) == -1 ) ) {
+            pthread_mutex_unlock( &list_connect_mutex );
             closesocket( info->send_sockfd );
+            if ( info->uring != NULL )
+                messip_uring_destroy( info->uring );
+            free( info );
+            errno = ENOMEM;
             return NULL;
         }
-
-        /*--- Update list of connections to channels ---*/
-        if ( nb_list_connect == 0 ) {
-            list_connect = ( list_connect_t * ) malloc( sizeof( list_connect_t ) );
-            nb_list_connect = 1;
-        }
-        else {
-            list_connect = ( list_connect_t * ) realloc( list_connect, sizeof( list_connect_t ) * ( nb_list_connect + 1 ) );
-            nb_list_connect++;
-        }
-        strcpy( list_connect[nb_list_connect - 1].name, name );
-        list_connect[nb_list_connect - 1].info = info;
+        pthread_mutex_unlock( &list_connect_mutex );
 
     }                           // else
 
@@ -808,32 +1334,50 @@ messip_channel_t *messip_channel_connect( messip_cnx_t *cnx, const char *name, i
     assert( dcount == sizeof( messip_datasend_t ) );
 
     return info;
-}                               // messip_channel_connect
+}                               // channel_connect
 
 /**
- * Enables a client to disconnect from a channel owned by a server.
+ * Enables a client to connect to a channel owned by a server. Prior to send any message to a server,
+ * this operation must be performed by a client.  
  * 
- * @note
- *  - No exchange is performed with the server (the owner of the channel), but only with the messip manager.
- *  - messip_channel_disconnect must be called only by a client (sending messages), 
- *    but not by a server (receiving messages
+ * messip_channel_connect must be called only by a client (sending messages), 
+ * but not by a server (receiving messages). It’s perfectly valid to have the same process 
+ * acting both as server and client: in this case, there will be a thread for the server, 
+ * and another thread for the client.
  * 
- * @param ch channel connection (to the server) structure which was returned by messip_channel_connect() 
- * @param msec_timeout if not 0, is a timeout (expressed in milliseconds) where the function exits if 
- * 		the connection with the messip manager fails.
+ * @param cnx connection (to the messip manager) structure which was returned by messip_connect() 
+ * @param name name that identify the channel you want to connect to. This name is unique.
+ * @param msec_timeout if not 0, is a timeout (expressed in milliseconds) where the function exits 
+ * 		if connection with the messip manager fails.
  *  
  * @return A pointer to a messip_channel_t structure (that will be used next when sending messages on this channel), 
- * 		or -1 if an error occurred (errno is then set):
- *  - ETIMEDOUT occurs if either the messip manage and the server owning the channel did not answered 
- *    the connection request within the expressed time.
+ *   or -1 if an error occurred (errno is then set):
+ *      - ETIMEDOUT occurs if either the messip manage and the server owning the channel 
+ *        did not answered the connection request within the expressed time.
+ * 
+ * @note
+ *   Only one active connection to the same channel can be performed by a given thread.
  * 
  * @see messip_channel_create(), messip_channel_disconnect(), messip_receive(), messip_send()
  */
-int messip_channel_disconnect( messip_channel_t *ch, int msec_timeout ) {
+messip_channel_t *messip_channel_connect( messip_cnx_t *cnx, const char *name, int msec_timeout ) {
+    messip_channel_t *info;
+
+    pthread_mutex_lock( &cnx->lock );
+    info = channel_connect( cnx, name, msec_timeout );
+    pthread_mutex_unlock( &cnx->lock );
+    return info;
+}                               // messip_channel_connect
+
+/**
+ * messip_channel_disconnect(), once the connection with the messip manager is locked
+ * 
+ * @see messip_channel_disconnect()
+ */
+static int channel_disconnect( messip_channel_t *ch, int msec_timeout ) {
     int status;
-    fd_set ready;
-    struct timeval tv;
     messip_datasend_t datasend;
+    char wire[sizeof( messip_datasend_t )];
     ssize_t dcount;
     struct iovec iovec[2];
     messip_send_channel_disconnect_t msgsend;
@@ -842,13 +1386,7 @@ int messip_channel_disconnect( messip_channel_t *ch, int msec_timeout ) {
 
     /*--- Timeout to write ? ---*/
     if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( ch->send_sockfd, &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) FD_SETSIZE, NULL, &ready, NULL, &tv );
-        assert( status != -1 );
-        if ( !FD_ISSET( ch->send_sockfd, &ready ) )
+        if ( messip_wait_ready( ch->send_sockfd, POLLOUT, msec_timeout ) <= 0 )
             return MESSIP_MSG_TIMEOUT;
     }
 
@@ -859,12 +1397,12 @@ int messip_channel_disconnect( messip_channel_t *ch, int msec_timeout ) {
     datasend.datalen = 0;
 
     /*--- Send a message to the 'server' ---*/
-    iovec[0].iov_base = &datasend;
-    iovec[0].iov_len = sizeof( datasend );
+    iovec[0].iov_base = wire;
+    iovec[0].iov_len = messip_wire_send_encode( wire, &datasend, ch->wire_version, ch->wire_sender, 0 );
     dcount = messip_writev( ch->send_sockfd, iovec, 1 );
     messip_log( MESSIP_LOG_INFO, "messip_channel_disconnect: sendmsg dcount=%d local_fd=%d [errno=%d] \n",
        dcount, ch->send_sockfd, errno );
-    assert( dcount == sizeof( messip_datasend_t ) );
+    assert( dcount == iovec[0].iov_len );
 
     /*
      * Now notify also messip_mgr
@@ -872,13 +1410,7 @@ int messip_channel_disconnect( messip_channel_t *ch, int msec_timeout ) {
 
     /*--- Ready to write ? ---*/
     if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( ch->cnx->sockfd, &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) FD_SETSIZE, NULL, &ready, NULL, &tv );
-        assert( status != -1 );
-        if ( !FD_ISSET( ch->cnx->sockfd, &ready ) ) {
+        if ( messip_wait_ready( ch->cnx->sockfd, POLLOUT, msec_timeout ) <= 0 ) {
             errno = ETIMEDOUT;
             return -1;
         }
@@ -888,8 +1420,7 @@ int messip_channel_disconnect( messip_channel_t *ch, int msec_timeout ) {
     op = MESSIP_OP_CHANNEL_DISCONNECT;
     iovec[0].iov_base = &op;
     iovec[0].iov_len = sizeof( int32_t );
-    IDCPY( msgsend.id, ch->cnx->remote_id );
-    strcpy( msgsend.name, ch->name );
+    msgsend.handle = ch->mgr_handle;
     iovec[1].iov_base = &msgsend;
     iovec[1].iov_len = sizeof( msgsend );
     status = messip_writev( ch->cnx->sockfd, iovec, 2 );
@@ -898,13 +1429,7 @@ int messip_channel_disconnect( messip_channel_t *ch, int msec_timeout ) {
 
     /*--- Ready to read ? ---*/
     if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( ch->cnx->sockfd, &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) FD_SETSIZE, &ready, NULL, NULL, &tv );
-        assert( status != -1 );
-        if ( !FD_ISSET( ch->cnx->sockfd, &ready ) ) {
+        if ( messip_wait_ready( ch->cnx->sockfd, POLLIN, msec_timeout ) <= 0 ) {
             errno = ETIMEDOUT;
             return -1;
         }
@@ -919,8 +1444,88 @@ int messip_channel_disconnect( messip_channel_t *ch, int msec_timeout ) {
 
     /*--- Channel deletion failed ? ---*/
     return reply.ok;
+}                               // channel_disconnect
+
+/**
+ * Enables a client to disconnect from a channel owned by a server.
+ * 
+ * @note
+ *  - No exchange is performed with the server (the owner of the channel), but only with the messip manager.
+ *  - messip_channel_disconnect must be called only by a client (sending messages), 
+ *    but not by a server (receiving messages
+ * 
+ * @param ch channel connection (to the server) structure which was returned by messip_channel_connect() 
+ * @param msec_timeout if not 0, is a timeout (expressed in milliseconds) where the function exits if 
+ * 		the connection with the messip manager fails.
+ *  
+ * @return A pointer to a messip_channel_t structure (that will be used next when sending messages on this channel), 
+ * 		or -1 if an error occurred (errno is then set):
+ *  - ETIMEDOUT occurs if either the messip manage and the server owning the channel did not answered 
+ *    the connection request within the expressed time.
+ * 
+ * @see messip_channel_create(), messip_channel_disconnect(), messip_receive(), messip_send()
+ */
+int messip_channel_disconnect( messip_channel_t *ch, int msec_timeout ) {
+    int status;
+
+    pthread_mutex_lock( &ch->cnx->lock );
+    status = channel_disconnect( ch, msec_timeout );
+    pthread_mutex_unlock( &ch->cnx->lock );
+    if ( ch->threads != NULL ) {
+        threads_destroy( ch->threads );
+        ch->threads = NULL;
+    }
+    return status;
 }                               // messip_channel_disconnect
 
+/**
+ * Offer the compact header to the server of a channel, before the first message sent on the connection: 
+ * with a ping, which any server replies to. The format of the reply tells whether the server takes it.
+ * 
+ * @param ch Channel returned by messip_channel_connect()
+ * @param msec_timeout Timeout expressed in milliseconds, or MESSIP_NOTIMEOUT (the reply is then waited 
+ *    for by the next send)
+ * @return 0 if no error, MESSIP_MSG_TIMEOUT, or -1 if an error occurred (errno is then set)
+ */
+static int wire_negotiate( messip_channel_t *ch, int msec_timeout ) {
+    messip_datasend_t datasend;
+    messip_datareply_t datareply;
+    uint32_t reqid;
+    struct iovec iovec[1];
+    ssize_t dcount;
+
+    if ( ( ch->wire_version != MESSIP_WIRE_UNKNOWN ) && ( ch->wire_version != MESSIP_WIRE_OFFERED ) )
+        return 0;
+
+    /*--- Send the offer, in a legacy header ---*/
+    if ( ch->wire_version == MESSIP_WIRE_UNKNOWN ) {
+        memset( &datasend, 0, sizeof( datasend ) );
+        datasend.flag = MESSIP_FLAG_PING;
+        IDCPY( datasend.id, ch->cnx->remote_id );
+        datasend.type = MESSIP_WIRE_OFFER;
+        datasend.datalen = 0;
+        iovec[0].iov_base = &datasend;
+        iovec[0].iov_len = sizeof( datasend );
+        dcount = messip_sockbuf_writev( ch->send_sockfd, iovec, 1, msec_timeout );
+        if ( ( dcount == -1 ) && ( errno == ETIMEDOUT ) )
+            return MESSIP_MSG_TIMEOUT;
+        if ( dcount != sizeof( datasend ) )
+            return -1;
+        ch->wire_version = MESSIP_WIRE_OFFERED;
+    }
+
+    /*--- The reply sets wire_version (see datareply_read) ---*/
+    if ( ( msec_timeout != MESSIP_NOTIMEOUT ) && ( messip_sockbuf_wait( ch->send_sockfd, msec_timeout ) <= 0 ) )
+        return MESSIP_MSG_TIMEOUT;
+    dcount = datareply_read( ch, &datareply, &reqid );
+    if ( dcount <= 0 ) {
+        if ( dcount == 0 )
+            errno = ECONNRESET;
+        return -1;
+    }
+    return 0;
+}                               // wire_negotiate
+
 /**
  *  TBD
  * 
@@ -930,25 +1535,28 @@ int messip_channel_disconnect( messip_channel_t *ch, int msec_timeout ) {
  */
 int messip_channel_ping( messip_channel_t *ch, int msec_timeout ) {
     ssize_t dcount;
+    int status;
     messip_datasend_t datasend;
+    char wire[sizeof( messip_datasend_t )];
     messip_datareply_t datareply;
+    uint32_t reqid;
     struct iovec iovec[1];
-    fd_set ready;
-    struct timeval tv;
-    int status;
 
-    /*--- Timeout to write ? ---*/
-    if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( ch->send_sockfd, &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) FD_SETSIZE, NULL, &ready, NULL, &tv );
-        assert( status != -1 );
-        if ( !FD_ISSET( ch->send_sockfd, &ready ) )
-            return MESSIP_MSG_TIMEOUT;
+    if ( ch->threads != NULL ) {
+        if ( ( ch = messip_channel_self( ch ) ) == NULL )
+            return -1;
+    }
+
+    /*--- Buffered messages sent directly: their acknowledgments come first ---*/
+    if ( ch->buffered_credits < MESSIP_BUFFERED_CREDITS ) {
+        if ( ( status = buffered_credits_wait( ch, MESSIP_BUFFERED_CREDITS, msec_timeout ) ) != 0 )
+            return status;
     }
 
+    /*--- The reply to the offer of the compact header comes first ---*/
+    if ( ( ch->wire_version == MESSIP_WIRE_OFFERED ) && ( ( status = wire_negotiate( ch, msec_timeout ) ) != 0 ) )
+        return status;
+
     /*--- Message to send ---*/
     datasend.flag = MESSIP_FLAG_PING;
     IDCPY( datasend.id, ch->cnx->remote_id );
@@ -956,34 +1564,23 @@ int messip_channel_ping( messip_channel_t *ch, int msec_timeout ) {
     datasend.datalen = 0;
 
     /*--- Send a message to the 'server' ---*/
-    iovec[0].iov_base = &datasend;
-    iovec[0].iov_len = sizeof( datasend );
-    dcount = messip_writev( ch->send_sockfd, iovec, 1 );
+    iovec[0].iov_base = wire;
+    iovec[0].iov_len = messip_wire_send_encode( wire, &datasend, ch->wire_version, ch->wire_sender, 0 );
+    dcount = messip_sockbuf_writev( ch->send_sockfd, iovec, 1, msec_timeout );
     messip_log( MESSIP_LOG_INFO, "messip_channel_ping: sendmsg dcount=%d local_fd=%d [errno=%d] \n",
        dcount, ch->send_sockfd, errno );
-    assert( dcount == sizeof( messip_datasend_t ) );
+    if ( ( dcount == -1 ) && ( errno == ETIMEDOUT ) )
+        return MESSIP_MSG_TIMEOUT;
+    assert( dcount == iovec[0].iov_len );
 
     /*--- Timeout to read ? ---*/
     if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( ch->send_sockfd, &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) FD_SETSIZE, &ready, NULL, NULL, &tv );
-        assert( status != -1 );
-        if ( !FD_ISSET( ch->send_sockfd, &ready ) )
+        if ( messip_sockbuf_wait( ch->send_sockfd, msec_timeout ) <= 0 )
             return MESSIP_MSG_TIMEOUT;
     }
-    else {
-        FD_ZERO( &ready );
-        FD_SET( ch->send_sockfd, &ready );
-        status = select( ( int ) ch->send_sockfd + 1, &ready, NULL, NULL, NULL );
-    }
 
     /*--- Read reply from 'server' ---*/
-    iovec[0].iov_base = &datareply;
-    iovec[0].iov_len = sizeof( datareply );
-    dcount = messip_readv( ch->send_sockfd, iovec, 1 );
+    dcount = datareply_read( ch, &datareply, &reqid );
     if ( dcount <= 0 ) {
         messip_log( MESSIP_LOG_ERROR, "%s %d\n\t dcount=%d  errno=%d\n", __FILE__, __LINE__, dcount, errno );
         return -1;
@@ -994,6 +1591,298 @@ int messip_channel_ping( messip_channel_t *ch, int msec_timeout ) {
     return 0;
 }                               // messip_channel_ping
 
+/**
+ * Select the engine used to transfer the messages on a channel.
+ * 
+ * With MESSIP_ENGINE_IO_URING, a messip_send() submits the message and the read of the reply
+ * with a single system call, and a messip_reply() is queued without waiting for the write to complete.
+ * messip_receive() is not affected: the length of a message is only known once its header is read.
+ * 
+ * @param ch Channel returned either by messip_channel_create() (the engine is then used by messip_reply)
+ *    or by messip_channel_connect() (the engine is then used by messip_send)
+ * @param engine MESSIP_ENGINE_SOCKET or MESSIP_ENGINE_IO_URING
+ * @return The engine actually used: MESSIP_ENGINE_SOCKET if io_uring is not available on this system
+ *    (or has not been compiled) or if the channel is in serve mode, or -1 if engine is invalid 
+ *    (errno is then set to EINVAL)
+ * 
+ * @see messip_send(), messip_reply()
+ */
+int messip_channel_set_engine( messip_channel_t *ch, int engine ) {
+
+    switch ( engine ) {
+        case MESSIP_ENGINE_SOCKET:
+            if ( ch->uring != NULL ) {
+                messip_uring_destroy( ch->uring );
+                ch->uring = NULL;
+            }
+            return MESSIP_ENGINE_SOCKET;
+        case MESSIP_ENGINE_IO_URING:
+            if ( ch->serve )
+                return MESSIP_ENGINE_SOCKET;    // A ring is used by one thread at a time
+            if ( ch->uring == NULL ) {
+                ch->uring = messip_uring_create(  );
+                if ( ch->uring == NULL ) {
+                    messip_log( MESSIP_LOG_WARNING, "messip_channel_set_engine: io_uring not available (%m)\n" );
+                    return MESSIP_ENGINE_SOCKET;
+                }
+            }
+            return MESSIP_ENGINE_IO_URING;
+        default:
+            errno = EINVAL;
+            return -1;
+    }                           // switch
+}                               // messip_channel_set_engine
+
+/**
+ * Select how messip_receive() handles a message larger than the buffer provided.
+ * 
+ * - MESSIP_RECEIVE_COPY (default): the whole message is read and kept until messip_reply(),
+ *   at the cost of an allocation and a copy on each message.
+ * - MESSIP_RECEIVE_LAZY: nothing is allocated nor copied. What did not fit in the buffer stays in the socket,
+ *   until it is read by messip_receive_more(), or discarded by messip_reply().
+ * 
+ * @param ch Channel returned by messip_channel_create()
+ * @param mode MESSIP_RECEIVE_COPY or MESSIP_RECEIVE_LAZY
+ * @return 0 if no error, or -1 if mode is invalid (errno is then set to EINVAL)
+ * 
+ * @note In lazy mode, messip_channel_t.receive_allmsg is not set.
+ * 
+ * @see messip_receive(), messip_receive_more()
+ */
+int messip_channel_set_receive_mode( messip_channel_t *ch, int mode ) {
+    if ( ( mode != MESSIP_RECEIVE_COPY ) && ( mode != MESSIP_RECEIVE_LAZY ) ) {
+        errno = EINVAL;
+        return -1;
+    }
+    ch->receive_mode = mode;
+    return 0;
+}                               // messip_channel_set_receive_mode
+
+/**
+ * Select how messip_buffered_send() delivers the Asynchronous Messages of a client.
+ * 
+ * - MESSIP_BUFFERED_MANAGER (default): the messages are queued by the messip manager, which 
+ *   forwards them to the server. The client waits only once maxnb_msg_buffered messages are queued.
+ * - MESSIP_BUFFERED_DIRECT: the messages are written straight on the connection to the server, 
+ *   which acknowledges them in batches. Up to MESSIP_BUFFERED_CREDITS messages can be in flight: 
+ *   the client then waits for an acknowledgment. maxnb_msg_buffered does not apply.
+ * 
+ * @param ch Channel returned by messip_channel_connect()
+ * @param mode MESSIP_BUFFERED_MANAGER or MESSIP_BUFFERED_DIRECT
+ * @return 0 if no error, or -1 if mode is invalid (errno is then set to EINVAL)
+ * 
+ * @note With either mode, the server receives the messages the same way: messip_receive() returns 
+ *    MESSIP_MSG_NOREPLY. Messages sent directly are not ordered with the ones sent through the manager.
+ * 
+ * @see messip_buffered_send()
+ */
+int messip_channel_set_buffered_mode( messip_channel_t *ch, int mode ) {
+    if ( ( mode != MESSIP_BUFFERED_MANAGER ) && ( mode != MESSIP_BUFFERED_DIRECT ) ) {
+        errno = EINVAL;
+        return -1;
+    }
+    ch->buffered_mode = mode;
+    return 0;
+}                               // messip_channel_set_buffered_mode
+
+/**
+ * Allocate from a pool, instead of the heap, the buffers of this channel: the ones returned
+ * in dynamic allocation mode (maxlen or reply_maxlen 0), and the copies of the messages kept
+ * until messip_reply(). Released buffers are recycled, per size class.
+ * 
+ * @param ch Channel returned by messip_channel_create() or messip_channel_connect()
+ * @return 0 if no error, or -1 if an error occurred (errno is set: EBUSY if messages
+ *    are waiting for a reply or if the channel is in thread-safe or serve mode, ENOMEM)
+ * 
+ * @note Once the pool is enabled, the buffers returned in dynamic allocation mode must
+ *    be given back with messip_buffer_release(), not free().
+ * 
+ * @see messip_buffer_release()
+ */
+int messip_channel_enable_pool( messip_channel_t *ch ) {
+    if ( ch->pool != NULL )
+        return 0;
+    if ( ( ch->nb_replies_pending != 0 ) || ( ch->threads != NULL ) || ch->serve ) {
+        errno = EBUSY;
+        return -1;
+    }
+    ch->pool = messip_pool_create(  );
+    if ( ch->pool == NULL ) {
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}                               // messip_channel_enable_pool
+
+/**
+ * Make a channel usable by several sending threads at the same time. Each thread then sends 
+ * on its own connection to the server, opened the first time the thread sends on the channel; 
+ * when the thread exits, its connection is kept for the next thread.
+ * 
+ * messip_send(), messip_send_async() and messip_channel_ping() use the connection of the calling 
+ * thread transparently. The results of the last messip_send() of a thread (datalen, datalenr) 
+ * are in the channel returned by messip_channel_self().
+ * 
+ * @param ch Channel returned by messip_channel_connect()
+ * @return 0 if no error, or -1 if an error occurred (errno is set: EBUSY if a buffer pool 
+ *    is enabled on the channel, or asynchronous sends are in flight)
+ * 
+ * @see messip_channel_self()
+ */
+int messip_channel_set_threadsafe( messip_channel_t *ch ) {
+    struct messip_threads *threads;
+
+    if ( ch->threads != NULL )
+        return 0;
+    if ( ( ch->pool != NULL ) || ( ch->requests != NULL ) ) {
+        errno = EBUSY;
+        return -1;
+    }
+    threads = ( struct messip_threads * ) malloc( sizeof( struct messip_threads ) );
+    if ( threads == NULL ) {
+        errno = ENOMEM;
+        return -1;
+    }
+    if ( ( errno = pthread_key_create( &threads->key, thread_cnx_release ) ) != 0 ) {
+        free( threads );
+        return -1;
+    }
+    pthread_mutex_init( &threads->mutex, NULL );
+    threads->free = NULL;
+    threads->all = NULL;
+    strcpy( threads->sun_path, ch->sun_path );
+    ch->threads = threads;
+    return 0;
+}                               // messip_channel_set_threadsafe
+
+/**
+ * Connection of the calling thread to a channel in thread-safe mode
+ * 
+ * @param ch Channel returned by messip_channel_connect()
+ * @return The connection of the calling thread (the channel itself if it is not in thread-safe mode), 
+ *    or NULL if an error occurred (errno is then set)
+ * 
+ * @see messip_channel_set_threadsafe()
+ */
+messip_channel_t *messip_channel_self( messip_channel_t *ch ) {
+    struct messip_threads *threads = ch->threads;
+    messip_datasend_t datasend;
+    struct iovec iovec[1];
+    thread_cnx_t *tc;
+
+    if ( threads == NULL )
+        return ch;
+    tc = ( thread_cnx_t * ) pthread_getspecific( threads->key );
+    if ( tc != NULL )
+        return &tc->ch;
+
+    /*--- Connection left by a thread which has exited ? ---*/
+    pthread_mutex_lock( &threads->mutex );
+    tc = threads->free;
+    if ( tc != NULL )
+        threads->free = tc->next_free;
+    pthread_mutex_unlock( &threads->mutex );
+
+    /*--- Otherwise, open a new one ---*/
+    if ( tc == NULL ) {
+        tc = ( thread_cnx_t * ) malloc( sizeof( thread_cnx_t ) );
+        if ( tc == NULL ) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        memcpy( &tc->ch, ch, sizeof( messip_channel_t ) );
+        tc->ch.threads = NULL;
+        tc->ch.shm = NULL;
+        tc->ch.requests = NULL;
+        tc->ch.next_reqid = 0;
+        tc->ch.wire_version = MESSIP_WIRE_UNKNOWN;
+        tc->ch.buffered_credits = MESSIP_BUFFERED_CREDITS;
+        tc->ch.uring = NULL;
+        if ( channel_open_socket( &tc->ch, threads->sun_path ) == -1 ) {
+            free( tc );
+            return NULL;
+        }
+        if ( ch->uring != NULL )
+            tc->ch.uring = messip_uring_create(  );
+        memset( &datasend, 0, sizeof( datasend ) );
+        datasend.flag = MESSIP_FLAG_CONNECTING;
+        iovec[0].iov_base = &datasend;
+        iovec[0].iov_len = sizeof( datasend );
+        messip_writev( tc->ch.send_sockfd, iovec, 1 );
+        tc->threads = threads;
+        pthread_mutex_lock( &threads->mutex );
+        tc->next = threads->all;
+        threads->all = tc;
+        pthread_mutex_unlock( &threads->mutex );
+    }
+    pthread_setspecific( threads->key, tc );
+    return &tc->ch;
+}                               // messip_channel_self
+
+/**
+ * Let several threads serve a channel at the same time: each thread calls messip_receive(), 
+ * then messip_reply() with the index it got, independently of the other threads. 
+ * 
+ * Each message goes to one thread only: a client socket is not watched anymore once a message 
+ * has been read from it, until this message is replied (or acknowledged, for a buffered message). 
+ * The indexes come from a fixed set of nb_slots entries, handed out and given back without any lock.
+ * 
+ * @param ch Channel returned by messip_channel_create()
+ * @param nb_slots Maximum number of messages received and not replied yet, all threads together
+ *    (messip_receive() fails with ENOBUFS beyond that)
+ * @return 0 if no error, or -1 if an error occurred (errno is set: EINVAL if nb_slots is not positive, 
+ *    EBUSY if clients are connected already or if a buffer pool, the shared-memory transport 
+ *    or io_uring is enabled on the channel, ENOMEM)
+ * 
+ * @note Must be called right after messip_channel_create(), before the threads start to receive.
+ *    datalen, datalenr and remote_id of the channel are then those of the last message received 
+ *    by any thread: use messip_receive_header() to get the ones of a message. Buffered messages 
+ *    are acknowledged one by one, and may be handled in any order.
+ * 
+ * @see messip_receive(), messip_reply(), messip_receive_header()
+ */
+int messip_channel_set_serve( messip_channel_t *ch, int nb_slots ) {
+    struct epoll_event event;
+
+    if ( nb_slots <= 0 ) {
+        errno = EINVAL;
+        return -1;
+    }
+    if ( ch->serve )
+        return 0;
+    if ( ( ch->nb_replies_pending != 0 ) || ( ch->recv_sockfd_sz != ( ( ch->recv_sockfd_unix != -1 ) ? 2 : 1 ) )
+       || ( ch->pool != NULL ) || ( ch->shm != NULL ) || ( ch->uring != NULL ) ) {
+        errno = EBUSY;
+        return -1;
+    }
+    if ( ( nb_slots > ch->new_sockfd_sz ) && ( slots_grow( ch, nb_slots ) == -1 ) )
+        return -1;
+
+    /*--- A new connection is accepted by one thread only ---*/
+    ch->serve = 1;
+    memset( &event, 0, sizeof( event ) );
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.fd = ch->recv_sockfd;
+    epoll_ctl( ch->epoll_fd, EPOLL_CTL_MOD, ch->recv_sockfd, &event );
+    if ( ch->recv_sockfd_unix != -1 ) {
+        event.data.fd = ch->recv_sockfd_unix;
+        epoll_ctl( ch->epoll_fd, EPOLL_CTL_MOD, ch->recv_sockfd_unix, &event );
+    }
+    return 0;
+}                               // messip_channel_set_serve
+
+/**
+ * Give back a buffer returned by messip_receive() or messip_send() in dynamic allocation mode
+ * 
+ * @param ch Channel the buffer has been received on
+ * @param buffer Buffer to release (NULL is valid)
+ * 
+ * @see messip_channel_enable_pool()
+ */
+void messip_buffer_release( messip_channel_t *ch, void *buffer ) {
+    buffer_free( ch, buffer );
+}                               // messip_buffer_release
+
 /**
  *  TBD
  * 
@@ -1006,199 +1895,424 @@ static int ping_reply( messip_channel_t *ch, int index, int msec_timeout ) {
     ssize_t dcount;
     struct iovec iovec[1];
     messip_datareply_t datareply;
-    fd_set ready;
-    struct timeval tv;
-    int status;
+    char wire[sizeof( messip_datareply_t )];
+    int sender = ch->receive_sender[index];
 
     /*--- Message to reply back ---*/
     IDCPY( datareply.id, ch->remote_id );
     datareply.datalen = 0;
     datareply.answer = -1;
 
-    /*--- Timeout to write ? ---*/
-    if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( ch->new_sockfd[index], &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) FD_SETSIZE, NULL, &ready, NULL, &tv );
-        assert( status != -1 );
-        if ( !FD_ISSET( ch->new_sockfd[index], &ready ) )
-            return MESSIP_MSG_TIMEOUT;
-    }
-
-    /*--- Now wait for an answer from the server ---*/
-    iovec[0].iov_base = &datareply;
-    iovec[0].iov_len = sizeof( datareply );
-    dcount = messip_writev( ch->new_sockfd[index], iovec, 1 );
+    /*--- Now wait for an answer from the server (polled only if the socket is full) ---*/
+    iovec[0].iov_base = wire;
+    iovec[0].iov_len = messip_wire_reply_encode( wire, &datareply, MESSIP_WIRE_OF( sender ), sender, 0 );
+    if ( ( ch->uring != NULL ) && ( messip_uring_sync( ch->uring, ch->new_sockfd[index] ) == -1 ) )
+        return -1;
+    dcount = messip_sockbuf_writev( ch->new_sockfd[index], iovec, 1, msec_timeout );
+    if ( ( dcount == -1 ) && ( errno == ETIMEDOUT ) )
+        return MESSIP_MSG_TIMEOUT;
     messip_log( MESSIP_LOG_INFO_VERBOSE, "ping_reply: sendmsg: dcount=%d  index=%d new_sockfd=%d errno=%d\n",
        dcount, index, ch->new_sockfd[index], errno );
-    assert( dcount == sizeof( messip_datareply_t ) );
+    assert( dcount == iovec[0].iov_len );
 
     /*--- Ok ---*/
     return 0;
 }                               // ping_reply
 
 /**
- *  TBD
+ * Enables a server to offer a shared-memory transport to the clients running on the same host.
  * 
- *  @param ch TBD
- *  @param sockfd TBD
- *  @param msec_timeout TBD
- *  @return TBD
+ * Such a client then writes its messages into a slot of a segment shared with the server, 
+ * and waits for the reply on this slot: no more data cross the socket, and no system call at 
+ * all is performed while the server keeps up with the messages. Messages and replies larger than
+ * slot_size still use the socket.
+ * 
+ * @param ch Channel returned by messip_channel_create()
+ * @param nb_slots Maximum number of clients using the shared-memory transport at the same time
+ *    (the next ones use the socket)
+ * @param slot_size Maximum length of a message or of a reply using the shared-memory transport
+ * @return 0 if no error, or -1 if an error occurred (errno is then set: EINVAL if the channel is in serve mode)
+ * 
+ * @note Must be called before the clients send their first message.
+ * 
+ * @see messip_channel_create(), messip_receive(), messip_reply()
+ */
+int messip_channel_enable_shm( messip_channel_t *ch, int nb_slots, int slot_size ) {
+    messip_shm_t *shm;
+
+    if ( ( ch->shm != NULL ) || ( ch->recv_sockfd_unix == -1 ) || ch->serve ) {
+        errno = EINVAL;
+        return -1;
+    }
+    shm = messip_shm_create( ch->name, nb_slots, slot_size );
+    if ( shm == NULL )
+        return -1;
+    if ( epoll_add( ch->epoll_fd, messip_shm_doorbell( shm ) ) == -1 ) {
+        messip_shm_destroy( shm );
+        return -1;
+    }
+    ch->shm = shm;
+    return 0;
+}                               // messip_channel_enable_shm
+
+/**
+ * Answer the request of a client which wants to use the shared-memory transport: 
+ * the segment and the doorbell are passed along with the slot given to this client.
+ * 
+ * @param ch Channel returned by messip_channel_create()
+ * @param sockfd Socket connected to the client
+ */
+static void shm_attach_reply( messip_channel_t *ch, SOCKET sockfd ) {
+    messip_datareply_t datareply;
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof( addr );
+    struct iovec iovec[1];
+    struct msghdr msg;
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE( 2 * sizeof( int ) )];
+    } control;
+    int slot = -1;
+    ssize_t dcount;
+
+    /*--- Only clients connected on the AF_UNIX socket are on the same host ---*/
+    if ( ( ch->shm != NULL ) && ( getsockname( sockfd, ( struct sockaddr * ) &addr, &addr_len ) == 0 )
+       && ( addr.ss_family == AF_UNIX ) )
+        slot = messip_shm_slot_alloc( ch->shm, sockfd );
+
+    IDCPY( datareply.id, ch->cnx->remote_id );
+    datareply.answer = slot;
+    datareply.datalen = ( slot != -1 ) ? messip_shm_size( ch->shm ) : 0;
+    iovec[0].iov_base = &datareply;
+    iovec[0].iov_len = sizeof( datareply );
+    memset( &msg, 0, sizeof( msg ) );
+    msg.msg_iov = iovec;
+    msg.msg_iovlen = 1;
+    if ( slot != -1 ) {
+        int fds[2] = { messip_shm_memfd( ch->shm ), messip_shm_doorbell( ch->shm ) };
+        memset( &control, 0, sizeof( control ) );
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof( control.buf );
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR( &msg );
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN( sizeof( fds ) );
+        memcpy( CMSG_DATA( cmsg ), fds, sizeof( fds ) );
+    }
+    do {
+        dcount = sendmsg( sockfd, &msg, MSG_NOSIGNAL );
+    } while ( ( dcount == -1 ) && ( errno == EINTR ) );
+    messip_log( MESSIP_LOG_INFO_VERBOSE, "shm_attach_reply: sendmsg: dcount=%d  slot=%d sockfd=%d\n",
+       dcount, slot, sockfd );
+    if ( ( dcount != sizeof( datareply ) ) && ( slot != -1 ) )
+        messip_shm_slot_release( ch->shm, sockfd );
+}                               // shm_attach_reply
+
+/**
+ * Send an acknowledgment of buffered messages
+ * 
+ *  @param ch Channel
+ *  @param sockfd Socket the buffered messages have been received on
+ *  @param count Number of messages acknowledged
+ *  @param sender Number of the sender (compact header), or -1 (legacy header)
+ *  @param msec_timeout Timeout expressed in milliseconds, or MESSIP_NOTIMEOUT
+ *  @return 0 if no error, MESSIP_MSG_TIMEOUT, or -1 if a reply queued on the socket failed
  */
-static int reply_to_thread_client_send_buffered_msg( messip_channel_t *ch, SOCKET sockfd, int msec_timeout ) {
+static int buffered_ack_write( messip_channel_t *ch, SOCKET sockfd, int32_t count, int sender, int msec_timeout ) {
     ssize_t dcount;
     struct iovec iovec[1];
     messip_datareply_t datareply;
-    fd_set ready;
-    struct timeval tv;
-    int status;
+    char wire[sizeof( messip_datareply_t )];
 
-    /*--- Message to reply back ---*/
+    /*--- Message to reply back: the number of messages acknowledged ---*/
     IDCPY( datareply.id, ch->remote_id );
     datareply.datalen = -1;
-    datareply.answer = -1;
-
-    /*--- Timeout to write ? ---*/
-    if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( sockfd, &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) sockfd + 1, NULL, &ready, NULL, &tv ); // <&>
-        assert( status != -1 );
-        if ( !FD_ISSET( sockfd, &ready ) )
-            return MESSIP_MSG_TIMEOUT;
-    }
+    datareply.answer = count;
 
-    /*--- Now wait for an answer from the server ---*/
-    iovec[0].iov_base = &datareply;
-    iovec[0].iov_len = sizeof( datareply );
-    dcount = messip_writev( sockfd, iovec, 1 );
-//  logg( NULL, "@reply_to_thread_client_send_buffered_msg to sockfd=%d: sendmsg: dcount=%d  errno=%d\n",
+    /*--- Now wait for an answer from the server (polled only if the socket is full) ---*/
+    iovec[0].iov_base = wire;
+    iovec[0].iov_len = messip_wire_reply_encode( wire, &datareply, MESSIP_WIRE_OF( sender ), sender, 0 );
+    if ( ( ch->uring != NULL ) && ( messip_uring_sync( ch->uring, sockfd ) == -1 ) )
+        return -1;
+    dcount = messip_sockbuf_writev( sockfd, iovec, 1, msec_timeout );
+    if ( ( dcount == -1 ) && ( errno == ETIMEDOUT ) )
+        return MESSIP_MSG_TIMEOUT;
+//  logg( NULL, "@buffered_ack_write to sockfd=%d: sendmsg: dcount=%d  errno=%d\n",
 //        sockfd, dcount, errno );
-    assert( dcount == sizeof( messip_datareply_t ) );
+    assert( dcount == iovec[0].iov_len );
 
     /*--- Ok ---*/
     return 0;
-}                               // reply_to_thread_client_send_buffered_msg
+}                               // buffered_ack_write
 
 /**
- * Enables a server to receive messages sent on a channel owned by this server. 
- * Note that this is a blocking function, i.e. the client is blocked until not only the server has received 
- * the message, but also until the server has replied to the client (see messip_reply).
+ * Send the acknowledgment of the buffered messages received, and not acknowledged yet
  * 
- * If the message requires a reply, the value returned by messip_receive should then be used as parameter 
- * when using messip_reply.
+ *  @param ch Channel
+ *  @param msec_timeout Timeout expressed in milliseconds, or MESSIP_NOTIMEOUT
+ *  @return 0 if no error, or MESSIP_MSG_TIMEOUT
+ */
+static int buffered_ack_flush( messip_channel_t *ch, int msec_timeout ) {
+    int status;
+
+    status = buffered_ack_write( ch, ch->buffered_unacked_sockfd, ch->buffered_unacked, ch->buffered_unacked_sender,
+       msec_timeout );
+    if ( status == 0 )
+        ch->buffered_unacked = 0;
+    return status;
+}                               // buffered_ack_flush
+
+/**
+ * Acknowledge a buffered message, to the messip manager or to the client which sent it directly 
+ * (MESSIP_BUFFERED_DIRECT). The acknowledgments are batched: one is sent for up to 
+ * MESSIP_BUFFERED_ACK_BATCH messages, or as soon as no other message is waiting in the socket - 
+ * the sender then has nothing more in flight. They are counted for one socket at a time.
  * 
- * @param ch channel connection (to the server) structure which was returned by messip_channel_connect() 
- * @param type 32-bits numbers that can be used optionally to identify the kind of message sent to the serve.
- * @param rec_buffer pointer to the buffer where the message sent will be stored. 
- *    If set to an address of a pointer and if max_len is set to 0, then the buffer is dynamically allocated, 
- *    it then will have to be free-ed later.
- * @param maxlen maximum length of the message that can be stored in the receiving buffer. If the server has sent more bytes,
- *     the whole call is failing.
- * @param msec_timeout if not 0, is a timeout (expressed in milliseconds) where the function exits if connection 
- *     with the messip manager fails.
- * @return A status of the operation:
-  *   - -1 if an error occurred (errno is then set). 
- *   - MESSIP_MSG_DISCONNECT: the client has called messip_channel_disconnect
- *   - MESSIP_MSG_DISMISSED: the connection between the client and the server has been broken. The main reason is that the client died
- *   - MESSIP_MSG_TIMEOUT: the operation timed out.
- *   - MESSIP_MSG_TIMER: a timer has been triggered on this channel.
- *   - MESSIP_MSG_NOREPLY: the message received was not an Asynchronous message, 
- *     and therefore does not require a reply.
- *   - Any other value (i.e. >= 0) is the parameter to use with messip_reply or messip_receive_more:
- *      - ETIMEDOUT  occurs if the client owning the channel did not received the message replied back 
- *                   within the expressed time.
- *      - ENOMEM     out of memory.
- *      - EFAULT     buffer points outside your accessible address space.
- *      - ECONNRESET Message has been received, but reply fails because the initial sender lost the connection 
- *                   with the server.
+ *  @param ch Channel
+ *  @param sockfd Socket the buffered message has been received on
+ *  @param sender Number of the sender (compact header), or -1 (legacy header)
+ *  @param msec_timeout Timeout expressed in milliseconds, or MESSIP_NOTIMEOUT
+ *  @return 0 if no error, or MESSIP_MSG_TIMEOUT
+ */
+static int reply_to_thread_client_send_buffered_msg( messip_channel_t *ch, SOCKET sockfd, int sender, int msec_timeout ) {
+    int pending;
+    int status;
+
+    /*--- Serve mode: the next message of this socket may go to another thread, so do not batch ---*/
+    if ( ch->serve )
+        return buffered_ack_write( ch, sockfd, 1, sender, msec_timeout );
+
+    /*--- Messages from another sender are waiting for their acknowledgment ? ---*/
+    if ( ( ch->buffered_unacked > 0 )
+       && ( ( ch->buffered_unacked_sockfd != sockfd ) || ( ch->buffered_unacked_sender != sender ) ) ) {
+        if ( ( status = buffered_ack_flush( ch, msec_timeout ) ) != 0 )
+            return status;
+    }
+    ch->buffered_unacked_sockfd = sockfd;
+    ch->buffered_unacked_sender = sender;
+
+    /*--- Wait for more messages ? (read ahead already, or still in the socket) ---*/
+    if ( ( ++ch->buffered_unacked < MESSIP_BUFFERED_ACK_BATCH )
+       && ( ( messip_sockbuf_pending( sockfd ) > 0 )
+          || ( ( ioctl( sockfd, FIONREAD, &pending ) == 0 ) && ( pending > 0 ) ) ) )
+        return 0;
+
+    return buffered_ack_flush( ch, msec_timeout );
+}                               // reply_to_thread_client_send_buffered_msg
+
+/**
+ * messip_receive() of a message written by a client into its slot of the shared-memory segment
  * 
- * @see messip_channel_create(), messip_reply(), messip_receive_more(), messip_send()
+ * @param ch Channel returned by messip_channel_create()
+ * @param index Index to be returned by messip_receive()
+ * @param slot Slot holding the message
+ * @param type Set to the type of the message
+ * @param rec_buffer See messip_receive()
+ * @param maxlen See messip_receive()
+ * @param info Header of the message, if only the header is received (see messip_receive_header()), or NULL
+ * @return index, or MESSIP_NOK if an error occurred (errno is then set)
  */
-int messip_receive( messip_channel_t *ch, int32_t *type, void *rec_buffer, int maxlen, int msec_timeout ) {
+static int shm_receive( messip_channel_t *ch, int index, int slot, int32_t *type, void *rec_buffer, int maxlen,
+	messip_msginfo_t *info ) {
+    messip_datasend_t datasend = messip_shm_slot( ch->shm, slot )->datasend;
+    char *data = ( char * ) messip_shm_slot_data( ch->shm, slot );
+    int32_t len_to_read;
+    void *rbuff;
+
+    /*--- The length is written by the client ---*/
+    if ( ( datasend.datalen < 0 ) || ( datasend.datalen > messip_shm_slot_size( ch->shm ) ) )
+        datasend.datalen = 0;
+
+    ch->new_sockfd[index] = messip_shm_slot_owner( ch->shm, slot );
+    ch->new_shm_slot[index] = slot;
+    ch->receive_sender[index] = -1;
+    IDCPY( ch->remote_id, datasend.id );
+    *type = datasend.type;
+    ch->datalen = datasend.datalen;
+
+    /*--- Dynamic allocation asked ? ---*/
+    if ( ( rec_buffer != NULL ) && ( maxlen == 0 ) ) {
+        rbuff = buffer_alloc( ch, datasend.datalen );
+        if ( rbuff == NULL ) {
+            ch->new_sockfd[index] = -1;
+            ch->new_shm_slot[index] = -1;
+            errno = ENOMEM;
+            return MESSIP_NOK;
+        }
+        len_to_read = datasend.datalen;
+        memcpy( rbuff, data, len_to_read );
+        *( void ** ) rec_buffer = rbuff;
+    }
+    else {
+        len_to_read = ( maxlen < datasend.datalen ) ? maxlen : datasend.datalen;
+        if ( len_to_read > 0 )
+            memcpy( rec_buffer, data, len_to_read );
+    }
+
+    /*
+     * Keep the whole message - used by messip_receive_more()
+     * Will be free-ed by Reply(). Useless in lazy mode: the message stays in the slot.
+     */
+    ch->receive_allmsg_sz[index] = datasend.datalen;
+    ch->receive_offset[index] = len_to_read;
+    ch->receive_flag[index] = datasend.flag;
+    ch->receive_reqid[index] = 0;
+    if ( ( ch->receive_mode == MESSIP_RECEIVE_COPY ) && ( info == NULL ) ) {
+        ch->receive_allmsg[index] = buffer_alloc( ch, datasend.datalen );
+
+        /*--- Out of memory: messip_receive_more() reads the slot then, as in lazy mode ---*/
+        if ( ch->receive_allmsg[index] != NULL )
+            memcpy( ch->receive_allmsg[index], data, datasend.datalen );
+    }
+    ch->datalenr = ( ( rec_buffer != NULL ) && ( maxlen != 0 ) && ( maxlen < datasend.datalen ) ) ?
+       datasend.datalen : len_to_read;
+    if ( info != NULL )
+        msginfo_set( info, &datasend );
+
+    ch->nb_replies_pending++;
+    return index;
+}                               // shm_receive
+
+/**
+ * Read the header of a message sent to a channel: compact, or legacy (see messip_wire.c)
+ * 
+ * @param ch Channel returned by messip_channel_create()
+ * @param sockfd Socket of the client
+ * @param datasend Set to the header
+ * @param sender Set to the number of the client, if the reply has to use the compact header, or to -1
+ * @param reqid Set to the request id of an asynchronous send (only the compact header has one), or to 0
+ * @return Same as messip_sockbuf_readv() (errno is set to EPROTO if the number of the client is unknown)
+ */
+static int datasend_read( messip_channel_t *ch, SOCKET sockfd, messip_datasend_t *datasend, int *sender, uint32_t *reqid ) {
+    union {
+        messip_datasend_t legacy;
+        messip_wire_send_t compact;
+    } wire;
+    struct iovec iovec[1];
+    const char *id;
+    int dcount;
+
+    /*--- The first bytes tell the format (the compact header is the shortest) ---*/
+    iovec[0].iov_base = &wire;
+    iovec[0].iov_len = sizeof( messip_wire_send_t );
+    dcount = messip_sockbuf_readv( sockfd, iovec, 1, !ch->serve );
+    if ( dcount <= 0 )
+        return dcount;
+    if ( wire.compact.version == MESSIP_WIRE_V2 ) {
+        *sender = messip_wire_send_decode( datasend, reqid, &wire );
+        id = messip_wire_ids_lookup( ch->wire_ids, *sender );
+        if ( id == NULL ) {
+            errno = EPROTO;
+            return -1;
+        }
+        IDCPY( datasend->id, id );
+        return dcount;
+    }
+
+    /*--- Legacy header: read the rest of it ---*/
+    iovec[0].iov_base = ( char * ) &wire + sizeof( messip_wire_send_t );
+    iovec[0].iov_len = sizeof( messip_datasend_t ) - sizeof( messip_wire_send_t );
+    dcount = messip_sockbuf_readv( sockfd, iovec, 1, !ch->serve );
+    if ( dcount <= 0 ) {
+        if ( dcount == 0 )
+            errno = ECONNRESET;
+        return -1;
+    }
+    *datasend = wire.legacy;
+    *sender = -1;
+
+    /*--- Compact header offered: number the client, the reply to the ping tells it its number ---*/
+    if ( ( datasend->flag == MESSIP_FLAG_PING ) && ( datasend->type == MESSIP_WIRE_OFFER ) && ( ch->wire_ids != NULL ) )
+        *sender = messip_wire_ids_intern( ch->wire_ids, datasend->id );
+    return sizeof( messip_datasend_t );
+}                               // datasend_read
+
+/**
+ * messip_receive(), or messip_receive_header() if info is set, into the index given
+ * 
+ * @param index Index to be returned, if the message has to be replied
+ * @param info Header of the message, if only the header is received (the payload is left
+ *    in the socket or in the shared-memory slot), or NULL
+ * @see messip_receive()
+ */
+static int receive_slot( messip_channel_t *ch, int index, int32_t *type, void *rec_buffer, int maxlen, int msec_timeout,
+	messip_msginfo_t *info ) {
     ssize_t dcount;
     struct iovec iovec[3];
     messip_datasend_t datasend;
     SOCKET new_sockfd = -1;
     struct sockaddr_in client_addr;
     socklen_t client_addr_len;
-    fd_set ready;
-    struct timeval tv;
+    struct epoll_event event;
+    int timeout;
     int status;
     int32_t len, len_to_read;
-    int n, k, nothing, index;
+    int shm_slot;
+    int watched;
+    int sender = -1;
+    uint32_t reqid = 0;
     void *rbuff = NULL;
 
-    if ( ch->nb_replies_pending == ch->new_sockfd_sz ) {
-        ch->new_sockfd = ( SOCKET * ) realloc( ch->new_sockfd, sizeof( SOCKET * ) * ( ch->new_sockfd_sz + 1 ) );
-        ch->new_sockfd[ch->new_sockfd_sz] = -1;
-        ch->receive_allmsg = ( void ** ) realloc( ch->receive_allmsg, sizeof( void * ) * ( ch->new_sockfd_sz + 1 ) );
-        ch->receive_allmsg_sz = ( int * ) realloc( ch->receive_allmsg_sz, sizeof( int * ) * ( ch->new_sockfd_sz + 1 ) );
-        ch->receive_allmsg[ch->new_sockfd_sz] = NULL;
-        index = ch->new_sockfd_sz++;
-    }
-    else {
-        for ( index = 0; index < ch->new_sockfd_sz; index++ )
-            if ( ch->new_sockfd[index] == -1 )
-                break;
-        assert( index < ch->new_sockfd_sz );
-    }
-
   restart:
 
-    /*--- Timeout ? ---*/
+    /*--- Wait until one of the sockets is ready (cost is O(ready), not O(connected)) ---*/
+    if ( msec_timeout == MESSIP_NOTIMEOUT )
+        timeout = -1;
+    else if ( msec_timeout == 1 )
+        timeout = 0;
+    else
+        timeout = msec_timeout;
+
+    /*--- Next message of a client read ahead already: no need to ask epoll ---*/
+    if ( ch->nb_rx_ready > 0 ) {
+        new_sockfd = ch->rx_ready[--ch->nb_rx_ready];
+        goto client_ready;
+    }
+    shm_slot = -1;
+    if ( ch->shm != NULL )
+        shm_slot = ( timeout == 0 ) ? messip_shm_pop( ch->shm ) : messip_shm_sleep_prepare( ch->shm );
+    if ( shm_slot != -1 )
+        return shm_receive( ch, index, shm_slot, type, rec_buffer, maxlen, info );
     do {
-        SOCKET maxfd = 0;
-        FD_ZERO( &ready );
-        for ( n = 0; n < ch->recv_sockfd_sz; n++ ) {
-            FD_SET( ch->recv_sockfd[n], &ready );
-            if ( ch->recv_sockfd[n] > maxfd )
-                maxfd = ch->recv_sockfd[n];
-        }
-        if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-            if ( msec_timeout == 1 ) {
-                tv.tv_sec = 0;
-                tv.tv_usec = 1;
-            }
-            else {
-                tv.tv_sec = msec_timeout / 1000;
-                tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-            }
-            status = select( ( int ) maxfd + 1, &ready, NULL, NULL, &tv );
-        }
-        else {
-            status = select( ( int ) maxfd + 1, &ready, NULL, NULL, NULL );
-        }
+        status = epoll_wait( ch->epoll_fd, &event, 1, timeout );
     } while ( ( status == -1 ) && ( errno == EINTR ) );
+    if ( ( ch->shm != NULL ) && ( timeout != 0 ) )
+        messip_shm_sleep_done( ch->shm );
     if ( status == -1 )
         return -1;
-    if ( ( msec_timeout != MESSIP_NOTIMEOUT ) && ( status == 0 ) ) {
+    if ( status == 0 ) {
+        *type = -1;
         ch->new_sockfd[index] = -1;
         return MESSIP_MSG_TIMEOUT;
     }
 
-    for ( nothing = 1, n = 0; n < ch->recv_sockfd_sz; n++ ) {
-        if ( FD_ISSET( ch->recv_sockfd[n], &ready ) ) {
-            nothing = 0;
-            break;
+    /*--- Doorbell rung by a client using the shared-memory transport ---*/
+    if ( ( ch->shm != NULL ) && ( event.data.fd == messip_shm_doorbell( ch->shm ) ) )
+        goto restart;
+
+    /*--- Timers: whichever channel sees the timerfd first advances the wheel of the process ---*/
+    if ( ch->timers != NULL ) {
+        if ( event.data.fd == messip_timer_engine_fd(  ) ) {
+            messip_timer_expire(  );
+            goto restart;
+        }
+        if ( event.data.fd == messip_timer_queue_fd( ch->timers ) ) {
+            if ( !messip_timer_queue_pop( ch->timers, type ) )
+                goto restart;
+            ch->datalen = -1;
+            ch->datalenr = 0;
+            ch->new_sockfd[index] = -1;
+            return MESSIP_MSG_TIMER;
         }
-    }
-    if ( nothing ) {
-        *type = -1;
-        ch->new_sockfd[index] = -1;
-        return MESSIP_MSG_TIMEOUT;
     }
 
     /*--- Accept a new connection ---*/
-    if ( !n ) {
+    if ( ( event.data.fd == ch->recv_sockfd ) || ( event.data.fd == ch->recv_sockfd_unix ) ) {
         client_addr_len = sizeof( struct sockaddr_in );
         errno = 9999;
-        new_sockfd = accept( ch->recv_sockfd[0], ( struct sockaddr * ) &client_addr, &client_addr_len );
+        new_sockfd = accept( event.data.fd, ( struct sockaddr * ) &client_addr, &client_addr_len );
         if ( new_sockfd == -1 ) {
+            channel_rearm( ch, event.data.fd );
             printf( "messip_receive) %s %d\015\012\terrno=%d\015\012", __FILE__, __LINE__, errno );
             fflush( stdout );
             ch->new_sockfd[index] = new_sockfd;
@@ -1207,29 +2321,37 @@ int messip_receive( messip_channel_t *ch, int32_t *type, void *rec_buffer, int m
 //      logg( NULL,
 //         "%s: accepted a msg from %s, port=%d  - old socket=%d new=%d\n",
 //            __FUNCTION__,
-//            inet_ntoa( client_addr.sin_addr ), client_addr.sin_port, ch->recv_sockfd[0],
+//            inet_ntoa( client_addr.sin_addr ), client_addr.sin_port, ch->recv_sockfd,
 //            new_sockfd );
-        ch->recv_sockfd[ch->recv_sockfd_sz++] = new_sockfd;
+        channel_rearm( ch, event.data.fd );
+        if ( channel_watch( ch, new_sockfd ) == -1 ) {
+            closesocket( new_sockfd );
+            ch->new_sockfd[index] = -1;
+            return -1;
+        }
+        __atomic_add_fetch( &ch->recv_sockfd_sz, 1, __ATOMIC_RELAXED );
+
+        /*--- Serve mode: the socket is already reported to the threads, let the one woken up read it ---*/
+        if ( ch->serve )
+            goto restart;
     }
     else {
-        new_sockfd = ch->recv_sockfd[n];
+        new_sockfd = event.data.fd;
+        channel_read_ahead_done( ch, new_sockfd );
     }
 
+  client_ready:
+
     /*--- Create a new channel info ---*/
     ch->new_sockfd[index] = new_sockfd;
+    ch->new_shm_slot[index] = -1;
 //  logg( NULL, "@messip_receive: pending=%d sz=%d new_sockfd=%d index=%d\n",
 //      ch->nb_replies_pending, ch->new_sockfd_sz, new_sockfd, index );
 
-    /*--- (R1) First read the fist part of the message ---*/
-    iovec[0].iov_base = &datasend;
-    iovec[0].iov_len = sizeof( datasend );
-    dcount = messip_readv( new_sockfd, iovec, 1 );
-    if ( ( dcount == 0 ) || ( ( dcount == -1 ) && ( errno == ECONNRESET ) ) ) {
-        shutdown( ch->recv_sockfd[n], SHUT_RDWR );
-        closesocket( ch->recv_sockfd[n] );
-        for ( k = n + 1; k < ch->recv_sockfd_sz; k++ )
-            ch->recv_sockfd[k - 1] = ch->recv_sockfd[k];
-        ch->recv_sockfd_sz--;
+    /*--- (R1) First read the fist part of the message (and whatever follows, unless in serve mode) ---*/
+    dcount = datasend_read( ch, new_sockfd, &datasend, &sender, &reqid );
+    if ( ( dcount == 0 ) || ( ( dcount == -1 ) && ( ( errno == ECONNRESET ) || ( errno == EPROTO ) ) ) ) {
+        channel_close_socket( ch, new_sockfd );
         goto restart;
     }
     if ( dcount == -1 ) {
@@ -1238,8 +2360,15 @@ int messip_receive( messip_channel_t *ch, int32_t *type, void *rec_buffer, int m
         ch->new_sockfd[index] = new_sockfd;
         return -1;
     }
-    if ( datasend.flag == MESSIP_FLAG_CONNECTING )
+    if ( datasend.flag == MESSIP_FLAG_CONNECTING ) {
+        channel_rearm( ch, new_sockfd );
+        goto restart;
+    }
+    if ( datasend.flag == MESSIP_FLAG_SHM_ATTACH ) {
+        shm_attach_reply( ch, new_sockfd );
+        channel_rearm( ch, new_sockfd );
         goto restart;
+    }
 //  logg( NULL, "@messip_receive part1: dcount=%d state=%d datalen=%d flags=%d\n",
 //        dcount, datasend.state, datasend.datalen, datasend.flag );
 
@@ -1248,12 +2377,14 @@ int messip_receive( messip_channel_t *ch, int32_t *type, void *rec_buffer, int m
     if ( datasend.flag == MESSIP_FLAG_DISCONNECTING ) {
         *type = ( int32_t ) new_sockfd;
         ch->new_sockfd[index] = -1;
+        channel_rearm( ch, new_sockfd );
         return MESSIP_MSG_DISCONNECT;
     }                           // if
     if ( datasend.flag == MESSIP_FLAG_DISMISSED ) {
         *type = ( int32_t ) new_sockfd;
-        *type = ( int32_t ) ch->recv_sockfd[0];
+        *type = ( int32_t ) ch->recv_sockfd;
         ch->new_sockfd[index] = -1;
+        channel_rearm( ch, new_sockfd );
         return MESSIP_MSG_DISMISSED;
     }                           // if
     if ( datasend.flag == MESSIP_FLAG_DEATH_PROCESS ) {
@@ -1264,18 +2395,13 @@ int messip_receive( messip_channel_t *ch, int32_t *type, void *rec_buffer, int m
 //      return MESSIP_MSG_DEATH_PROCESS;
     }                           // if
 
-    /*--- If message was a timer, nothing additional to read ---*/
     *type = datasend.type;
-    if ( datasend.flag == MESSIP_FLAG_TIMER ) {
-        ch->datalen = -1;
-        ch->datalenr = ( int32_t ) new_sockfd;
-        ch->new_sockfd[index] = -1;
-        return MESSIP_MSG_TIMER;
-    }
+    ch->receive_sender[index] = sender;
 
     /*--- If message is a ping, reply to the sender ---*/
     if ( datasend.flag == MESSIP_FLAG_PING ) {
         ping_reply( ch, index, msec_timeout );
+        channel_rearm( ch, new_sockfd );
         goto restart;
     }
 
@@ -1285,7 +2411,7 @@ int messip_receive( messip_channel_t *ch, int32_t *type, void *rec_buffer, int m
     iovec[0].iov_base = &len;
     iovec[0].iov_len = sizeof( uint32_t );
     if ( ( rec_buffer != NULL ) && ( maxlen == 0 ) ) {
-        rbuff = ( void * ) malloc( datasend.datalen );
+        rbuff = buffer_alloc( ch, datasend.datalen );
         if ( rbuff == NULL ) {
             ch->new_sockfd[index] = -1;
             errno = ENOMEM;
@@ -1301,16 +2427,12 @@ int messip_receive( messip_channel_t *ch, int32_t *type, void *rec_buffer, int m
         iovec[1].iov_len = len_to_read;
     }
 
-    /*--- (R2) Now read the message, unless if it's a timer ---*/
-    dcount = messip_readv( new_sockfd, iovec, 2 );
+    /*--- (R2) Now read the message: usually read ahead by R1 already ---*/
+    dcount = messip_sockbuf_readv( new_sockfd, iovec, 2, !ch->serve );
 //  logg( NULL, "@messip_receive part2: dcount=%d len_to_read=%d\n",
 //        dcount, len_to_read );
     if ( ( dcount == 0 ) || ( ( dcount == -1 ) && ( errno == ECONNRESET ) ) ) {
-        shutdown( ch->recv_sockfd[n], SHUT_RDWR );
-        closesocket( ch->recv_sockfd[n] );
-        for ( k = n + 1; k < ch->recv_sockfd_sz; k++ )
-            ch->recv_sockfd[k - 1] = ch->recv_sockfd[k];
-        ch->recv_sockfd_sz--;
+        channel_close_socket( ch, new_sockfd );
         goto restart;
     }
     if ( dcount == -1 ) {
@@ -1323,14 +2445,40 @@ int messip_receive( messip_channel_t *ch, int32_t *type, void *rec_buffer, int m
     ch->datalenr = len_to_read;
 
     /*
-     * Allocate a temp buffer to hold the whole message - used by Msgread()
+     * Allocate a temp buffer to hold the whole message - used by messip_receive_more()
      * Will be free-ed by Reply()
      */
-    if ( datasend.flag != MESSIP_FLAG_BUFFERED ) {
-        ch->receive_allmsg[index] = malloc( datasend.datalen );
+    ch->receive_offset[index] = len_to_read;
+    ch->receive_flag[index] = datasend.flag;
+    ch->receive_reqid[index] = reqid;
+    watched = 1;
+    if ( info != NULL ) {
+
+        /*--- Header only: the payload stays in the socket, until messip_receive_payload() ---*/
+        ch->receive_allmsg[index] = NULL;
         ch->receive_allmsg_sz[index] = datasend.datalen;
-        assert( len_to_read <= datasend.datalen );
-        memmove( ch->receive_allmsg[index], rec_buffer, len_to_read );
+        if ( ( datasend.datalen > 0 ) && !ch->serve ) {
+            epoll_ctl( ch->epoll_fd, EPOLL_CTL_DEL, new_sockfd, NULL );
+            watched = 0;
+        }
+        msginfo_set( info, &datasend );
+    }
+    else if ( datasend.flag != MESSIP_FLAG_BUFFERED ) {
+        ch->receive_allmsg_sz[index] = datasend.datalen;
+        if ( ch->receive_mode == MESSIP_RECEIVE_LAZY ) {
+
+            /*--- Nothing copied: what did not fit stays in the socket, until messip_receive_more() or Reply() ---*/
+            ch->receive_allmsg[index] = NULL;
+            if ( ( len_to_read < datasend.datalen ) && !ch->serve ) {
+                epoll_ctl( ch->epoll_fd, EPOLL_CTL_DEL, new_sockfd, NULL );
+                watched = 0;
+            }
+        }
+        else {
+            ch->receive_allmsg[index] = buffer_alloc( ch, datasend.datalen );
+            assert( len_to_read <= datasend.datalen );
+            memmove( ch->receive_allmsg[index], iovec[1].iov_base, len_to_read );
+        }
     }
     else {
         ch->receive_allmsg[index] = NULL;
@@ -1341,15 +2489,15 @@ int messip_receive( messip_channel_t *ch, int32_t *type, void *rec_buffer, int m
      * Read more data ? (provided buffer was too small)
      */
 //  logg( NULL, "+++ datalen=%d maxlen=%d\n", datasend.datalen, maxlen );
-    if ( ( rec_buffer != NULL ) && ( maxlen != 0 ) && ( maxlen < datasend.datalen ) ) {
+    if ( ( len_to_read < datasend.datalen ) && ( ch->receive_allmsg[index] != NULL ) ) {
 
-        /*--- Now read the message, unless if it's a timer ---*/
+        /*--- Now read the rest of the message ---*/
         char *t = ( char * ) ch->receive_allmsg[index];
         iovec[0].iov_base = &t[len_to_read];
-        len_to_read = ch->datalen - maxlen;
+        len_to_read = ch->datalen - len_to_read;
         iovec[0].iov_len = len_to_read;
-        dcount = messip_readv( new_sockfd, iovec, 1 );
-        if ( dcount == -1 ) {
+        dcount = messip_sockbuf_readv( new_sockfd, iovec, 1, !ch->serve );
+        if ( dcount <= 0 ) {
             messip_log( MESSIP_LOG_INFO, "messip_receive_more) %s %d\n\tdcount=%d  errno=%d\n",
                __FILE__, __LINE__, dcount, errno );
             return -1;
@@ -1360,23 +2508,1079 @@ int messip_receive( messip_channel_t *ch, int32_t *type, void *rec_buffer, int m
         ch->datalenr += len_to_read;
 
     }
+    else if ( ( len_to_read < datasend.datalen ) && ( datasend.flag == MESSIP_FLAG_BUFFERED ) && ( info == NULL ) ) {
+
+        /*--- Buffered message larger than the buffer: no reply will come to discard the rest ---*/
+        messip_sockbuf_drain( new_sockfd, datasend.datalen - len_to_read, !ch->serve );
+    }
 
     /*--- Dynamic allocation ? ---*/
     if ( ( rec_buffer != NULL ) && ( maxlen == 0 ) )
         *( void ** ) rec_buffer = rbuff;
 
     /*--- Ok ---*/
-    if ( datasend.flag == MESSIP_FLAG_BUFFERED ) {
-        reply_to_thread_client_send_buffered_msg( ch, new_sockfd, msec_timeout );
+    if ( ( datasend.flag == MESSIP_FLAG_BUFFERED ) && ( info == NULL ) ) {
+        reply_to_thread_client_send_buffered_msg( ch, new_sockfd, sender, msec_timeout );
 //      reply_to_thread_client_send_buffered_msg( ch->cnx->sockfd, msec_timeout );
         ch->new_sockfd[index] = -1;
+        channel_rearm( ch, new_sockfd );
         return MESSIP_MSG_NOREPLY;
     }
     else {
-        ch->nb_replies_pending++;
+        __atomic_add_fetch( &ch->nb_replies_pending, 1, __ATOMIC_RELAXED );
+        if ( watched )
+            channel_read_ahead( ch, new_sockfd );
         return index;
     }
-}                               // messip_receive
+}                               // receive_slot
+
+/**
+ * messip_receive(), or messip_receive_header() if info is set
+ * 
+ * @param info Header of the message, if only the header is received (the payload is left
+ *    in the socket or in the shared-memory slot), or NULL
+ * @see messip_receive()
+ */
+static int receive_message( messip_channel_t *ch, int32_t *type, void *rec_buffer, int maxlen, int msec_timeout,
+	messip_msginfo_t *info ) {
+    int index, status;
+
+    index = slot_get( ch );
+    if ( index == -1 )
+        return -1;
+    status = receive_slot( ch, index, type, rec_buffer, maxlen, msec_timeout, info );
+
+    /*--- Nothing to reply: the index is free again ---*/
+    if ( ( status != index ) || ( ch->new_sockfd[index] == -1 ) )
+        slot_put( ch, index );
+    return status;
+}                               // receive_message
+
+/**
+ * Enables a server to receive messages sent on a channel owned by this server. 
+ * Note that this is a blocking function, i.e. the client is blocked until not only the server has received 
+ * the message, but also until the server has replied to the client (see messip_reply).
+ * 
+ * If the message requires a reply, the value returned by messip_receive should then be used as parameter 
+ * when using messip_reply.
+ * 
+ * @param ch channel connection (to the server) structure which was returned by messip_channel_connect() 
+ * @param type 32-bits numbers that can be used optionally to identify the kind of message sent to the serve.
+ * @param rec_buffer pointer to the buffer where the message sent will be stored. 
+ *    If set to an address of a pointer and if max_len is set to 0, then the buffer is dynamically allocated, 
+ *    it then will have to be free-ed later.
+ * @param maxlen maximum length of the message that can be stored in the receiving buffer. If the server has sent more bytes,
+ *     the whole call is failing.
+ * @param msec_timeout if not 0, is a timeout (expressed in milliseconds) where the function exits if connection 
+ *     with the messip manager fails.
+ * @return A status of the operation:
+  *   - -1 if an error occurred (errno is then set). 
+ *   - MESSIP_MSG_DISCONNECT: the client has called messip_channel_disconnect
+ *   - MESSIP_MSG_DISMISSED: the connection between the client and the server has been broken. The main reason is that the client died
+ *   - MESSIP_MSG_TIMEOUT: the operation timed out.
+ *   - MESSIP_MSG_TIMER: a timer has been triggered on this channel.
+ *   - MESSIP_MSG_NOREPLY: the message received was not an Asynchronous message, 
+ *     and therefore does not require a reply.
+ *   - Any other value (i.e. >= 0) is the parameter to use with messip_reply or messip_receive_more:
+ *      - ETIMEDOUT  occurs if the client owning the channel did not received the message replied back 
+ *                   within the expressed time.
+ *      - ENOMEM     out of memory.
+ *      - EFAULT     buffer points outside your accessible address space.
+ *      - ECONNRESET Message has been received, but reply fails because the initial sender lost the connection 
+ *                   with the server.
+ * 
+ * @see messip_channel_create(), messip_reply(), messip_receive_more(), messip_send()
+ */
+int messip_receive( messip_channel_t *ch, int32_t *type, void *rec_buffer, int maxlen, int msec_timeout ) {
+    return receive_message( ch, type, rec_buffer, maxlen, msec_timeout, NULL );
+}                               // messip_receive
+
+/**
+ * First phase of a two-phase receive: wait for a message, and return only its header. 
+ * The payload is not read: knowing its type and length, the server then chooses where to 
+ * store it, and reads it with messip_receive_payload() - without any intermediate copy.
+ * 
+ * @param ch Channel returned by messip_channel_create()
+ * @param info Set to the header of the message (type, length of the payload, sender)
+ * @param msec_timeout Timeout expressed in milliseconds, or MESSIP_NOTIMEOUT
+ * @return Same as messip_receive(). If >= 0, the index to use with messip_receive_payload(), 
+ *    then with messip_reply() - unless info->noreply is set.
+ * 
+ * @note For an asynchronous message (info->noreply set), messip_receive_payload() must always be 
+ *    called: it acknowledges the message. For a synchronous message, messip_reply() discards 
+ *    the payload not read.
+ * 
+ * @see messip_receive_payload(), messip_receive()
+ */
+int messip_receive_header( messip_channel_t *ch, messip_msginfo_t *info, int msec_timeout ) {
+    int32_t type;
+    return receive_message( ch, &type, NULL, 0, msec_timeout, info );
+}                               // messip_receive_header
+
+/**
+ * The payload of a message could not be read: the stream of its client is lost. Close its
+ * socket and give back the index (a messip_reply() on it fails then). errno is preserved.
+ * 
+ * @param ch Channel returned by messip_channel_create()
+ * @param index Index returned by messip_receive_header()
+ */
+static void receive_abort( messip_channel_t *ch, int index ) {
+    int error = errno;
+
+    channel_close_socket( ch, ch->new_sockfd[index] );
+    __atomic_sub_fetch( &ch->nb_replies_pending, 1, __ATOMIC_RELAXED );
+    ch->receive_allmsg_sz[index] = 0;
+    ch->receive_offset[index] = 0;
+    ch->receive_flag[index] = 0;
+    slot_put( ch, index );
+    errno = error;
+}                               // receive_abort
+
+/**
+ * Second phase of a two-phase receive: read the payload of a message (or what has not been read yet)
+ * straight into the segments given. What does not fit in the segments is discarded.
+ * 
+ * @param ch Channel returned by messip_channel_create()
+ * @param index value previously returned by messip_receive_header()
+ * @param iov Segments where to store the payload
+ * @param iovcnt Number of segments, at most MESSIP_IOV_MAX (can be 0, to discard the payload)
+ * @return The number of bytes stored, or -1 if an error occurred (errno is then set). If the socket 
+ *    could not be read, the connection of the client is closed and index is no longer valid.
+ * 
+ * @see messip_receive_header(), messip_reply()
+ */
+int messip_receive_payload( messip_channel_t *ch, int index, const struct iovec *iov, int iovcnt ) {
+    struct iovec iovec[MESSIP_IOV_MAX];
+    const char *src = NULL;
+    SOCKET sockfd;
+    int32_t len, stored;
+    int n;
+
+    if ( ( index < 0 ) || ( index >= ch->new_sockfd_sz ) || ( ch->new_sockfd[index] == -1 )
+       || ( iovcnt < 0 ) || ( iovcnt > MESSIP_IOV_MAX ) ) {
+        errno = EINVAL;
+        return -1;
+    }
+    sockfd = ch->new_sockfd[index];
+    len = ch->receive_allmsg_sz[index] - ch->receive_offset[index];
+    if ( len < 0 )
+        len = 0;
+
+    /*--- Segments, cut to the length of the payload ---*/
+    for ( stored = 0, n = 0; ( n < iovcnt ) && ( stored < len ); n++ ) {
+        iovec[n] = iov[n];
+        if ( iovec[n].iov_len > len - stored )
+            iovec[n].iov_len = len - stored;
+        stored += iovec[n].iov_len;
+    }
+    iovcnt = n;
+
+    /*--- Payload already in memory (whole message kept, or shared-memory slot) ---*/
+    if ( ch->receive_allmsg[index] != NULL )
+        src = ( char * ) ch->receive_allmsg[index] + ch->receive_offset[index];
+    else if ( ch->new_shm_slot[index] != -1 )
+        src = ( char * ) messip_shm_slot_data( ch->shm, ch->new_shm_slot[index] ) + ch->receive_offset[index];
+    if ( src != NULL ) {
+        for ( n = 0; n < iovcnt; src += iovec[n].iov_len, n++ )
+            memcpy( iovec[n].iov_base, src, iovec[n].iov_len );
+    }
+
+    /*--- Or still in the socket: read it, then watch the socket again ---*/
+    else if ( len > 0 ) {
+        if ( ( ( stored > 0 ) && ( messip_sockbuf_readv( sockfd, iovec, iovcnt, !ch->serve ) <= 0 ) )
+           || ( messip_sockbuf_drain( sockfd, len - stored, !ch->serve ) == -1 ) ) {
+            receive_abort( ch, index );
+            return -1;
+        }
+        if ( !ch->serve ) {
+            epoll_add( ch->epoll_fd, sockfd );
+            channel_read_ahead( ch, sockfd );
+        }
+    }
+    ch->receive_offset[index] += len;
+    ch->datalenr = stored;
+
+    /*--- Asynchronous message: acknowledge it, there will be no reply ---*/
+    if ( ch->receive_flag[index] == MESSIP_FLAG_BUFFERED ) {
+        reply_to_thread_client_send_buffered_msg( ch, sockfd, ch->receive_sender[index], MESSIP_NOTIMEOUT );
+        ch->receive_flag[index] = 0;
+        ch->receive_allmsg_sz[index] = 0;
+        __atomic_sub_fetch( &ch->nb_replies_pending, 1, __ATOMIC_RELAXED );
+        channel_rearm( ch, sockfd );
+        slot_put( ch, index );
+    }
+
+    return stored;
+}                               // messip_receive_payload
+
+/**
+ * Create an empty set of channels, to receive messages on several channels at the same time
+ * 
+ * @return The set, or NULL if an error occurred (errno is then set)
+ * 
+ * @see messip_channelset_add(), messip_channelset_receive()
+ */
+messip_channelset_t *messip_channelset_create( void ) {
+    messip_channelset_t *set;
+
+    set = ( messip_channelset_t * ) malloc( sizeof( messip_channelset_t ) );
+    if ( set == NULL ) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    set->epoll_fd = epoll_create1( EPOLL_CLOEXEC );
+    if ( set->epoll_fd == -1 ) {
+        free( set );
+        return NULL;
+    }
+    set->nb_channels = 0;
+    set->channels = NULL;
+    return set;
+}                               // messip_channelset_create
+
+/**
+ * Delete a set of channels (the channels themselves are not deleted)
+ * 
+ * @param set Set returned by messip_channelset_create()
+ */
+void messip_channelset_destroy( messip_channelset_t *set ) {
+    close( set->epoll_fd );
+    free( set->channels );
+    free( set );
+}                               // messip_channelset_destroy
+
+/**
+ * Add a channel to a set: the epoll instance of the channel is watched by the one of the set
+ * 
+ * @param set Set returned by messip_channelset_create()
+ * @param ch Channel returned by messip_channel_create()
+ * @return 0 if no error, or -1 if an error occurred (errno is then set: EEXIST if the channel
+ *    is already in the set, EINVAL if it was not created by messip_channel_create())
+ */
+int messip_channelset_add( messip_channelset_t *set, messip_channel_t *ch ) {
+    struct epoll_event event;
+    messip_channel_t **channels;
+
+    /*--- Only the channels of a server receive messages ---*/
+    if ( ch->epoll_fd == -1 ) {
+        errno = EINVAL;
+        return -1;
+    }
+    channels = ( messip_channel_t ** ) realloc( set->channels, sizeof( messip_channel_t * ) * ( set->nb_channels + 1 ) );
+    if ( channels == NULL ) {
+        errno = ENOMEM;
+        return -1;
+    }
+    set->channels = channels;
+    memset( &event, 0, sizeof( event ) );
+    event.events = EPOLLIN;
+    event.data.ptr = ch;
+    if ( epoll_ctl( set->epoll_fd, EPOLL_CTL_ADD, ch->epoll_fd, &event ) == -1 )
+        return -1;
+    set->channels[set->nb_channels++] = ch;
+    return 0;
+}                               // messip_channelset_add
+
+/**
+ * Remove a channel from a set
+ * 
+ * @param set Set returned by messip_channelset_create()
+ * @param ch Channel previously given to messip_channelset_add()
+ * @return 0 if no error, or -1 if the channel is not in the set (errno is then set to ENOENT)
+ */
+int messip_channelset_remove( messip_channelset_t *set, messip_channel_t *ch ) {
+    int n;
+
+    for ( n = 0; ( n < set->nb_channels ) && ( set->channels[n] != ch ); n++ );
+    if ( n == set->nb_channels ) {
+        errno = ENOENT;
+        return -1;
+    }
+    epoll_ctl( set->epoll_fd, EPOLL_CTL_DEL, ch->epoll_fd, NULL );
+    set->channels[n] = set->channels[--set->nb_channels];
+    return 0;
+}                               // messip_channelset_remove
+
+/**
+ * Same as messip_receive(), but on all the channels of a set: the call blocks until one of them 
+ * gets a message (or a timer, a disconnection...). Then it is received on this channel.
+ * 
+ * @param set Set returned by messip_channelset_create()
+ * @param ch Set to the channel the message has been received on. Use it with messip_reply().
+ * @param type See messip_receive()
+ * @param rec_buffer See messip_receive()
+ * @param maxlen See messip_receive()
+ * @param msec_timeout Timeout expressed in milliseconds, or MESSIP_NOTIMEOUT
+ * @return Same as messip_receive()
+ * 
+ * @see messip_channelset_create(), messip_receive(), messip_reply()
+ */
+int messip_channelset_receive( messip_channelset_t *set, messip_channel_t **ch, 
+	int32_t *type, void *rec_buffer, int maxlen, int msec_timeout ) {
+    struct timespec deadline;
+    struct epoll_event event;
+    messip_channel_t *ready;
+    int status, n;
+
+    if ( set->nb_channels == 0 ) {
+        errno = EINVAL;
+        return -1;
+    }
+    if ( msec_timeout == 1 )
+        msec_timeout = 0;
+    deadline_set( &deadline, msec_timeout );
+
+    for ( ;; ) {
+
+        /*--- Next message of a client read ahead already: the epoll instance of its channel does not report it ---*/
+        ready = NULL;
+        for ( n = 0; ( n < set->nb_channels ) && ( ready == NULL ); n++ ) {
+            if ( set->channels[n]->nb_rx_ready > 0 )
+                ready = set->channels[n];
+        }
+
+        /*--- Clients using the shared-memory transport: ring the doorbell, unless a request is there already ---*/
+        for ( n = 0; ( n < set->nb_channels ) && ( ready == NULL ); n++ ) {
+            if ( ( set->channels[n]->shm != NULL ) && messip_shm_sleep_announce( set->channels[n]->shm ) )
+                ready = set->channels[n];
+        }
+        if ( ready != NULL ) {
+            for ( n = 0; n < set->nb_channels; n++ )
+                if ( set->channels[n]->shm != NULL )
+                    messip_shm_sleep_done( set->channels[n]->shm );
+        }
+
+        /*--- Otherwise wait until one of the channels is ready ---*/
+        else {
+            do {
+                status = epoll_wait( set->epoll_fd, &event, 1, deadline_remaining( &deadline, msec_timeout ) );
+            } while ( ( status == -1 ) && ( errno == EINTR ) );
+            for ( n = 0; n < set->nb_channels; n++ )
+                if ( set->channels[n]->shm != NULL )
+                    messip_shm_sleep_done( set->channels[n]->shm );
+            if ( status == -1 )
+                return -1;
+            if ( status == 0 ) {
+                *type = -1;
+                return MESSIP_MSG_TIMEOUT;
+            }
+            ready = ( messip_channel_t * ) event.data.ptr;
+        }
+
+        /*--- Receive on this channel, without blocking (the event may have been consumed: connection, ping...) ---*/
+        status = receive_message( ready, type, rec_buffer, maxlen, 1, NULL );
+        if ( status != MESSIP_MSG_TIMEOUT ) {
+            *ch = ready;
+            return status;
+        }
+        if ( deadline_remaining( &deadline, msec_timeout ) == 0 ) {
+            *type = -1;
+            return MESSIP_MSG_TIMEOUT;
+        }
+    }                           // for (;;)
+}                               // messip_channelset_receive
+
+/**
+ * Enables a server to read the part of a message which did not fit into the buffer given to messip_receive().
+ * Successive calls return the next parts of the message.
+ * 
+ * In lazy receive mode (see messip_channel_set_receive_mode), these data are read from the socket only now; 
+ * otherwise they are copied from the whole message kept by messip_receive().
+ * 
+ * @param ch Channel returned by messip_channel_create()
+ * @param index value previously returned by messip_receive()
+ * @param buffer Buffer where to store the data
+ * @param maxlen Maximum number of bytes to store into buffer
+ * @return The number of bytes stored into buffer (0 once the whole message has been read), 
+ *    or -1 if an error occurred (errno is then set). If the socket could not be read, the connection 
+ *    of the client is closed and index is no longer valid.
+ * 
+ * @see messip_receive(), messip_reply(), messip_channel_set_receive_mode()
+ */
+int messip_receive_more( messip_channel_t *ch, int index, void *buffer, int maxlen ) {
+    struct iovec iovec[1];
+    ssize_t dcount;
+    int32_t len;
+
+    if ( ( index < 0 ) || ( index >= ch->new_sockfd_sz ) || ( ch->new_sockfd[index] == -1 ) || ( maxlen < 0 ) ) {
+        errno = EINVAL;
+        return -1;
+    }
+    len = ch->receive_allmsg_sz[index] - ch->receive_offset[index];
+    if ( len > maxlen )
+        len = maxlen;
+    if ( len <= 0 )
+        return 0;
+
+    if ( ch->receive_allmsg[index] != NULL )
+        memcpy( buffer, ( char * ) ch->receive_allmsg[index] + ch->receive_offset[index], len );
+    else if ( ch->new_shm_slot[index] != -1 )
+        memcpy( buffer, ( char * ) messip_shm_slot_data( ch->shm, ch->new_shm_slot[index] ) + ch->receive_offset[index], len );
+    else {
+        iovec[0].iov_base = buffer;
+        iovec[0].iov_len = len;
+        dcount = messip_sockbuf_readv( ch->new_sockfd[index], iovec, 1, !ch->serve );
+        if ( dcount <= 0 ) {
+            if ( dcount == 0 )
+                errno = ECONNRESET;
+            receive_abort( ch, index );
+            return -1;
+        }
+
+        /*--- Whole message read: the socket can be watched again (serve mode: once replied) ---*/
+        if ( ( ch->receive_offset[index] + len == ch->receive_allmsg_sz[index] ) && !ch->serve ) {
+            epoll_add( ch->epoll_fd, ch->new_sockfd[index] );
+            channel_read_ahead( ch, ch->new_sockfd[index] );
+        }
+    }
+    ch->receive_offset[index] += len;
+
+    return len;
+}                               // messip_receive_more
+
+/**
+ * Read the header of a reply (or of an acknowledgment) on the socket of a channel: in the format
+ * of the messages sent, or, if the compact header has been offered, in the one the server chose
+ * 
+ * @param ch Channel returned by messip_channel_connect()
+ * @param datareply Set to the header
+ * @param reqid Set to the request id of the message replied to (only the compact header has one), or to 0
+ * @return Same as messip_sockbuf_readv()
+ */
+static int datareply_read( messip_channel_t *ch, messip_datareply_t *datareply, uint32_t *reqid ) {
+    union {
+        messip_datareply_t legacy;
+        messip_wire_reply_t compact;
+    } wire;
+    struct iovec iovec[1];
+    int dcount, sender;
+    int compact = ( ch->wire_version == MESSIP_WIRE_V2 ) || ( ch->wire_version == MESSIP_WIRE_OFFERED );
+
+    /*--- The reply to a request for the shared-memory transport comes first (see shm_attach) ---*/
+    if ( ( ch->shm_slot == MESSIP_SHM_SLOT_REQUESTED ) && ( shm_attach( ch, MESSIP_NOTIMEOUT ) == -1 ) )
+        return -1;
+
+    iovec[0].iov_base = &wire;
+    iovec[0].iov_len = compact ? sizeof( messip_wire_reply_t ) : sizeof( messip_datareply_t );
+    dcount = messip_sockbuf_readv( ch->send_sockfd, iovec, 1, 1 );
+    if ( dcount <= 0 )
+        return dcount;
+
+    /*--- Compact header: the server is the one the channel is connected to ---*/
+    if ( compact && ( wire.compact.version == MESSIP_WIRE_V2 ) ) {
+        sender = messip_wire_reply_decode( datareply, reqid, &wire );
+        if ( ch->wire_version == MESSIP_WIRE_OFFERED ) {
+            ch->wire_sender = sender;
+            ch->wire_version = MESSIP_WIRE_V2;
+        }
+        IDCPY( datareply->id, ch->remote_id );
+        return dcount;
+    }
+
+    if ( ch->wire_version == MESSIP_WIRE_V2 ) {
+        errno = EPROTO;
+        return -1;
+    }
+
+    /*--- Legacy header (the server did not take the offer) ---*/
+    if ( compact ) {
+        iovec[0].iov_base = ( char * ) &wire + iovec[0].iov_len;
+        iovec[0].iov_len = sizeof( messip_datareply_t ) - iovec[0].iov_len;
+        dcount = messip_sockbuf_readv( ch->send_sockfd, iovec, 1, 1 );
+        if ( dcount <= 0 ) {
+            if ( dcount == 0 )
+                errno = ECONNRESET;
+            return -1;
+        }
+    }
+    if ( ch->wire_version == MESSIP_WIRE_OFFERED )
+        ch->wire_version = MESSIP_WIRE_LEGACY;
+    *datareply = wire.legacy;
+    *reqid = 0;
+    return sizeof( messip_datareply_t );
+}                               // datareply_read
+
+/**
+ * Read the data of a reply sent back by a server, once its header has been read
+ * 
+ * @param ch Channel returned by messip_channel_connect()
+ * @param datareply Header of the reply
+ * @param reply_buffer Buffer where to store the reply, or address of a pointer (reply_maxlen set to 0)
+ * @param reply_maxlen Maximum length for the reply
+ * @param already_read Bytes of the reply already stored into reply_buffer
+ * @return 0 if no error, or -1 if an error occurred (errno is set)
+ */
+static int send_read_reply( messip_channel_t *ch, messip_datareply_t *datareply,
+	void *reply_buffer, int reply_maxlen, int32_t already_read ) {
+    ssize_t dcount;
+    struct iovec iovec[1];
+    int32_t len_to_read;
+    void *rbuff = NULL;
+
+//  logg( NULL, "--- datalen=%d maxlen=%d\n", datareply->datalen, reply_maxlen );
+    if ( ( reply_buffer != NULL ) && ( reply_maxlen == 0 ) && ( datareply->datalen > 0 ) ) {
+        len_to_read = datareply->datalen;
+        rbuff = buffer_alloc( ch, datareply->datalen );
+        iovec[0].iov_base = rbuff;
+        iovec[0].iov_len = len_to_read;
+    }
+    else {
+        len_to_read = ( datareply->datalen < reply_maxlen ) ? datareply->datalen : reply_maxlen;
+        iovec[0].iov_base = ( char * ) reply_buffer + already_read;
+        iovec[0].iov_len = ( len_to_read > already_read ) ? len_to_read - already_read : 0;
+    }
+    if ( iovec[0].iov_len > 0 ) {
+        dcount = messip_sockbuf_readv( ch->send_sockfd, iovec, 1, 1 );
+        messip_log( MESSIP_LOG_INFO_VERBOSE, "messip_send: recvmsg dcount=%d local_fd=%d [errno=%d]\n",
+           dcount, ch->send_sockfd, errno );
+        if ( dcount == 0 ) {
+            printf( "%s %d:\015\012\terrno=%d\015\012", __FILE__, __LINE__, errno );
+            fflush( stdout );
+            errno = ECONNRESET;
+            return -1;
+        }
+        if ( dcount == -1 ) {
+            printf( "%s %d:\015\012\terrno=%d\015\012", __FILE__, __LINE__, errno );
+            fflush( stdout );
+            return -1;
+        }
+    }
+
+    /*--- Discard what did not fit: the next reply follows on the socket ---*/
+    if ( len_to_read < datareply->datalen ) {
+        if ( messip_sockbuf_drain( ch->send_sockfd, datareply->datalen - len_to_read, 1 ) == -1 )
+            return -1;
+    }
+
+    /*--- Dynamic allocation ? ---*/
+    if ( ( reply_buffer != NULL ) && ( reply_maxlen == 0 ) )
+        *( void ** ) reply_buffer = rbuff;
+
+    /*--- Ok ---*/
+    ch->datalen = datareply->datalen;
+    ch->datalenr = len_to_read;
+    IDCPY( ch->remote_id, datareply->id );
+    return 0;
+}                               // send_read_reply
+
+/**
+ * Ask the server owning a channel for its shared-memory transport. This is done only once, 
+ * and only if the client is connected on the AF_UNIX socket of the channel (same host).
+ * The reply carries the descriptors of the segment: until it has been read (shm_slot is 
+ * MESSIP_SHM_SLOT_REQUESTED), nothing else can be read on the socket.
+ * 
+ * @param ch Channel returned by messip_channel_connect()
+ * @param msec_timeout Timeout expressed in milliseconds, or MESSIP_NOTIMEOUT
+ * @return 0 once negotiated (shm_slot is set, to MESSIP_SHM_SLOT_NONE if the transport is not used), 
+ *    MESSIP_MSG_TIMEOUT if the reply has not come yet, or -1 if the connection failed (errno is set)
+ */
+static int shm_attach( messip_channel_t *ch, int msec_timeout ) {
+    messip_datasend_t datasend;
+    messip_datareply_t datareply;
+    struct iovec iovec[1];
+    struct msghdr msg;
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE( 2 * sizeof( int ) )];
+    } control;
+    int fds[2] = { -1, -1 };
+    ssize_t dcount;
+
+    /*--- Send the request, once ---*/
+    if ( ch->shm_slot == MESSIP_SHM_SLOT_UNKNOWN ) {
+        datasend.flag = MESSIP_FLAG_SHM_ATTACH;
+        IDCPY( datasend.id, ch->cnx->remote_id );
+        datasend.type = 0;
+        datasend.datalen = 0;
+        iovec[0].iov_base = &datasend;
+        iovec[0].iov_len = sizeof( datasend );
+        dcount = messip_writev( ch->send_sockfd, iovec, 1 );
+        if ( dcount != sizeof( datasend ) ) {
+            ch->shm_slot = MESSIP_SHM_SLOT_NONE;
+            return 0;
+        }
+        ch->shm_slot = MESSIP_SHM_SLOT_REQUESTED;
+    }
+
+    /*--- Then read its reply (still on its way: it will be read by the next call) ---*/
+    if ( ( msec_timeout != MESSIP_NOTIMEOUT ) && ( messip_wait_ready( ch->send_sockfd, POLLIN, msec_timeout ) <= 0 ) )
+        return MESSIP_MSG_TIMEOUT;
+    iovec[0].iov_base = &datareply;
+    iovec[0].iov_len = sizeof( datareply );
+    memset( &msg, 0, sizeof( msg ) );
+    msg.msg_iov = iovec;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof( control.buf );
+    do {
+        dcount = recvmsg( ch->send_sockfd, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL );
+    } while ( ( dcount == -1 ) && ( errno == EINTR ) );
+    for ( struct cmsghdr *cmsg = CMSG_FIRSTHDR( &msg ); cmsg != NULL; cmsg = CMSG_NXTHDR( &msg, cmsg ) ) {
+        if ( ( cmsg->cmsg_level == SOL_SOCKET ) && ( cmsg->cmsg_type == SCM_RIGHTS )
+           && ( cmsg->cmsg_len == CMSG_LEN( sizeof( fds ) ) ) )
+            memcpy( fds, CMSG_DATA( cmsg ), sizeof( fds ) );
+    }
+    ch->shm_slot = MESSIP_SHM_SLOT_NONE;
+    if ( ( dcount != sizeof( datareply ) ) || ( datareply.answer < 0 ) || ( fds[0] == -1 ) ) {
+        if ( fds[0] != -1 ) {
+            close( fds[0] );
+            close( fds[1] );
+        }
+        if ( dcount == sizeof( datareply ) )
+            return 0;
+        if ( dcount != -1 )
+            errno = ECONNRESET;
+        return -1;
+    }
+
+    ch->shm = messip_shm_attach( fds[0], datareply.datalen, fds[1] );
+    if ( ch->shm == NULL )
+        return 0;
+    ch->shm_slot = datareply.answer;
+    messip_log( MESSIP_LOG_INFO, "shm_attach: channel %s, slot %d\n", ch->name, ch->shm_slot );
+    return 0;
+}                               // shm_attach
+
+/**
+ * Read the header of a reply too large for the shared-memory slot. Requests received 
+ * in a slot carry no sender, so the server always writes this header in the legacy layout.
+ * 
+ * @param ch Channel returned by messip_channel_connect()
+ * @param datareply Where to store the header
+ * @return 0 if no error, or -1 if an error occurred (errno is set)
+ */
+static int shm_reply_header_read( messip_channel_t *ch, messip_datareply_t *datareply ) {
+    struct iovec iovec[1];
+    ssize_t dcount;
+
+    iovec[0].iov_base = datareply;
+    iovec[0].iov_len = sizeof( messip_datareply_t );
+    dcount = messip_sockbuf_readv( ch->send_sockfd, iovec, 1, 1 );
+    if ( dcount != sizeof( messip_datareply_t ) ) {
+        if ( dcount == 0 )
+            errno = ECONNRESET;
+        return -1;
+    }
+    return 0;
+}                               // shm_reply_header_read
+
+/**
+ * messip_send() over the shared-memory transport
+ * 
+ * @return 0 if no error, MESSIP_MSG_TIMEOUT, or -1 if an error occurred (errno is set)
+ * 
+ * @see messip_sendv()
+ */
+static int shm_send( messip_channel_t *ch, int32_t type, 
+	const struct iovec *send_iov, int send_iovcnt, int send_len, int32_t *answer, 
+	void *reply_buffer, int reply_maxlen, int msec_timeout ) {
+    messip_shm_slot_t *slot = messip_shm_slot( ch->shm, ch->shm_slot );
+    char *data = ( char * ) messip_shm_slot_data( ch->shm, ch->shm_slot );
+    messip_datareply_t datareply;
+    int32_t len_to_read;
+    int state;
+
+    /*--- Previous message timed out, and its reply has not been received yet ? ---*/
+    state = __atomic_load_n( &slot->state, __ATOMIC_ACQUIRE );
+    if ( state == MESSIP_SHM_REQUEST ) {
+        state = messip_shm_wait_reply( ch->shm, ch->shm_slot, msec_timeout );
+        if ( state == -1 )
+            return MESSIP_MSG_TIMEOUT;
+    }
+
+    /*--- That reply was written on the socket: discard it, or it would be taken for ours ---*/
+    if ( state == MESSIP_SHM_REPLY_SOCKET ) {
+        if ( shm_reply_header_read( ch, &datareply ) == -1 )
+            return -1;
+        if ( messip_sockbuf_drain( ch->send_sockfd, datareply.datalen, 1 ) == -1 )
+            return -1;
+        __atomic_store_n( &slot->state, MESSIP_SHM_IDLE, __ATOMIC_RELAXED );
+    }
+
+    /*--- Write the message into our slot, then wake up the server ---*/
+    slot->datasend.flag = 0;
+    IDCPY( slot->datasend.id, ch->cnx->remote_id );
+    slot->datasend.type = type;
+    slot->datasend.datalen = send_len;
+    for ( int n = 0, off = 0; n < send_iovcnt; off += send_iov[n].iov_len, n++ )
+        memcpy( data + off, send_iov[n].iov_base, send_iov[n].iov_len );
+    messip_shm_post( ch->shm, ch->shm_slot );
+
+    /*--- Wait for the reply ---*/
+    state = messip_shm_wait_reply( ch->shm, ch->shm_slot, msec_timeout );
+    if ( state == -1 )
+        return MESSIP_MSG_TIMEOUT;
+
+    /*--- Reply too large, written on the socket ---*/
+    if ( state == MESSIP_SHM_REPLY_SOCKET ) {
+        if ( shm_reply_header_read( ch, &datareply ) == -1 )
+            return -1;
+        __atomic_store_n( &slot->state, MESSIP_SHM_IDLE, __ATOMIC_RELAXED );
+        *answer = datareply.answer;
+        return send_read_reply( ch, &datareply, reply_buffer, reply_maxlen, 0 );
+    }
+
+    /*--- Reply is in our slot ---*/
+    datareply = slot->datareply;
+    *answer = datareply.answer;
+    if ( ( reply_buffer != NULL ) && ( reply_maxlen == 0 ) ) {
+        len_to_read = datareply.datalen;
+        *( void ** ) reply_buffer = ( len_to_read > 0 ) ? buffer_alloc( ch, len_to_read ) : NULL;
+        if ( len_to_read > 0 )
+            memcpy( *( void ** ) reply_buffer, data, len_to_read );
+    }
+    else {
+        len_to_read = ( datareply.datalen < reply_maxlen ) ? datareply.datalen : reply_maxlen;
+        if ( len_to_read > 0 )
+            memcpy( reply_buffer, data, len_to_read );
+    }
+
+    /*--- Ok ---*/
+    ch->datalen = datareply.datalen;
+    ch->datalenr = len_to_read;
+    IDCPY( ch->remote_id, datareply.id );
+    return 0;
+}                               // shm_send
+
+/**
+ * Read one reply on the socket of a channel, and complete the asynchronous send it belongs to
+ * 
+ * @param ch Channel returned by messip_channel_connect(), whose socket is ready to read
+ * @return 0 if no error, or -1 if the connection failed (then all the sends in flight fail)
+ */
+static int reply_dispatch( messip_channel_t *ch ) {
+    messip_datareply_t datareply;
+    messip_request_t *req, **prev;
+    uint32_t reqid;
+    int status;
+
+    status = datareply_read( ch, &datareply, &reqid );
+    if ( status <= 0 ) {
+        status = ( status == 0 ) ? ECONNRESET : errno;
+        while ( ( req = ch->requests ) != NULL ) {
+            ch->requests = req->next;
+            if ( req->released ) {
+                free( req );
+                continue;
+            }
+            req->status = -1;
+            req->error = status;
+            req->done = 1;
+        }                       // while
+        errno = status;
+        return -1;
+    }
+
+    /*--- Acknowledgment of buffered messages sent directly (see buffered_sendv) ---*/
+    if ( ( reqid == 0 ) && ( datareply.datalen == -1 ) ) {
+        ch->buffered_credits += ( datareply.answer > 0 ) ? datareply.answer : 1;
+        return 0;
+    }
+
+    /*--- Which send is it ? (usually the oldest one: always, if sent without a request id) ---*/
+    for ( prev = &ch->requests; ( *prev != NULL ) && ( ( *prev )->reqid != reqid ); prev = &( *prev )->next );
+    req = *prev;
+    if ( req == NULL )
+        return messip_sockbuf_drain( ch->send_sockfd, datareply.datalen, 1 );
+    *prev = req->next;
+
+    /*--- Released while in flight: discard the reply ---*/
+    if ( req->released ) {
+        free( req );
+        return messip_sockbuf_drain( ch->send_sockfd, datareply.datalen, 1 );
+    }
+
+    req->status = send_read_reply( ch, &datareply, req->reply_buffer, req->reply_maxlen, 0 );
+    req->error = ( req->status == -1 ) ? errno : 0;
+    req->answer = datareply.answer;
+    req->datalen = ch->datalen;
+    req->datalenr = ch->datalenr;
+    req->done = 1;
+    return ( req->status == -1 ) ? -1 : 0;
+}                               // reply_dispatch
+
+/**
+ * Wait for the acknowledgments of the buffered messages a client sent directly to the server 
+ * (MESSIP_BUFFERED_DIRECT), until enough credits are available. The replies of the asynchronous 
+ * sends read in the meantime complete their request.
+ * 
+ * @param ch Channel returned by messip_channel_connect()
+ * @param wanted Credits wanted: 1 to send a buffered message, MESSIP_BUFFERED_CREDITS for all of them
+ * @param msec_timeout Timeout expressed in milliseconds, or MESSIP_NOTIMEOUT
+ * @return 0 if no error, MESSIP_MSG_TIMEOUT, or -1 if an error occurred (errno is then set)
+ */
+static int buffered_credits_wait( messip_channel_t *ch, int wanted, int msec_timeout ) {
+    struct timespec deadline;
+    int status;
+
+    deadline_set( &deadline, msec_timeout );
+    while ( ch->buffered_credits < wanted ) {
+        status = messip_sockbuf_wait( ch->send_sockfd, deadline_remaining( &deadline, msec_timeout ) );
+        if ( status == 0 )
+            return MESSIP_MSG_TIMEOUT;
+        if ( ( status == -1 ) || ( reply_dispatch( ch ) == -1 ) )
+            return -1;
+    }                           // while
+    return 0;
+}                               // buffered_credits_wait
+
+/**
+ * Same as messip_sendv(), but does not wait for the reply: the message is written, 
+ * and a handle is returned at once. Several messages can be in flight on a channel; 
+ * the replies are matched to their handle by a request id.
+ * 
+ * @param ch channel connection (to the server) structure which was returned by messip_channel_connect()
+ * @param type 32-bits number that can be used optionally to identify the kind of message sent to the server
+ * @param send_iov Segments of the message to send (a segment can be empty)
+ * @param send_iovcnt Number of segments, at most MESSIP_IOV_MAX (can be 0)
+ * @param reply_buffer Where to store the reply once it comes (see messip_send()). It must stay valid until
+ *    the request is complete.
+ * @param reply_maxlen Maximum length for the reply
+ * 
+ * @return The handle, to give to messip_wait() then messip_request_release(), or NULL if an error 
+ *    occurred (errno is then set)
+ * 
+ * @note The shared-memory transport is not used by asynchronous sends. While some are in flight, 
+ *    messip_send() waits for its reply through the same dispatcher. The request id is only carried 
+ *    by the compact header (see messip_wire.c): a server which does not take it has to reply in order.
+ * 
+ * @see messip_send_async(), messip_wait(), messip_request_release()
+ */
+messip_request_t *messip_sendv_async( messip_channel_t *ch, int32_t type,
+	const struct iovec *send_iov, int send_iovcnt, void *reply_buffer, int reply_maxlen ) {
+    messip_datasend_t datasend;
+    char wire[sizeof( messip_datasend_t )];
+    messip_request_t *req, **last;
+    struct iovec iovec[2 + MESSIP_IOV_MAX];
+    ssize_t dcount;
+    int32_t len;
+    int send_len;
+
+    if ( ( send_iovcnt < 0 ) || ( send_iovcnt > MESSIP_IOV_MAX ) ) {
+        errno = EINVAL;
+        return NULL;
+    }
+    send_len = iov_length( send_iov, send_iovcnt );
+    if ( ch->threads != NULL ) {
+        if ( ( ch = messip_channel_self( ch ) ) == NULL )
+            return NULL;
+    }
+    if ( wire_negotiate( ch, MESSIP_NOTIMEOUT ) != 0 )
+        return NULL;
+    req = ( messip_request_t * ) malloc( sizeof( messip_request_t ) );
+    if ( req == NULL ) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    memset( req, 0, sizeof( messip_request_t ) );
+    req->ch = ch;
+    req->reply_buffer = reply_buffer;
+    req->reply_maxlen = reply_maxlen;
+
+    /*--- Message to send ---*/
+    datasend.flag = 0;
+    IDCPY( datasend.id, ch->cnx->remote_id );
+    datasend.type = type;
+    datasend.datalen = send_len;
+
+    /*--- Only the compact header carries a request id: otherwise the reply is the one of the oldest send ---*/
+    if ( ch->wire_version == MESSIP_WIRE_V2 ) {
+        if ( ++ch->next_reqid == 0 )
+            ++ch->next_reqid;   // 0 is used by synchronous sends
+        req->reqid = ch->next_reqid;
+    }
+    iovec[0].iov_base = wire;
+    iovec[0].iov_len = messip_wire_send_encode( wire, &datasend, ch->wire_version, ch->wire_sender, req->reqid );
+    len = reply_maxlen;
+    iovec[1].iov_base = &len;
+    iovec[1].iov_len = sizeof( uint32_t );
+    memcpy( &iovec[2], send_iov, send_iovcnt * sizeof( struct iovec ) );
+    dcount = messip_writev( ch->send_sockfd, iovec, 2 + send_iovcnt );
+    if ( dcount != iovec[0].iov_len + sizeof( uint32_t ) + send_len ) {
+        free( req );
+        if ( dcount != -1 )
+            errno = EIO;
+        return NULL;
+    }
+
+    /*--- In flight: the replies usually come in order, so keep the oldest first ---*/
+    for ( last = &ch->requests; *last != NULL; last = &( *last )->next );
+    *last = req;
+    return req;
+}                               // messip_sendv_async
+
+/**
+ * Same as messip_send(), but does not wait for the reply (see messip_sendv_async())
+ * 
+ * @param ch channel connection (to the server) structure which was returned by messip_channel_connect()
+ * @param type 32-bits number that can be used optionally to identify the kind of message sent to the server
+ * @param send_buffer pointer to the message to send
+ * @param send_len length of the message to be sent (can be 0)
+ * @param reply_buffer Where to store the reply once it comes (see messip_send())
+ * @param reply_maxlen Maximum length for the reply
+ * @return The handle, or NULL if an error occurred (errno is then set)
+ * 
+ * @see messip_sendv_async(), messip_wait(), messip_request_release()
+ */
+messip_request_t *messip_send_async( messip_channel_t *ch, int32_t type,
+	void *send_buffer, int send_len, void *reply_buffer, int reply_maxlen ) {
+    struct iovec iovec[1];
+
+    iovec[0].iov_base = send_buffer;
+    iovec[0].iov_len = send_len;
+    return messip_sendv_async( ch, type, iovec, 1, reply_buffer, reply_maxlen );
+}                               // messip_send_async
+
+/**
+ * messip_wait(), with arrays large enough to watch the channel of each request
+ * 
+ * @param pfd Descriptors polled, at least nb_requests of them
+ * @param chs Channel of each descriptor, at least nb_requests of them
+ * @see messip_wait()
+ */
+static int wait_requests( messip_request_t **requests, int nb_requests, int msec_timeout,
+	struct pollfd *pfd, messip_channel_t **chs ) {
+    struct timespec deadline;
+    int n, k, nfds, status;
+
+    deadline_set( &deadline, msec_timeout );
+
+    for ( ;; ) {
+
+        /*--- Already complete ? Otherwise, the channels to watch ---*/
+        for ( nfds = 0, n = 0; n < nb_requests; n++ ) {
+            if ( requests[n] == NULL )
+                continue;
+            if ( requests[n]->done )
+                return n;
+            for ( k = 0; ( k < nfds ) && ( chs[k] != requests[n]->ch ); k++ );
+            if ( k < nfds )
+                continue;
+            chs[nfds] = requests[n]->ch;
+            pfd[nfds].fd = chs[nfds]->send_sockfd;
+            pfd[nfds].events = POLLIN;
+            pfd[nfds++].revents = 0;
+        }                       // for (n)
+        if ( nfds == 0 ) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        /*--- Wait for a reply, unless some have been read ahead already ---*/
+        for ( status = 0, k = 0; k < nfds; k++ ) {
+            if ( messip_sockbuf_pending( pfd[k].fd ) > 0 ) {
+                pfd[k].revents = POLLIN;
+                status++;
+            }
+        }                       // for (k)
+        if ( status == 0 ) {
+            do {
+                status = poll( pfd, nfds, deadline_remaining( &deadline, msec_timeout ) );
+            } while ( ( status == -1 ) && ( errno == EINTR ) );
+            if ( status == -1 )
+                return -1;
+            if ( status == 0 )
+                return MESSIP_MSG_TIMEOUT;
+        }
+
+        /*--- Dispatch the replies received (an error completes the requests of the channel) ---*/
+        for ( k = 0; k < nfds; k++ )
+            if ( pfd[k].revents != 0 )
+                reply_dispatch( chs[k] );
+    }                           // for (;;)
+}                               // wait_requests
+
+/**
+ * Wait until at least one of several asynchronous sends is complete (replied, or failed).
+ * The requests can belong to different channels.
+ * 
+ * @param requests Handles returned by messip_send_async() (NULL entries are ignored)
+ * @param nb_requests Number of handles
+ * @param msec_timeout Timeout expressed in milliseconds, 0 to only poll, or MESSIP_NOTIMEOUT
+ * @return Index in requests of a complete request, MESSIP_MSG_TIMEOUT, or -1 if an error 
+ *    occurred (errno is then set)
+ * 
+ * @note Once complete, messip_request_t.status is 0 (answer, datalen and datalenr are then set), 
+ *    or -1 (error holds the errno).
+ * 
+ * @see messip_send_async(), messip_request_release()
+ */
+int messip_wait( messip_request_t **requests, int nb_requests, int msec_timeout ) {
+    struct pollfd pfd_small[MESSIP_WAIT_STACK];
+    messip_channel_t *chs_small[MESSIP_WAIT_STACK];
+    struct pollfd *pfd = pfd_small;
+    messip_channel_t **chs = chs_small;
+    int status;
+
+    /*--- Usually a few requests: more of them need larger arrays ---*/
+    if ( nb_requests > MESSIP_WAIT_STACK ) {
+        pfd = ( struct pollfd * ) malloc( nb_requests * sizeof( struct pollfd ) );
+        chs = ( messip_channel_t ** ) malloc( nb_requests * sizeof( messip_channel_t * ) );
+        if ( ( pfd == NULL ) || ( chs == NULL ) ) {
+            free( pfd );
+            free( chs );
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    status = wait_requests( requests, nb_requests, msec_timeout, pfd, chs );
+
+    if ( pfd != pfd_small ) {
+        free( pfd );
+        free( chs );
+    }
+    return status;
+}                               // messip_wait
+
+/**
+ * Release the handle of an asynchronous send. If the reply has not been received yet, 
+ * it will be discarded (reply_buffer is not used anymore).
+ * 
+ * @param req Handle returned by messip_send_async()
+ * 
+ * @see messip_send_async(), messip_wait()
+ */
+void messip_request_release( messip_request_t *req ) {
+    if ( req == NULL )
+        return;
+    if ( req->done )
+        free( req );
+    else {
+        req->released = 1;
+        req->reply_buffer = NULL;
+        req->reply_maxlen = 0;
+    }
+}                               // messip_request_release
+
+/**
+ * messip_sendv() while asynchronous sends are in flight on the channel
+ * 
+ * @see messip_sendv()
+ */
+static int send_through_requests( messip_channel_t *ch, int32_t type, 
+	const struct iovec *send_iov, int send_iovcnt, int32_t *answer, 
+	void *reply_buffer, int reply_maxlen, int msec_timeout ) {
+    messip_request_t *req;
+    int status;
+
+    req = messip_sendv_async( ch, type, send_iov, send_iovcnt, reply_buffer, reply_maxlen );
+    if ( req == NULL )
+        return -1;
+    status = messip_wait( &req, 1, msec_timeout );
+    if ( status < 0 ) {
+        messip_request_release( req );
+        return status;
+    }
+    if ( answer != NULL )
+        *answer = req->answer;
+    ch->datalen = req->datalen;
+    ch->datalenr = req->datalenr;
+    status = req->status;
+    errno = req->error;
+    messip_request_release( req );
+    return status;
+}                               // send_through_requests
 
 /**
  * Enables a client to send a synchronous message to a channel owned by a server. 
@@ -1413,27 +3617,82 @@ int messip_receive( messip_channel_t *ch, int32_t *type, void *rec_buffer, int m
 int messip_send( messip_channel_t *ch, int32_t type, 
 	void *send_buffer, int send_len, int32_t *answer, 
 	void *reply_buffer, int reply_maxlen, int msec_timeout ) {
+    struct iovec iovec[1];
+
+    iovec[0].iov_base = send_buffer;
+    iovec[0].iov_len = send_len;
+    return messip_sendv( ch, type, iovec, 1, answer, reply_buffer, reply_maxlen, msec_timeout );
+}                               // messip_send
+
+/**
+ * Same as messip_send(), but the message is made of several segments (for instance a header
+ * and a body), which are written as they are: there is no need to copy them in a single buffer first.
+ * 
+ * @param ch channel connection (to the server) structure which was returned by messip_channel_connect()
+ * @param type 32-bits number that can be used optionally to identify the kind of message sent to the server
+ * @param send_iov Segments of the message to send (a segment can be empty)
+ * @param send_iovcnt Number of segments, at most MESSIP_IOV_MAX (can be 0)
+ * @param answer 32-bit number that can be used optionally to identify the status or type of answer.
+ * @param reply_buffer pointer to a buffer where to store the answer sent back from the server (see messip_send())
+ * @param reply_maxlen Maximum length for the reply.
+ * @param msec_timeout Timeout expressed in milliseconds, or MESSIP_NOTIMEOUT
+ * 
+ * @return 0 if no error, MESSIP_MSG_TIMEOUT, or -1 if an error occurred (errno is then set:
+ *    EINVAL if send_iovcnt is out of range)
+ * 
+ * @see messip_send(), messip_replyv()
+ */
+int messip_sendv( messip_channel_t *ch, int32_t type, 
+	const struct iovec *send_iov, int send_iovcnt, int32_t *answer, 
+	void *reply_buffer, int reply_maxlen, int msec_timeout ) {
     ssize_t dcount;
     messip_datasend_t datasend;
     messip_datareply_t datareply;
-    struct iovec iovec[3];
-    fd_set ready;
-    struct timeval tv;
+    char wire[sizeof( messip_datasend_t )];
+    char wire_in[sizeof( messip_datareply_t )];
+    uint32_t reqid;
+    struct iovec iovec[2 + MESSIP_IOV_MAX];
+    int32_t len;
+    int32_t already_read = 0;   // Bytes of the reply already read by the io_uring engine
+    struct iovec iovec_in[2];
+    int iovcnt_in;
+    int send_len;
     int status;
-    int32_t len, len_to_read;
-    void *rbuff = NULL;
 
-    /*--- Timeout to write ? ---*/
-    if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( ch->send_sockfd, &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) ch->send_sockfd + 1, NULL, &ready, NULL, &tv );
-        assert( status != -1 );
-        if ( !FD_ISSET( ch->send_sockfd, &ready ) )
-            return MESSIP_MSG_TIMEOUT;
+    if ( ( send_iovcnt < 0 ) || ( send_iovcnt > MESSIP_IOV_MAX ) ) {
+        errno = EINVAL;
+        return -1;
+    }
+    send_len = iov_length( send_iov, send_iovcnt );
+
+    /*--- Thread-safe mode: send on the connection of this thread ---*/
+    if ( ch->threads != NULL ) {
+        if ( ( ch = messip_channel_self( ch ) ) == NULL )
+            return -1;
+    }
+
+    /*--- Asynchronous sends in flight: their replies share the socket, so go through the dispatcher ---*/
+    if ( ch->requests != NULL )
+        return send_through_requests( ch, type, send_iov, send_iovcnt, answer, reply_buffer, reply_maxlen, msec_timeout );
+
+    /*--- Buffered messages sent directly: their acknowledgments come before the reply ---*/
+    if ( ch->buffered_credits < MESSIP_BUFFERED_CREDITS ) {
+        status = buffered_credits_wait( ch, MESSIP_BUFFERED_CREDITS, msec_timeout );
+        if ( status != 0 )
+            return status;
+    }
+
+    /*--- First send: negotiate the header of the messages, once ---*/
+    if ( ( status = wire_negotiate( ch, msec_timeout ) ) != 0 )
+        return status;
+
+    /*--- Same host: negotiate the shared-memory transport, once ---*/
+    if ( ( ch->shm_slot == MESSIP_SHM_SLOT_UNKNOWN ) || ( ch->shm_slot == MESSIP_SHM_SLOT_REQUESTED ) ) {
+        if ( ( status = shm_attach( ch, msec_timeout ) ) != 0 )
+            return status;
     }
+    if ( ( ch->shm != NULL ) && ( send_len <= messip_shm_slot_size( ch->shm ) ) )
+        return shm_send( ch, type, send_iov, send_iovcnt, send_len, answer, reply_buffer, reply_maxlen, msec_timeout );
 
     /*--- Message to send ---*/
     datasend.flag = 0;
@@ -1442,39 +3701,79 @@ int messip_send( messip_channel_t *ch, int32_t type,
     datasend.datalen = send_len;
 
     /*--- (S1) Send a message to the 'server' ---*/
-    iovec[0].iov_base = &datasend;
-    iovec[0].iov_len = sizeof( datasend );
+    iovec[0].iov_base = wire;
+    iovec[0].iov_len = messip_wire_send_encode( wire, &datasend, ch->wire_version, ch->wire_sender, 0 );
     len = reply_maxlen;
     iovec[1].iov_base = &len;
     iovec[1].iov_len = sizeof( uint32_t );
-    iovec[2].iov_base = send_buffer;
-    iovec[2].iov_len = send_len;
-    dcount = messip_writev( ch->send_sockfd, iovec, 3 );
-//  logg( NULL, "{messip_send/3} sendmsg send_len=%d dcount=%d local_fd=%d [errno=%d] \n",
-//        send_len, dcount, ch->send_sockfd, errno );
-    if ( dcount == -1 ) {
-        printf( "%s %d:\015\012\terrno=%m\015\012", __FILE__, __LINE__ );
-        fflush( stdout );
-        return -1;
-    }
-    assert( dcount == ( sizeof( messip_datasend_t ) + sizeof( uint32_t ) + send_len ) );
+    memcpy( &iovec[2], send_iov, send_iovcnt * sizeof( struct iovec ) );
+    if ( ( ch->uring != NULL ) && ( messip_sockbuf_pending( ch->send_sockfd ) == 0 ) ) {
+        size_t reply_hdr_len = ( ch->wire_version == MESSIP_WIRE_V2 ) ?
+            sizeof( messip_wire_reply_t ) : sizeof( messip_datareply_t );
 
-    /*--- Timeout to read ? ---*/
-    if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( ch->send_sockfd, &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) ch->send_sockfd + 1, &ready, NULL, NULL, &tv );
-        assert( status != -1 );
-        if ( !FD_ISSET( ch->send_sockfd, &ready ) )
+        /*--- Timeout to write ? ---*/
+        if ( msec_timeout != MESSIP_NOTIMEOUT ) {
+            if ( messip_wait_ready( ch->send_sockfd, POLLOUT, msec_timeout ) <= 0 )
+                return MESSIP_MSG_TIMEOUT;
+        }
+
+        /*--- (S1+S2) Linked write + read: the reply is read directly into the caller's buffer ---*/
+        iovec_in[0].iov_base = wire_in;
+        iovec_in[0].iov_len = reply_hdr_len;
+        iovcnt_in = 1;
+        if ( ( reply_buffer != NULL ) && ( reply_maxlen > 0 ) ) {
+            iovec_in[1].iov_base = reply_buffer;
+            iovec_in[1].iov_len = reply_maxlen;
+            iovcnt_in = 2;
+        }
+        dcount = messip_uring_sendrecv( ch->uring, ch->send_sockfd, iovec, 2 + send_iovcnt, iovec_in, iovcnt_in, msec_timeout );
+        if ( ( dcount == -1 ) && ( errno == ETIMEDOUT ) )
             return MESSIP_MSG_TIMEOUT;
+        if ( ( dcount > 0 ) && ( dcount < reply_hdr_len ) ) {
+            iovec[0].iov_base = wire_in + dcount;
+            iovec[0].iov_len = reply_hdr_len - dcount;
+            dcount = messip_sockbuf_readv( ch->send_sockfd, iovec, 1, 1 );
+            if ( dcount > 0 )
+                dcount = reply_hdr_len;
+        }
+        if ( dcount > 0 ) {
+            already_read = dcount - reply_hdr_len;
+            if ( ch->wire_version != MESSIP_WIRE_V2 )
+                memcpy( &datareply, wire_in, sizeof( datareply ) );
+            else if ( ( uint8_t ) wire_in[0] == MESSIP_WIRE_V2 ) {
+                messip_wire_reply_decode( &datareply, &reqid, wire_in );
+                IDCPY( datareply.id, ch->remote_id );
+            }
+            else {
+                errno = EPROTO;
+                dcount = -1;
+            }
+        }
     }
+    else {
 
-    /*--- (S2) Read reply from 'server' ---*/
-    iovec[0].iov_base = &datareply;
-    iovec[0].iov_len = sizeof( datareply );
-    dcount = messip_readv( ch->send_sockfd, iovec, 1 );
+        /*--- Written at once: the socket is polled only if it is full ---*/
+        dcount = messip_sockbuf_writev( ch->send_sockfd, iovec, 2 + send_iovcnt, msec_timeout );
+//      logg( NULL, "{messip_send/3} sendmsg send_len=%d dcount=%d local_fd=%d [errno=%d] \n",
+//            send_len, dcount, ch->send_sockfd, errno );
+        if ( ( dcount == -1 ) && ( errno == ETIMEDOUT ) )
+            return MESSIP_MSG_TIMEOUT;
+        if ( dcount == -1 ) {
+            printf( "%s %d:\015\012\terrno=%m\015\012", __FILE__, __LINE__ );
+            fflush( stdout );
+            return -1;
+        }
+        assert( dcount == ( iovec[0].iov_len + sizeof( uint32_t ) + send_len ) );
+
+        /*--- Timeout to read ? ---*/
+        if ( msec_timeout != MESSIP_NOTIMEOUT ) {
+            if ( messip_sockbuf_wait( ch->send_sockfd, msec_timeout ) <= 0 )
+                return MESSIP_MSG_TIMEOUT;
+        }
+
+        /*--- (S2) Read reply from 'server': its data are read ahead by the same system call (S3) ---*/
+        dcount = datareply_read( ch, &datareply, &reqid );
+    }
     if ( dcount == 0 ) {
 //      fprintf( stderr, "%s %d:\015\012\terrno=%d\015\012", __FILE__, __LINE__, errno );
         errno = ECONNRESET;
@@ -1490,57 +3789,8 @@ int messip_send( messip_channel_t *ch, int32_t type,
     *answer = datareply.answer;
 
     /*--- (S3) Read now the reply, if there is one ---*/
-//  logg( NULL, "--- datalen=%d maxlen=%d\n", datareply.datalen, reply_maxlen );
-    if ( ( reply_buffer != NULL ) && ( reply_maxlen == 0 ) && ( datareply.datalen > 0 ) ) {
-        len_to_read = datareply.datalen;
-        rbuff = malloc( datareply.datalen );
-        iovec[0].iov_base = rbuff;
-        iovec[0].iov_len = len_to_read;
-    }
-    else {
-        len_to_read = ( datareply.datalen < reply_maxlen ) ? datareply.datalen : reply_maxlen;
-        iovec[0].iov_base = reply_buffer;
-        iovec[0].iov_len = len_to_read;
-    }
-    if ( len_to_read > 0 ) {
-        dcount = messip_readv( ch->send_sockfd, iovec, 1 );
-        messip_log( MESSIP_LOG_INFO_VERBOSE, "messip_send: recvmsg dcount=%d local_fd=%d [errno=%d]\n",
-           dcount, ch->send_sockfd, errno );
-        if ( dcount == 0 ) {
-            printf( "%s %d:\015\012\terrno=%d\015\012", __FILE__, __LINE__, errno );
-            fflush( stdout );
-            errno = ECONNRESET;
-            return -1;
-        }
-        if ( dcount == -1 ) {
-            printf( "%s %d:\015\012\terrno=%d\015\012", __FILE__, __LINE__, errno );
-            fflush( stdout );
-            return -1;
-        }
-    }                           // if
-
-    if ( len_to_read < datareply.datalen ) {
-//      logg( NULL, "ZUT!! %d %d\n", len_to_read, datareply.datalen );
-        int rem = datareply.datalen - len_to_read;
-        char *temp = ( char * ) malloc( rem );
-        iovec[0].iov_base = temp;
-        iovec[0].iov_len = rem;
-        dcount = messip_readv( ch->send_sockfd, iovec, 1 );
-//      logg( NULL, "@messip_send: rem=%d dcount=%d local_fd=%d [errno=%d]\n",
-//            rem, dcount, ch->send_sockfd, errno );
-        free( temp );
-    }
-
-    /*--- Dynamic allocation ? ---*/
-    if ( ( reply_buffer != NULL ) && ( reply_maxlen == 0 ) )
-        *( void ** ) reply_buffer = rbuff;
-
-    /*--- Ok ---*/
-    ch->datalen = datareply.datalen;
-    ch->datalenr = len_to_read;
-    IDCPY( ch->remote_id, datareply.id );
-    return 0;
-}                               // messip_send
+    return send_read_reply( ch, &datareply, reply_buffer, reply_maxlen, already_read );
+}                               // messip_sendv
 
 /**
  * Enable a client to send an Asynchronous Message to a server.
@@ -1559,27 +3809,39 @@ int messip_send( messip_channel_t *ch, int32_t type,
  * @return pointer to a messip_channel_t structure (that will be used next when sending messages on this channel), 
  *  or -1 if an error occurred (errno is then set).
  * 
- * @see messip_channel_create(), messip_channel_disconnect(), messip_receive(), messip_send()
+ * @see messip_channel_create(), messip_channel_disconnect(), messip_receive(), messip_send(), 
+ *    messip_channel_set_buffered_mode()
  */
 int32_t messip_buffered_send( messip_channel_t *ch, int32_t type, void *send_buffer, int send_len, int msec_timeout ) {
+    struct iovec iovec[1];
+
+    iovec[0].iov_base = send_buffer;
+    iovec[0].iov_len = send_len;
+    return messip_buffered_sendv( ch, type, iovec, 1, msec_timeout );
+}                               // messip_buffered_send
+
+/**
+ * messip_buffered_sendv(), once the connection with the messip manager is locked
+ * 
+ * @see messip_buffered_sendv()
+ */
+static int32_t buffered_sendv( messip_channel_t *ch, int32_t type, const struct iovec *send_iov, int send_iovcnt, int msec_timeout ) {
     ssize_t dcount;
-    fd_set ready;
-    struct timeval tv;
-    int status;
     int32_t op;
     messip_send_buffered_send_t msgsend;
     messip_reply_buffered_send_t msgreply;
-    struct iovec iovec[3];
+    struct iovec iovec[2 + MESSIP_IOV_MAX];
+    int send_len;
+
+    if ( ( send_iovcnt < 0 ) || ( send_iovcnt > MESSIP_IOV_MAX ) ) {
+        errno = EINVAL;
+        return -1;
+    }
+    send_len = iov_length( send_iov, send_iovcnt );
 
     /*--- Timeout to write ? ---*/
     if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( ch->cnx->sockfd, &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) FD_SETSIZE, NULL, &ready, NULL, &tv );
-        assert( status != -1 );
-        if ( !FD_ISSET( ch->cnx->sockfd, &ready ) )
+        if ( messip_wait_ready( ch->cnx->sockfd, POLLOUT, msec_timeout ) <= 0 )
             return MESSIP_MSG_TIMEOUT;
     }
 
@@ -1587,28 +3849,20 @@ int32_t messip_buffered_send( messip_channel_t *ch, int32_t type, void *send_buf
     op = MESSIP_OP_BUFFERED_SEND;
     iovec[0].iov_base = &op;
     iovec[0].iov_len = sizeof( int32_t );
-    IDCPY( msgsend.id_from, ch->remote_id );
+    msgsend.handle = ch->mgr_handle;
     msgsend.type = type;
     msgsend.datalen = send_len;
-    msgsend.mgr_sockfd = ch->mgr_sockfd;    // Socket in the messip_mgr
 
     iovec[1].iov_base = &msgsend;
     iovec[1].iov_len = sizeof( msgsend );
-    iovec[2].iov_base = send_buffer;
-    iovec[2].iov_len = send_len;
-    dcount = messip_writev( ch->cnx->sockfd, iovec, 3 );
+    memcpy( &iovec[2], send_iov, send_iovcnt * sizeof( struct iovec ) );
+    dcount = messip_writev( ch->cnx->sockfd, iovec, 2 + send_iovcnt );
     messip_log( MESSIP_LOG_INFO_VERBOSE, "messip_buffered_send: send status= %d  sockfd=%d\n", dcount, ch->cnx->sockfd );
     assert( ( dcount == sizeof( int32_t ) + sizeof( msgsend ) + send_len ) );
 
     /*--- Ready to read ? ---*/
     if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( ch->cnx->sockfd, &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) FD_SETSIZE, &ready, NULL, NULL, &tv );
-        assert( status != -1 );
-        if ( !FD_ISSET( ch->cnx->sockfd, &ready ) ) {
+        if ( messip_wait_ready( ch->cnx->sockfd, POLLIN, msec_timeout ) <= 0 ) {
             errno = ETIMEDOUT;
             return -1;
         }
@@ -1623,7 +3877,95 @@ int32_t messip_buffered_send( messip_channel_t *ch, int32_t type, void *send_buf
     assert( dcount == sizeof( msgreply ) );
 
     return msgreply.nb_msg_buffered;
-}                               // messip_buffered_send
+}                               // buffered_sendv
+
+/**
+ * messip_buffered_sendv() in MESSIP_BUFFERED_DIRECT mode: the message is written straight on the 
+ * connection to the server, as long as some credits are left
+ * 
+ * @see messip_buffered_sendv()
+ */
+static int32_t buffered_sendv_direct( messip_channel_t *ch, int32_t type, const struct iovec *send_iov, int send_iovcnt, int msec_timeout ) {
+    ssize_t dcount;
+    messip_datasend_t datasend;
+    char wire[sizeof( messip_datasend_t )];
+    struct iovec iovec[2 + MESSIP_IOV_MAX];
+    int32_t len;
+    int send_len;
+    int status;
+
+    if ( ( send_iovcnt < 0 ) || ( send_iovcnt > MESSIP_IOV_MAX ) ) {
+        errno = EINVAL;
+        return -1;
+    }
+    send_len = iov_length( send_iov, send_iovcnt );
+
+    /*--- Thread-safe mode: send on the connection of this thread ---*/
+    if ( ch->threads != NULL ) {
+        if ( ( ch = messip_channel_self( ch ) ) == NULL )
+            return -1;
+    }
+
+    /*--- First send: negotiate the header of the messages, once ---*/
+    if ( ( status = wire_negotiate( ch, msec_timeout ) ) != 0 )
+        return status;
+
+    /*--- No credit left: wait until the server acknowledges some messages ---*/
+    if ( ch->buffered_credits <= 0 ) {
+        if ( ( status = buffered_credits_wait( ch, 1, msec_timeout ) ) != 0 )
+            return status;
+    }
+
+    /*--- Message to send ---*/
+    datasend.flag = MESSIP_FLAG_BUFFERED;
+    IDCPY( datasend.id, ch->cnx->remote_id );
+    datasend.type = type;
+    datasend.datalen = send_len;
+
+    /*--- Send it to the 'server': there will be no reply ---*/
+    iovec[0].iov_base = wire;
+    iovec[0].iov_len = messip_wire_send_encode( wire, &datasend, ch->wire_version, ch->wire_sender, 0 );
+    len = 0;
+    iovec[1].iov_base = &len;
+    iovec[1].iov_len = sizeof( uint32_t );
+    memcpy( &iovec[2], send_iov, send_iovcnt * sizeof( struct iovec ) );
+    dcount = messip_sockbuf_writev( ch->send_sockfd, iovec, 2 + send_iovcnt, msec_timeout );
+    messip_log( MESSIP_LOG_INFO_VERBOSE, "messip_buffered_send: direct dcount=%d local_fd=%d\n", dcount, ch->send_sockfd );
+    if ( ( dcount == -1 ) && ( errno == ETIMEDOUT ) )
+        return MESSIP_MSG_TIMEOUT;
+    if ( dcount == -1 )
+        return -1;
+    assert( dcount == ( iovec[0].iov_len + sizeof( uint32_t ) + send_len ) );
+    ch->buffered_credits--;
+
+    return MESSIP_BUFFERED_CREDITS - ch->buffered_credits;
+}                               // buffered_sendv_direct
+
+/**
+ * Same as messip_buffered_send(), but the message is made of several segments
+ * 
+ * @param ch channel connection (to the server) structure which was returned by messip_channel_connect() 
+ * @param type 32-bits number that can be used optionally to identify the kind of message sent to the server
+ * @param send_iov Segments of the message to send (a segment can be empty)
+ * @param send_iovcnt Number of segments, at most MESSIP_IOV_MAX (can be 0)
+ * @param msec_timeout Timeout expressed in milliseconds, or MESSIP_NOTIMEOUT
+ * 
+ * @return Number of messages buffered by the server (MESSIP_BUFFERED_DIRECT: number of messages not 
+ *    acknowledged yet), MESSIP_MSG_TIMEOUT, or -1 if an error occurred (errno is then set:
+ *    EINVAL if send_iovcnt is out of range)
+ * 
+ * @see messip_buffered_send(), messip_channel_set_buffered_mode()
+ */
+int32_t messip_buffered_sendv( messip_channel_t *ch, int32_t type, const struct iovec *send_iov, int send_iovcnt, int msec_timeout ) {
+    int32_t status;
+
+    if ( ch->buffered_mode == MESSIP_BUFFERED_DIRECT )
+        return buffered_sendv_direct( ch, type, send_iov, send_iovcnt, msec_timeout );
+    pthread_mutex_lock( &ch->cnx->lock );
+    status = buffered_sendv( ch, type, send_iov, send_iovcnt, msec_timeout );
+    pthread_mutex_unlock( &ch->cnx->lock );
+    return status;
+}                               // messip_buffered_sendv
 
 /**
  * Enables a server to reply to a client that has sent a messages to a channel owned by this server
@@ -1651,15 +3993,46 @@ int32_t messip_buffered_send( messip_channel_t *ch, int32_t type, void *send_buf
  * @see messip_channel_create(), messip_reply(), messip_receive_more(), messip_send()
  */
 int messip_reply( messip_channel_t *ch, int index, int32_t answer, void *reply_buffer, int reply_len, int msec_timeout ) {
+    struct iovec iovec[1];
+
+    iovec[0].iov_base = reply_buffer;
+    iovec[0].iov_len = reply_len;
+    return messip_replyv( ch, index, answer, iovec, 1, msec_timeout );
+}                               // messip_reply
+
+/**
+ * Same as messip_reply(), but the reply is made of several segments, which are written
+ * as they are (no copy in a single buffer first).
+ * 
+ * @param ch channel connection (to the server) structure which was returned by messip_channel_connect() 
+ * @param index value previously returned by the messip_receive()
+ * @param answer 32-bits number that can be used optionally to identify the kind of message sent back 
+ * 		to the client.
+ * @param reply_iov Segments of the reply (a segment can be empty)
+ * @param reply_iovcnt Number of segments, at most MESSIP_IOV_MAX (can be 0)
+ * @param msec_timeout Timeout expressed in milliseconds, or MESSIP_NOTIMEOUT
+ * 
+ * @return A status of the operation, as messip_reply(). errno is set to EINVAL if
+ *    reply_iovcnt is out of range.
+ * 
+ * @see messip_reply(), messip_sendv()
+ */
+int messip_replyv( messip_channel_t *ch, int index, int32_t answer, const struct iovec *reply_iov, int reply_iovcnt, int msec_timeout ) {
     ssize_t dcount;
-    struct iovec iovec[2];
+    struct iovec iovec[1 + MESSIP_IOV_MAX];
     messip_datareply_t datareply;
-    fd_set ready;
-    struct timeval tv;
-    int status, sz;
+    char wire[sizeof( messip_datareply_t )];
+    int reply_len;
+    int slot;
+    int status = 0, error = 0;
 
-    if ( ( index < 0 ) || ( index > ch->nb_replies_pending ) )
+    if ( ( index < 0 ) || ( index >= ch->new_sockfd_sz ) || ( ch->new_sockfd[index] == -1 ) )
+        return -1;
+    if ( ( reply_iovcnt < 0 ) || ( reply_iovcnt > MESSIP_IOV_MAX ) ) {
+        errno = EINVAL;
         return -1;
+    }
+    reply_len = iov_length( reply_iov, reply_iovcnt );
 
     /*--- Message to reply back ---*/
 //  logg( NULL, "messip_reply:  pthread_self=%d\n", pthread_self() );
@@ -1667,195 +4040,138 @@ int messip_reply( messip_channel_t *ch, int index, int32_t answer, void *reply_b
     datareply.datalen = reply_len;
     datareply.answer = answer;
 
-    /*--- Timeout to write ? ---*/
-    if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( ch->new_sockfd[index], &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) FD_SETSIZE, NULL, &ready, NULL, &tv );
-        assert( status != -1 );
-        if ( !FD_ISSET( ch->new_sockfd[index], &ready ) )
-            return MESSIP_MSG_TIMEOUT;
+    /*--- Lazy receive mode: discard what has not been read, then watch the socket again ---*/
+    slot = ch->new_shm_slot[index];
+    if ( ( slot == -1 ) && ( ch->receive_allmsg[index] == NULL )
+       && ( ch->receive_offset[index] < ch->receive_allmsg_sz[index] ) ) {
+        messip_sockbuf_drain( ch->new_sockfd[index], ch->receive_allmsg_sz[index] - ch->receive_offset[index], !ch->serve );
+        if ( !ch->serve )
+            epoll_add( ch->epoll_fd, ch->new_sockfd[index] );
     }
 
-    /*--- Now wait for an answer from the server ---*/
-    sz = 0;
-    iovec[sz].iov_base = &datareply;
-    iovec[sz++].iov_len = sizeof( messip_datareply_t );
-    if ( reply_len > 0 ) {
-        iovec[sz].iov_base = reply_buffer;
-        iovec[sz++].iov_len = reply_len;
-    }
-    dcount = messip_writev( ch->new_sockfd[index], iovec, sz );
-    messip_log( MESSIP_LOG_INFO_VERBOSE, "messip_reply: sendmsg: dcount=%d  index=%d new_sockfd=%d errno=%d\n",
-       dcount, index, ch->new_sockfd[index], errno );
-    assert( dcount == ( sizeof( messip_datareply_t ) + reply_len ) );
+    /*--- Client using the shared-memory transport: the reply goes into its slot ---*/
+    if ( ( slot != -1 ) && ( reply_len <= messip_shm_slot_size( ch->shm ) ) ) {
+        char *data = ( char * ) messip_shm_slot_data( ch->shm, slot );
+        messip_shm_slot( ch->shm, slot )->datareply = datareply;
+        for ( int n = 0, off = 0; n < reply_iovcnt; off += reply_iov[n].iov_len, n++ )
+            memcpy( data + off, reply_iov[n].iov_base, reply_iov[n].iov_len );
+        messip_shm_complete( ch->shm, slot, MESSIP_SHM_REPLY );
+    }
+    else {
 
-    --ch->nb_replies_pending;
-    ch->new_sockfd[index] = -1;
+        /*--- Now wait for an answer from the server (polled only if the socket is full) ---*/
+        iovec[0].iov_base = wire;
+        iovec[0].iov_len = messip_wire_reply_encode( wire, &datareply,
+           MESSIP_WIRE_OF( ch->receive_sender[index] ), ch->receive_sender[index], ch->receive_reqid[index] );
+        memcpy( &iovec[1], reply_iov, reply_iovcnt * sizeof( struct iovec ) );
+        if ( ch->uring != NULL ) {
+            if ( ( msec_timeout != MESSIP_NOTIMEOUT )
+               && ( messip_wait_ready( ch->new_sockfd[index], POLLOUT, msec_timeout ) <= 0 ) )
+                return MESSIP_MSG_TIMEOUT;
+            dcount = messip_uring_writev( ch->uring, ch->new_sockfd[index], iovec, 1 + reply_iovcnt );
+        }
+        else {
+            dcount = messip_sockbuf_writev( ch->new_sockfd[index], iovec, 1 + reply_iovcnt, msec_timeout );
+            if ( ( dcount == -1 ) && ( errno == ETIMEDOUT ) )
+                return MESSIP_MSG_TIMEOUT;
+        }
+        messip_log( MESSIP_LOG_INFO_VERBOSE, "messip_reply: sendmsg: dcount=%d  index=%d new_sockfd=%d errno=%d\n",
+           dcount, index, ch->new_sockfd[index], errno );
+
+        /*--- Not written: the client sees a closed connection, which is handled by messip_receive() ---*/
+        if ( dcount != ( iovec[0].iov_len + reply_len ) ) {
+            status = -1;
+            error = ( dcount == -1 ) ? errno : EPIPE;
+            shutdown( ch->new_sockfd[index], SHUT_RDWR );
+        }
+
+        /*--- Reply too large for the slot: the client now reads it on the socket ---*/
+        if ( slot != -1 )
+            messip_shm_complete( ch->shm, slot, MESSIP_SHM_REPLY_SOCKET );
+    }                           // else
+
+    __atomic_sub_fetch( &ch->nb_replies_pending, 1, __ATOMIC_RELAXED );
+    channel_rearm( ch, ch->new_sockfd[index] );
+    ch->new_shm_slot[index] = -1;
 
-    free( ch->receive_allmsg[index] );
+    buffer_free( ch, ch->receive_allmsg[index] );
     ch->receive_allmsg[index] = NULL;
     ch->receive_allmsg_sz[index] = 0;
+    slot_put( ch, index );
 
-    /*--- Ok ---*/
-    return 0;
-}                               // messip_reply
+    /*--- Ok ? ---*/
+    if ( status == -1 )
+        errno = error;
+    return status;
+}                               // messip_replyv
 
 
 /**
- *  TBD
+ * Create a timer on a channel. On each expiration, messip_receive() on this channel
+ * returns MESSIP_MSG_TIMER, with the type of the timer: no message is sent,
+ * the expiration is delivered within the process.
  * 
- *  @param ch TBD
- *  @param type TBD
- *  @param msec_timeout TBD
- *  @return TBD
+ * All the timers of the process share a single timer wheel, driven by one timerfd
+ * (CLOCK_MONOTONIC): many thousands of periodic timers can be created.
+ * 
+ * @param ch Channel which was returned by messip_channel_create()
+ * @param type Type returned by messip_receive() on each expiration
+ * @param msec_1st_shot Delay before the first expiration, in milliseconds (0: the timer never expires)
+ * @param msec_rep_shot Period of the next expirations, in milliseconds, or 0 (one-shot timer)
+ * @param msec_timeout Not used anymore (kept for compatibility)
+ * @return The timer id, to be given to messip_timer_delete(), or NULL if an error occurred (errno is set)
+ * 
+ * @see messip_timer_delete(), messip_receive()
  */
-static int messip_timer_send( messip_channel_t *ch, int32_t type, int msec_timeout ) {
-    ssize_t dcount;
-    messip_datasend_t datasend;
-    struct iovec iovec[1];
-    fd_set ready;
-    struct timeval tv;
-    int status;
+timer_t messip_timer_create( messip_channel_t *ch, int32_t type, int msec_1st_shot, int msec_rep_shot, int msec_timeout ) {
+    messip_timer_queue_t *timers;
+    struct epoll_event event;
 
-    /*--- Timeout to write ? ---*/
-    if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( ch->send_sockfd, &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        status = select( ( int ) FD_SETSIZE, NULL, &ready, NULL, &tv );
-        assert( status != -1 );
-        if ( !FD_ISSET( ch->send_sockfd, &ready ) )
-            return MESSIP_MSG_TIMEOUT;
+    /*--- Only the owner of the channel receives on it ---*/
+    if ( ch->send_sockfd != -1 ) {
+        errno = EINVAL;
+        return NULL;
     }
 
-    /*--- Message to send ---*/
-    datasend.flag = MESSIP_FLAG_TIMER;
-    IDCPY( datasend.id, ch->remote_id );
-    datasend.type = type;
-    datasend.datalen = 0;
-
-    /*--- Send a message to the 'server' ---*/
-    iovec[0].iov_base = &datasend;
-    iovec[0].iov_len = sizeof( datasend );
-    dcount = messip_writev( ch->send_sockfd, iovec, 1 );
-    messip_log( MESSIP_LOG_INFO_VERBOSE, "messip_timer_send: sendmsg dcount=%d type=%d local_fd=%d\n",
-       dcount, ch->send_sockfd, type );
-    assert( dcount == sizeof( messip_datasend_t ) );
-
-    /*--- Ok ---*/
-    return 0;
-}                               // messip_timer_send
-
-typedef struct messip_timer_s {
-    timer_t timer_id;
-    messip_channel_t *ch;
-    int32_t user_type;
-} messip_timer_t;
-
-#  if TIMER_USE_SIGEV_THREAD==1
-
-/**
- *  TBD
- * 
- *  @param sigval TBD
- */
-static void timer_thread_handler( sigval_t sigval ) {
-    messip_timer_t *timer_info = ( messip_timer_t * ) sigval.SIGVAL_PTR;
-    messip_channel_t *ch = ( messip_channel_t * ) timer_info->ch;
-    int status;
-
-    if ( ch->send_sockfd == -1 ) {
-        if ( ( ch = messip_channel_connect( ch->cnx, ch->name, MESSIP_NOTIMEOUT ) ) == NULL )
-            assert( 0 );
-        timer_info->ch = ch;
-    }                           // if
-    status = messip_timer_send( ch, timer_info->user_type, MESSIP_NOTIMEOUT );
-}                               // timer_thread_handler
+    /*--- First timer of this channel: its receive engine watches the timerfd and the expirations ---*/
+    if ( ch->timers == NULL ) {
+        timers = messip_timer_queue_create(  );
+        if ( timers == NULL )
+            return NULL;
+        if ( epoll_add( ch->epoll_fd, messip_timer_queue_fd( timers ) ) == -1 ) {
+            messip_timer_queue_destroy( timers );
+            return NULL;
+        }
+        memset( &event, 0, sizeof( event ) );
+        event.events = EPOLLIN;
+        event.data.fd = messip_timer_engine_fd(  );
+        if ( epoll_ctl( ch->epoll_fd, EPOLL_CTL_ADD, event.data.fd, &event ) == -1 ) {
+            epoll_ctl( ch->epoll_fd, EPOLL_CTL_DEL, messip_timer_queue_fd( timers ), NULL );
+            messip_timer_queue_destroy( timers );
+            return NULL;
+        }
+        ch->timers = timers;
+    }
 
-#  elif TIMER_USE_SIGEV_SIGNAL==1
+    return ( timer_t ) messip_timer_start( ch->timers, type, msec_1st_shot, msec_rep_shot );
+}                               // messip_timer_create
 
 /**
- *  TBD
+ * Delete a timer. Its expirations not received yet are discarded.
  * 
- *  @param signo TBD
- *  @param info TBD
- *  @param context TBD
- */
-static void sig_action( int signo, siginfo_t *info, void *context ) {
-    messip_timer_t *timer_info = ( messip_timer_t * ) info->si_value.SIGVAL_PTR;
-    messip_channel_t *ch = ( messip_channel_t * ) timer_info->ch;
-    int status;
-
-    if ( ch->send_sockfd == -1 ) {
-        if ( ( ch = messip_channel_connect( ch->cnx, ch->name, MESSIP_NOTIMEOUT ) ) == NULL )
-            assert( 0 );
-        timer_info->ch = ch;
-    }                           // if
-    status = messip_timer_send( ch, timer_info->user_type, MESSIP_NOTIMEOUT );
-}                               // sig_action
-
-/**
- *  TBD
+ * @param ch Channel the timer has been created on
+ * @param timer_id Timer id which was returned by messip_timer_create()
+ * @return 0 if no error, or -1 if an error occurred (errno is set)
  * 
- *  @param ch TBD
- *  @param type TBD
- *  @param msec_1st_shot TBD
- *  @param msec_rep_shot TBD
- *  @param msec_timeout TBD
- *  @return TBD
+ * @see messip_timer_create()
  */
-timer_t messip_timer_create( messip_channel_t *ch, int32_t type, int msec_1st_shot, int msec_rep_shot, int msec_timeout ) {
-    struct sigevent event;
-    struct itimerspec itime;
-#    if defined(TIMER_USE_SIGEV_SIGNAL)
-    struct sigaction sig_act;
-#    endif
-
-    messip_timer_t *timer_info = ( messip_timer_t * ) malloc( sizeof( messip_timer_t ) );
-    timer_info->ch = ch;
-    timer_info->user_type = type;
-
-    memset( &event, 0, sizeof( struct sigevent ) );
-#    if TIMER_USE_SIGEV_THREAD==1
-    event.sigev_notify = SIGEV_THREAD;
-    event.sigev_notify_function = &timer_thread_handler;
-#    elif TIMER_USE_SIGEV_SIGNAL==1
-    event.sigev_notify = SIGEV_SIGNAL;
-    event.sigev_signo = SIGRTMIN;
-#    endif
-    event.sigev_value.SIGVAL_PTR = timer_info;
-    timer_create( CLOCK_REALTIME, &event, &timer_info->timer_id );
-
-#    if defined(TIMER_USE_SIGEV_SIGNAL)
-    sigemptyset( &sig_act.sa_mask );    /* block current signal */
-    sigaddset( &sig_act.sa_mask, SIGUSR1 ); /* and also these one: */
-    sigaddset( &sig_act.sa_mask, SIGUSR2 );
-    sigaddset( &sig_act.sa_mask, SIGALRM );
-    sigaddset( &sig_act.sa_mask, SIGPIPE );
-    sigaddset( &sig_act.sa_mask, SIGHUP );
-    sigaddset( &sig_act.sa_mask, SIGCHLD );
-    sigaddset( &sig_act.sa_mask, SIGRTMIN + 1 );
-    sig_act.sa_flags = SA_SIGINFO;
-    sig_act.sa_sigaction = sig_action;
-    sigaction( SIGRTMIN,        /* Set action for SIGRTMIN      */
-       &sig_act,                /* Action to take on signal     */
-       0 );                     /* Don't care about old actions */
-#    endif
-
-    itime.it_value.tv_sec = msec_1st_shot / 1000;
-    itime.it_value.tv_nsec = ( msec_1st_shot % 1000 ) * 1000000;
-    itime.it_interval.tv_sec = msec_rep_shot / 1000;
-    itime.it_interval.tv_nsec = ( msec_rep_shot % 1000 ) * 1000000;
-    timer_settime( timer_info->timer_id, 0, &itime, NULL );
-
-    return timer_info->timer_id;
-}                               // messip_timer_create
-
-#endif
+int messip_timer_delete( messip_channel_t *ch, timer_t timer_id ) {
+    if ( ch->timers == NULL ) {
+        errno = EINVAL;
+        return -1;
+    }
+    return messip_timer_stop( ch->timers, ( messip_timer_t * ) timer_id );
+}                               // messip_timer_delete
 
 /**
  *  TBD
@@ -1867,24 +4183,20 @@ timer_t messip_timer_create( messip_channel_t *ch, int32_t type, int msec_1st_sh
  */
 int32_t messip_death_notify( messip_cnx_t *cnx, int status, int msec_timeout ) {
     ssize_t dcount;
-    fd_set ready;
-    struct timeval tv;
-    int ok;
     int32_t op;
     messip_send_death_notify_t msgsend;
     messip_reply_death_notify_t msgreply;
     struct iovec iovec[2];
 
+    /*--- Other threads may be talking to the messip manager too ---*/
+    pthread_mutex_lock( &cnx->lock );
+
     /*--- Timeout to write ? ---*/
     if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( cnx->sockfd, &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        ok = select( ( int ) FD_SETSIZE, NULL, &ready, NULL, &tv );
-        assert( ok != -1 );
-        if ( !FD_ISSET( cnx->sockfd, &ready ) )
+        if ( messip_wait_ready( cnx->sockfd, POLLOUT, msec_timeout ) <= 0 ) {
+            pthread_mutex_unlock( &cnx->lock );
             return MESSIP_MSG_TIMEOUT;
+        }
     }
 
     /*--- Send a service message to the server + the private message ---*/
@@ -1901,13 +4213,8 @@ int32_t messip_death_notify( messip_cnx_t *cnx, int status, int msec_timeout ) {
 
     /*--- Ready to read ? ---*/
     if ( msec_timeout != MESSIP_NOTIMEOUT ) {
-        FD_ZERO( &ready );
-        FD_SET( cnx->sockfd, &ready );
-        tv.tv_sec = msec_timeout / 1000;
-        tv.tv_usec = ( msec_timeout % 1000 ) * 1000;
-        ok = select( ( int ) FD_SETSIZE, &ready, NULL, NULL, &tv );
-        assert( ok != -1 );
-        if ( !FD_ISSET( cnx->sockfd, &ready ) ) {
+        if ( messip_wait_ready( cnx->sockfd, POLLIN, msec_timeout ) <= 0 ) {
+            pthread_mutex_unlock( &cnx->lock );
             errno = ETIMEDOUT;
             return -1;
         }
@@ -1917,6 +4224,7 @@ int32_t messip_death_notify( messip_cnx_t *cnx, int status, int msec_timeout ) {
     iovec[0].iov_base = &msgreply;
     iovec[0].iov_len = sizeof( msgreply );
     dcount = messip_readv( cnx->sockfd, iovec, 1 );
+    pthread_mutex_unlock( &cnx->lock );
     messip_log( MESSIP_LOG_INFO, "messip_death_notify: reply dcount= %d \n", dcount );
     assert( dcount == sizeof( msgreply ) );
 
@@ -0,0 +1,124 @@
+/**
+ * @file messip_pool.c
+ *
+ * MessIP : Message Passing over TCP/IP
+ * Copyright (C) 2001-2007  Olivier Singla
+ * http://messip.sourceforge.net/
+ *
+ * Size-class buffer pool, used by a channel for the buffers it allocates
+ * on behalf of the caller (dynamic allocation mode) and for its own
+ * copies of the messages. Released buffers are kept on a free list per
+ * size class, so that steady traffic does not use the heap anymore.
+ *
+ * Each buffer is preceded by a header (one cache line), which tells to
+ * which pool and size class the buffer belongs: the data are then
+ * aligned on a cache line too.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include "messip_pool.h"
+
+#define POOL_ALIGN			64		// Cache line
+#define POOL_MIN_SHIFT		6		// Smallest class: 64 bytes
+#define POOL_NB_CLASSES		11		// Largest class: 64 KB (larger buffers are not pooled)
+#define POOL_MAXFREE		32		// Buffers kept per class
+
+#define POOL_MAGIC			0x6c6f6f70	// "pool"
+
+typedef union pool_hdr {
+    struct {
+        struct messip_pool *pool;
+        union pool_hdr *next;   // Free list
+        int32_t size_class;     // -1 if not pooled
+        uint32_t magic;
+    } h;
+    char align[POOL_ALIGN];
+} pool_hdr_t;
+
+struct messip_pool {
+    pool_hdr_t *free_list[POOL_NB_CLASSES];
+    int nb_free[POOL_NB_CLASSES];
+};
+
+/**
+ * Create an empty pool
+ *
+ * @return The pool, or NULL if an error occurred (errno is set)
+ */
+messip_pool_t *messip_pool_create( void ) {
+    messip_pool_t *pool = ( messip_pool_t * ) malloc( sizeof( messip_pool_t ) );
+    if ( pool != NULL )
+        memset( pool, 0, sizeof( messip_pool_t ) );
+    return pool;
+}                               // messip_pool_create
+
+/**
+ * Get a buffer, aligned on a cache line
+ *
+ * @param pool Pool returned by messip_pool_create()
+ * @param size Size of the buffer
+ * @return The buffer, or NULL if an error occurred (errno is set)
+ */
+void *messip_pool_alloc( messip_pool_t *pool, size_t size ) {
+    pool_hdr_t *hdr;
+    int size_class;
+
+    for ( size_class = 0; size_class < POOL_NB_CLASSES; size_class++ )
+        if ( size <= ( ( size_t ) 1 << ( POOL_MIN_SHIFT + size_class ) ) )
+            break;
+
+    /*--- Recycle a buffer of this class ---*/
+    if ( ( size_class < POOL_NB_CLASSES ) && ( pool->free_list[size_class] != NULL ) ) {
+        hdr = pool->free_list[size_class];
+        pool->free_list[size_class] = hdr->h.next;
+        pool->nb_free[size_class]--;
+        return hdr + 1;
+    }
+
+    /*--- Or allocate it ---*/
+    if ( size_class < POOL_NB_CLASSES )
+        size = ( size_t ) 1 << ( POOL_MIN_SHIFT + size_class );
+    else
+        size_class = -1;
+    if ( ( errno = posix_memalign( ( void ** ) &hdr, POOL_ALIGN, sizeof( pool_hdr_t ) + size ) ) != 0 )
+        return NULL;
+    hdr->h.pool = pool;
+    hdr->h.next = NULL;
+    hdr->h.size_class = size_class;
+    hdr->h.magic = POOL_MAGIC;
+    return hdr + 1;
+}                               // messip_pool_alloc
+
+/**
+ * Give a buffer back to the pool it has been allocated from
+ *
+ * @param buffer Buffer returned by messip_pool_alloc() (NULL is valid)
+ */
+void messip_pool_release( void *buffer ) {
+    pool_hdr_t *hdr;
+    messip_pool_t *pool;
+    int size_class;
+
+    if ( buffer == NULL )
+        return;
+    hdr = ( pool_hdr_t * ) buffer - 1;
+    if ( hdr->h.magic != POOL_MAGIC ) {
+        fprintf( stderr, "%s %d: buffer %p was not allocated from a pool\n", __FILE__, __LINE__, buffer );
+        return;
+    }
+    pool = hdr->h.pool;
+    size_class = hdr->h.size_class;
+    if ( ( size_class == -1 ) || ( pool->nb_free[size_class] >= POOL_MAXFREE ) ) {
+        hdr->h.magic = 0;
+        free( hdr );
+        return;
+    }
+    hdr->h.next = pool->free_list[size_class];
+    pool->free_list[size_class] = hdr;
+    pool->nb_free[size_class]++;
+}                               // messip_pool_release
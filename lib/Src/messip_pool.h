@@ -0,0 +1,19 @@
+/**
+ * @file messip_pool.h
+ *
+ * MessIP : Message Passing over TCP/IP
+ * Copyright (C) 2001-2007  Olivier Singla
+ * http://messip.sourceforge.net/
+ *
+ **/
+
+#ifndef MESSIP_POOL_H_
+#define MESSIP_POOL_H_
+
+typedef struct messip_pool messip_pool_t;
+
+messip_pool_t *messip_pool_create( void );
+void *messip_pool_alloc( messip_pool_t *pool, size_t size );
+void messip_pool_release( void *buffer );
+
+#endif /*MESSIP_POOL_H_*/
@@ -13,8 +13,6 @@
 /*
 */
 
-#define SIGVAL_PTR sival_ptr
-
 //
 // /etc/messip
 // 
@@ -27,6 +25,15 @@ typedef struct messip_mgr {
 } messip_mgr_t;
 
 
+// Same-host clients connect through an abstract AF_UNIX socket (MESSIP_SUN_PATH_MAXLEN)
+#define MESSIP_HOST_IDENT_MAXLEN	64		// See get_host_ident()
+
+
+// Handle given by the messip_mgr to a channel: index in its table of handles (32 low bits),
+// and generation of this entry (32 high bits), so that the handle of a deleted channel is not reused
+#define MESSIP_HANDLE_NONE		0
+
+
 // op : int32_t
 enum {
     MESSIP_OP_CONNECT = 0x01010101,
@@ -64,6 +71,8 @@ typedef struct {
     char channel_name[MESSIP_CHANNEL_NAME_MAXLEN + 1];
     uint16_t sin_port;
     char sin_addr_str[48];
+    char sun_path[MESSIP_SUN_PATH_MAXLEN];  // Empty if no AF_UNIX listener
+    char host_ident[MESSIP_HOST_IDENT_MAXLEN];
 } messip_send_channel_create_t;
 
 typedef struct {
@@ -71,6 +80,7 @@ typedef struct {
     in_port_t sin_port;
     in_addr_t sin_addr;
     char sin_addr_str[48];
+    uint64_t handle;            // Handle of the channel in the messip_mgr
 } messip_reply_channel_create_t;
 
 
@@ -79,8 +89,7 @@ typedef struct {
 // ----------------------------------------
 
 typedef struct {
-    messip_id_t id;
-    char name[MESSIP_CHANNEL_NAME_MAXLEN + 1];
+    uint64_t handle;            // Given by MESSIP_OP_CHANNEL_CREATE
 } messip_send_channel_delete_t;
 
 typedef struct {
@@ -104,7 +113,9 @@ typedef struct {
     in_port_t sin_port;         // 2 bytes
     in_addr_t sin_addr;         // 4 bytes
     char sin_addr_str[48];
-    int mgr_sockfd;             // Socket in the messip_mgr
+    uint64_t handle;            // Handle of the channel in the messip_mgr
+    char sun_path[MESSIP_SUN_PATH_MAXLEN];  // Empty if no AF_UNIX listener
+    char host_ident[MESSIP_HOST_IDENT_MAXLEN];
 } messip_reply_channel_connect_t;
 
 
@@ -113,8 +124,7 @@ typedef struct {
 // -----------------------------------------------
 
 typedef struct {
-    messip_id_t id;
-    char name[MESSIP_CHANNEL_NAME_MAXLEN + 1];
+    uint64_t handle;            // Given by MESSIP_OP_CHANNEL_CONNECT
 } messip_send_channel_disconnect_t;
 
 typedef struct {
@@ -140,10 +150,9 @@ typedef struct {
 // -------------------------------------
 
 typedef struct {
-    messip_id_t id_from;
+    uint64_t handle;            // Given by MESSIP_OP_CHANNEL_CONNECT (the sender is the connexion of the request)
     int32_t type;
     int32_t datalen;
-    int mgr_sockfd;             // Socket in the messip_mgr
 } messip_send_buffered_send_t;
 
 typedef struct {
@@ -177,6 +186,21 @@ typedef struct {
 #define MESSIP_FLAG_BUFFERED		6
 #define MESSIP_FLAG_PING			7
 #define MESSIP_FLAG_DEATH_PROCESS	8
+#define MESSIP_FLAG_SHM_ATTACH		9	// Client asks for the shared-memory transport
+
+// Buffered messages acknowledged at once by a server (answer of the messip_datareply_t)
+#define MESSIP_BUFFERED_ACK_BATCH	16
+
+// Buffered messages a client sends straight to a server (MESSIP_BUFFERED_DIRECT) before it waits for their acknowledgment
+#define MESSIP_BUFFERED_CREDITS		64
+
+// Channels messip_wait() watches without allocating memory
+#define MESSIP_WAIT_STACK			16
+
+// messip_channel_t.shm_slot, on a client
+#define MESSIP_SHM_SLOT_NONE		-1	// Shared-memory transport not used
+#define MESSIP_SHM_SLOT_UNKNOWN		-2	// Not negotiated yet (same host)
+#define MESSIP_SHM_SLOT_REQUESTED	-3	// Asked for, reply not read yet (see shm_attach)
 
 typedef struct {
     int32_t flag;
@@ -198,6 +222,7 @@ typedef struct {
 
 int messip_writev( SOCKET sockfd, const struct iovec *iov, int iovcnt );
 int messip_readv( SOCKET sockfd, const struct iovec *iov, int iovcnt );
+int messip_wait_ready( SOCKET sockfd, short events, int msec_timeout );
 
 
 #define IDCPY( DST, SRC ) \
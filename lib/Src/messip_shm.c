@@ -0,0 +1,455 @@
+/**
+ * @file messip_shm.c
+ *
+ * MessIP : Message Passing over TCP/IP
+ * Copyright (C) 2001-2007  Olivier Singla
+ * http://messip.sourceforge.net/
+ *
+ * Shared-memory transport, for clients running on the same host than
+ * the server owning the channel. The segment (a memfd) holds a ring of
+ * requests, written by the clients and read by the server, then one
+ * slot per client.
+ *
+ * - The client sleeps on the state of its slot (futex), until the
+ *   server has replied.
+ * - The server waits in messip_receive() on its sockets and on a
+ *   doorbell (eventfd), which is rung only if the server is sleeping.
+ *
+ * So no system call at all is performed while both sides are busy.
+ **/
+
+#define _GNU_SOURCE             // memfd_create()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <linux/futex.h>
+
+#include "messip.h"
+#include "messip_private.h"
+#include "messip_shm.h"
+
+#define SHM_MAGIC		0x6d736873	// "shsm"
+#define SHM_ALIGN		64			// Cache line
+#define SHM_SPIN		2000		// Polls before sleeping (only if there are several CPUs)
+
+#define ALIGN_UP(x)		( ( ( x ) + SHM_ALIGN - 1 ) & ~( SHM_ALIGN - 1 ) )
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX()		__asm__ __volatile__( "pause" )
+#else
+#define CPU_RELAX()		do { } while ( 0 )
+#endif
+
+typedef struct {
+    uint32_t magic;
+    uint32_t nb_slots;
+    uint32_t slot_size;
+    uint32_t ring_mask;
+    uint32_t tail __attribute__ ( ( aligned( SHM_ALIGN ) ) );  // Next position written by a client
+    uint32_t server_sleeping __attribute__ ( ( aligned( SHM_ALIGN ) ) );    // Doorbell must be rung
+} shm_header_t;
+
+struct messip_shm {
+    shm_header_t *hdr;
+    size_t size;
+    int memfd;                  // -1 once mapped by a client
+    int doorbell_fd;
+    uint32_t *ring;             // Slot index + 1, 0 if empty
+    char *slots;
+    size_t slot_stride;
+    uint32_t head;              // Server: next position to read in the ring
+    SOCKET *owner;              // Server: socket of the client owning each slot, or -1
+};
+
+static int shm_spin = -1;
+
+/**
+ * Number of polls before sleeping: spinning is pointless if the other side cannot run meanwhile
+ */
+static int spin_count( void ) {
+    if ( shm_spin == -1 )
+        shm_spin = ( sysconf( _SC_NPROCESSORS_ONLN ) > 1 ) ? SHM_SPIN : 0;
+    return shm_spin;
+}                               // spin_count
+
+static int futex( uint32_t *uaddr, int op, uint32_t val, const struct timespec *timeout ) {
+    return syscall( SYS_futex, uaddr, op, val, timeout, NULL, 0 );
+}                               // futex
+
+/**
+ * Compute the layout of a segment
+ *
+ * @param shm Handle to update (ring, slots and slot_stride)
+ * @param nb_slots Number of slots
+ * @param slot_size Maximum length of a request or of a reply
+ * @param ring_sz Set to the number of entries in the ring
+ * @return Size of the segment
+ */
+static size_t shm_layout( messip_shm_t *shm, int nb_slots, int slot_size, uint32_t *ring_sz ) {
+    size_t off;
+
+    /*--- A client whose request timed out might be queued twice ---*/
+    for ( *ring_sz = 1; *ring_sz < 2 * nb_slots; *ring_sz <<= 1 );
+    shm->slot_stride = ALIGN_UP( sizeof( messip_shm_slot_t ) ) + ALIGN_UP( slot_size );
+    off = ALIGN_UP( sizeof( shm_header_t ) );
+    shm->ring = ( uint32_t * ) ( ( char * ) shm->hdr + off );
+    off += ALIGN_UP( *ring_sz * sizeof( uint32_t ) );
+    shm->slots = ( char * ) shm->hdr + off;
+    return off + nb_slots * shm->slot_stride;
+}                               // shm_layout
+
+/**
+ * Server: create a segment
+ *
+ * @param name Name of the channel (only used to name the memfd)
+ * @param nb_slots Maximum number of clients attached at the same time
+ * @param slot_size Maximum length of a request or of a reply (larger ones use the socket)
+ * @return A handle, or NULL if an error occurred (errno is set)
+ */
+messip_shm_t *messip_shm_create( const char *name, int nb_slots, int slot_size ) {
+    messip_shm_t *shm;
+    messip_shm_t probe;
+    uint32_t ring_sz;
+    char memfd_name[64];
+
+    if ( ( nb_slots <= 0 ) || ( slot_size < 0 ) ) {
+        errno = EINVAL;
+        return NULL;
+    }
+    shm = ( messip_shm_t * ) malloc( sizeof( messip_shm_t ) );
+    if ( shm == NULL )
+        return NULL;
+    memset( shm, 0, sizeof( messip_shm_t ) );
+    memset( &probe, 0, sizeof( probe ) );
+    shm->size = shm_layout( &probe, nb_slots, slot_size, &ring_sz );
+
+    snprintf( memfd_name, sizeof( memfd_name ), "messip-%s", name );
+    shm->memfd = memfd_create( memfd_name, MFD_CLOEXEC );
+    if ( shm->memfd == -1 ) {
+        free( shm );
+        return NULL;
+    }
+    if ( ftruncate( shm->memfd, shm->size ) == -1 ) {
+        close( shm->memfd );
+        free( shm );
+        return NULL;
+    }
+    shm->hdr = ( shm_header_t * ) mmap( NULL, shm->size, PROT_READ | PROT_WRITE, MAP_SHARED, shm->memfd, 0 );
+    if ( shm->hdr == MAP_FAILED ) {
+        close( shm->memfd );
+        free( shm );
+        return NULL;
+    }
+    shm->doorbell_fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    if ( shm->doorbell_fd == -1 ) {
+        munmap( shm->hdr, shm->size );
+        close( shm->memfd );
+        free( shm );
+        return NULL;
+    }
+    shm_layout( shm, nb_slots, slot_size, &ring_sz );
+    shm->owner = ( SOCKET * ) malloc( sizeof( SOCKET ) * nb_slots );
+    if ( shm->owner == NULL ) {
+        close( shm->doorbell_fd );
+        munmap( shm->hdr, shm->size );
+        close( shm->memfd );
+        free( shm );
+        errno = ENOMEM;
+        return NULL;
+    }
+    for ( int n = 0; n < nb_slots; n++ )
+        shm->owner[n] = -1;
+
+    /*--- The segment is zeroed by ftruncate: all slots are idle, the ring is empty ---*/
+    shm->hdr->nb_slots = nb_slots;
+    shm->hdr->slot_size = slot_size;
+    shm->hdr->ring_mask = ring_sz - 1;
+    __atomic_store_n( &shm->hdr->magic, SHM_MAGIC, __ATOMIC_RELEASE );
+
+    return shm;
+}                               // messip_shm_create
+
+/**
+ * Client: map a segment received from the server
+ *
+ * @param memfd File descriptor of the segment (closed by this function)
+ * @param size Size of the segment
+ * @param doorbell_fd Doorbell of the server (kept open until messip_shm_destroy, closed on error)
+ * @return A handle, or NULL if an error occurred (errno is set)
+ */
+messip_shm_t *messip_shm_attach( int memfd, size_t size, int doorbell_fd ) {
+    messip_shm_t *shm;
+    uint32_t ring_sz;
+
+    shm = ( messip_shm_t * ) malloc( sizeof( messip_shm_t ) );
+    if ( shm == NULL ) {
+        close( memfd );
+        close( doorbell_fd );
+        return NULL;
+    }
+    memset( shm, 0, sizeof( messip_shm_t ) );
+    shm->hdr = ( shm_header_t * ) mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0 );
+    close( memfd );
+    if ( shm->hdr == MAP_FAILED ) {
+        close( doorbell_fd );
+        free( shm );
+        return NULL;
+    }
+    shm->size = size;
+    shm->memfd = -1;
+    shm->doorbell_fd = doorbell_fd;
+    if ( ( __atomic_load_n( &shm->hdr->magic, __ATOMIC_ACQUIRE ) != SHM_MAGIC )
+       || ( shm_layout( shm, shm->hdr->nb_slots, shm->hdr->slot_size, &ring_sz ) > size )
+       || ( ring_sz != shm->hdr->ring_mask + 1 ) ) {
+        messip_shm_destroy( shm );
+        errno = EINVAL;
+        return NULL;
+    }
+    return shm;
+}                               // messip_shm_attach
+
+/**
+ * Unmap a segment, and close the descriptors still owned by this handle
+ *
+ * @param shm Handle returned by messip_shm_create() or messip_shm_attach()
+ */
+void messip_shm_destroy( messip_shm_t *shm ) {
+    munmap( shm->hdr, shm->size );
+    if ( shm->memfd != -1 )
+        close( shm->memfd );
+    close( shm->doorbell_fd );
+    free( shm->owner );
+    free( shm );
+}                               // messip_shm_destroy
+
+int messip_shm_memfd( messip_shm_t *shm ) {
+    return shm->memfd;
+}                               // messip_shm_memfd
+
+size_t messip_shm_size( messip_shm_t *shm ) {
+    return shm->size;
+}                               // messip_shm_size
+
+int messip_shm_doorbell( messip_shm_t *shm ) {
+    return shm->doorbell_fd;
+}                               // messip_shm_doorbell
+
+int messip_shm_slot_size( messip_shm_t *shm ) {
+    return shm->hdr->slot_size;
+}                               // messip_shm_slot_size
+
+messip_shm_slot_t *messip_shm_slot( messip_shm_t *shm, int slot ) {
+    return ( messip_shm_slot_t * ) ( shm->slots + slot * shm->slot_stride );
+}                               // messip_shm_slot
+
+void *messip_shm_slot_data( messip_shm_t *shm, int slot ) {
+    return shm->slots + slot * shm->slot_stride + ALIGN_UP( sizeof( messip_shm_slot_t ) );
+}                               // messip_shm_slot_data
+
+/**
+ * Server: give a slot to a client
+ *
+ * @param shm Handle returned by messip_shm_create()
+ * @param owner Socket connected to this client
+ * @return The slot, or -1 if all the slots are already used
+ */
+int messip_shm_slot_alloc( messip_shm_t *shm, SOCKET owner ) {
+    for ( int slot = 0; slot < shm->hdr->nb_slots; slot++ ) {
+        if ( shm->owner[slot] == -1 ) {
+            shm->owner[slot] = owner;
+            __atomic_store_n( &messip_shm_slot( shm, slot )->state, MESSIP_SHM_IDLE, __ATOMIC_RELEASE );
+            return slot;
+        }
+    }
+    return -1;
+}                               // messip_shm_slot_alloc
+
+SOCKET messip_shm_slot_owner( messip_shm_t *shm, int slot ) {
+    return shm->owner[slot];
+}                               // messip_shm_slot_owner
+
+/**
+ * Server: release the slot of a client whose connection has been closed
+ *
+ * @param shm Handle returned by messip_shm_create()
+ * @param owner Socket connected to this client
+ */
+void messip_shm_slot_release( messip_shm_t *shm, SOCKET owner ) {
+    for ( int slot = 0; slot < shm->hdr->nb_slots; slot++ ) {
+        if ( shm->owner[slot] == owner ) {
+            __atomic_store_n( &messip_shm_slot( shm, slot )->state, MESSIP_SHM_IDLE, __ATOMIC_RELEASE );
+            shm->owner[slot] = -1;
+        }
+    }
+}                               // messip_shm_slot_release
+
+/**
+ * Client: queue the request written into its slot, then ring the doorbell if the server sleeps
+ *
+ * @param shm Handle returned by messip_shm_attach()
+ * @param slot Slot owned by this client
+ */
+void messip_shm_post( messip_shm_t *shm, int slot ) {
+    uint64_t one = 1;
+
+    __atomic_store_n( &messip_shm_slot( shm, slot )->state, MESSIP_SHM_REQUEST, __ATOMIC_RELEASE );
+    uint32_t pos = __atomic_fetch_add( &shm->hdr->tail, 1, __ATOMIC_SEQ_CST );
+    __atomic_store_n( &shm->ring[pos & shm->hdr->ring_mask], slot + 1, __ATOMIC_SEQ_CST );
+    if ( __atomic_exchange_n( &shm->hdr->server_sleeping, 0, __ATOMIC_SEQ_CST ) ) {
+        while ( ( write( shm->doorbell_fd, &one, sizeof( one ) ) == -1 ) && ( errno == EINTR ) );
+    }
+}                               // messip_shm_post
+
+/**
+ * Client: wait until the server has replied
+ *
+ * @param shm Handle returned by messip_shm_attach()
+ * @param slot Slot owned by this client
+ * @param msec_timeout Timeout expressed in milliseconds, or MESSIP_NOTIMEOUT
+ * @return The state of the slot (MESSIP_SHM_REPLY or MESSIP_SHM_REPLY_SOCKET),
+ *    or -1 if the operation timed out (errno is then set to ETIMEDOUT)
+ */
+int messip_shm_wait_reply( messip_shm_t *shm, int slot, int msec_timeout ) {
+    messip_shm_slot_t *s = messip_shm_slot( shm, slot );
+    struct timespec deadline, now, rel;
+    uint32_t state;
+
+    for ( int n = spin_count(  ); n > 0; n-- ) {
+        state = __atomic_load_n( &s->state, __ATOMIC_ACQUIRE );
+        if ( state != MESSIP_SHM_REQUEST )
+            return state;
+        CPU_RELAX(  );
+    }
+
+    if ( msec_timeout != MESSIP_NOTIMEOUT ) {
+        clock_gettime( CLOCK_MONOTONIC, &deadline );
+        deadline.tv_sec += msec_timeout / 1000;
+        deadline.tv_nsec += ( msec_timeout % 1000 ) * 1000000;
+        if ( deadline.tv_nsec >= 1000000000 ) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+    for ( ;; ) {
+        __atomic_store_n( &s->waiting, 1, __ATOMIC_SEQ_CST );
+        state = __atomic_load_n( &s->state, __ATOMIC_SEQ_CST );
+        if ( state != MESSIP_SHM_REQUEST )
+            break;
+        if ( msec_timeout != MESSIP_NOTIMEOUT ) {
+            clock_gettime( CLOCK_MONOTONIC, &now );
+            rel.tv_sec = deadline.tv_sec - now.tv_sec;
+            rel.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+            if ( rel.tv_nsec < 0 ) {
+                rel.tv_sec--;
+                rel.tv_nsec += 1000000000;
+            }
+            if ( rel.tv_sec < 0 ) {
+                __atomic_store_n( &s->waiting, 0, __ATOMIC_RELAXED );
+                errno = ETIMEDOUT;
+                return -1;
+            }
+        }
+        futex( &s->state, FUTEX_WAIT, MESSIP_SHM_REQUEST, ( msec_timeout != MESSIP_NOTIMEOUT ) ? &rel : NULL );
+    }                           // for (;;)
+    __atomic_store_n( &s->waiting, 0, __ATOMIC_RELAXED );
+    return state;
+}                               // messip_shm_wait_reply
+
+/**
+ * Server: get the next request, without waiting
+ *
+ * @param shm Handle returned by messip_shm_create()
+ * @return The slot holding the request, or -1 if there is no request
+ */
+int messip_shm_pop( messip_shm_t *shm ) {
+    for ( ;; ) {
+        uint32_t *entry = &shm->ring[shm->head & shm->hdr->ring_mask];
+        uint32_t v = __atomic_load_n( entry, __ATOMIC_ACQUIRE );
+        if ( v == 0 )
+            return -1;
+        __atomic_store_n( entry, 0, __ATOMIC_RELAXED );
+        shm->head++;
+
+        /*--- Skip requests of clients which are gone, or already handled ---*/
+        int slot = v - 1;
+        if ( ( slot < shm->hdr->nb_slots ) && ( shm->owner[slot] != -1 )
+           && ( __atomic_load_n( &messip_shm_slot( shm, slot )->state, __ATOMIC_ACQUIRE ) == MESSIP_SHM_REQUEST ) )
+            return slot;
+    }                           // for (;;)
+}                               // messip_shm_pop
+
+/**
+ * Server: about to sleep. Polls the ring for a while, then asks the clients to ring the doorbell.
+ *
+ * @param shm Handle returned by messip_shm_create()
+ * @return A slot holding a request (then do not sleep), or -1 (then sleep, and call messip_shm_sleep_done)
+ */
+int messip_shm_sleep_prepare( messip_shm_t *shm ) {
+    int slot;
+
+    for ( int n = spin_count(  ); n > 0; n-- ) {
+        if ( ( slot = messip_shm_pop( shm ) ) != -1 )
+            return slot;
+        CPU_RELAX(  );
+    }
+    __atomic_store_n( &shm->hdr->server_sleeping, 1, __ATOMIC_SEQ_CST );
+    slot = messip_shm_pop( shm );
+    if ( slot != -1 )
+        __atomic_store_n( &shm->hdr->server_sleeping, 0, __ATOMIC_SEQ_CST );
+    return slot;
+}                               // messip_shm_sleep_prepare
+
+/**
+ * Server: about to sleep on several channels at once (see messip_channelset_receive). 
+ * Does not consume the request, unlike messip_shm_sleep_prepare().
+ *
+ * @param shm Handle returned by messip_shm_create()
+ * @return 1 if a request may be in the ring (then do not sleep), or 0 (then sleep, and call messip_shm_sleep_done)
+ */
+int messip_shm_sleep_announce( messip_shm_t *shm ) {
+    uint32_t *entry = &shm->ring[shm->head & shm->hdr->ring_mask];
+
+    if ( __atomic_load_n( entry, __ATOMIC_ACQUIRE ) != 0 )
+        return 1;
+    __atomic_store_n( &shm->hdr->server_sleeping, 1, __ATOMIC_SEQ_CST );
+    if ( __atomic_load_n( entry, __ATOMIC_SEQ_CST ) != 0 ) {
+        __atomic_store_n( &shm->hdr->server_sleeping, 0, __ATOMIC_SEQ_CST );
+        return 1;
+    }
+    return 0;
+}                               // messip_shm_sleep_announce
+
+/**
+ * Server: awake, so the clients do not need to ring the doorbell anymore
+ *
+ * @param shm Handle returned by messip_shm_create()
+ */
+void messip_shm_sleep_done( messip_shm_t *shm ) {
+    uint64_t count;
+
+    __atomic_store_n( &shm->hdr->server_sleeping, 0, __ATOMIC_SEQ_CST );
+    while ( read( shm->doorbell_fd, &count, sizeof( count ) ) > 0 );
+}                               // messip_shm_sleep_done
+
+/**
+ * Server: the reply has been written, so wake up the client if it sleeps
+ *
+ * @param shm Handle returned by messip_shm_create()
+ * @param slot Slot of the client
+ * @param state MESSIP_SHM_REPLY or MESSIP_SHM_REPLY_SOCKET
+ */
+void messip_shm_complete( messip_shm_t *shm, int slot, uint32_t state ) {
+    messip_shm_slot_t *s = messip_shm_slot( shm, slot );
+
+    __atomic_store_n( &s->state, state, __ATOMIC_SEQ_CST );
+    if ( __atomic_load_n( &s->waiting, __ATOMIC_SEQ_CST ) )
+        futex( &s->state, FUTEX_WAKE, 1, NULL );
+}                               // messip_shm_complete
@@ -0,0 +1,57 @@
+/**
+ * @file messip_shm.h
+ *
+ * MessIP : Message Passing over TCP/IP
+ * Copyright (C) 2001-2007  Olivier Singla
+ * http://messip.sourceforge.net/
+ *
+ **/
+
+#ifndef MESSIP_SHM_H_
+#define MESSIP_SHM_H_
+
+/*--- State of a slot (futex word) ---*/
+#define MESSIP_SHM_IDLE			0
+#define MESSIP_SHM_REQUEST		1	// Written by the client, not yet replied
+#define MESSIP_SHM_REPLY		2	// Reply is in the slot
+#define MESSIP_SHM_REPLY_SOCKET	3	// Reply was too large: it has been written on the socket
+
+/*
+ * One slot per client: the client writes its request in its slot, the
+ * server reads it in place then writes the reply in the same slot.
+ * The data follow, at messip_shm_slot_data().
+ */
+typedef struct {
+    uint32_t state;
+    uint32_t waiting;           // Client is sleeping on state (the server must wake it up)
+    messip_datasend_t datasend;
+    messip_datareply_t datareply;
+} messip_shm_slot_t;
+
+typedef struct messip_shm messip_shm_t;
+
+messip_shm_t *messip_shm_create( const char *name, int nb_slots, int slot_size );
+messip_shm_t *messip_shm_attach( int memfd, size_t size, int doorbell_fd );
+void messip_shm_destroy( messip_shm_t *shm );
+
+int messip_shm_memfd( messip_shm_t *shm );
+size_t messip_shm_size( messip_shm_t *shm );
+int messip_shm_doorbell( messip_shm_t *shm );
+int messip_shm_slot_size( messip_shm_t *shm );
+messip_shm_slot_t *messip_shm_slot( messip_shm_t *shm, int slot );
+void *messip_shm_slot_data( messip_shm_t *shm, int slot );
+
+int messip_shm_slot_alloc( messip_shm_t *shm, SOCKET owner );
+SOCKET messip_shm_slot_owner( messip_shm_t *shm, int slot );
+void messip_shm_slot_release( messip_shm_t *shm, SOCKET owner );
+
+void messip_shm_post( messip_shm_t *shm, int slot );
+int messip_shm_wait_reply( messip_shm_t *shm, int slot, int msec_timeout );
+
+int messip_shm_pop( messip_shm_t *shm );
+int messip_shm_sleep_prepare( messip_shm_t *shm );
+int messip_shm_sleep_announce( messip_shm_t *shm );
+void messip_shm_sleep_done( messip_shm_t *shm );
+void messip_shm_complete( messip_shm_t *shm, int slot, uint32_t state );
+
+#endif /*MESSIP_SHM_H_*/
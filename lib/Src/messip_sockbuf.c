@@ -0,0 +1,312 @@
+/**
+ * @file messip_sockbuf.c
+ *
+ * MessIP : Message Passing over TCP/IP
+ * Copyright (C) 2001-2007  Olivier Singla
+ * http://messip.sourceforge.net/
+ *
+ * Buffered reads and writes of the messages on a socket.
+ *
+ * A message is read in several parts (header, length, data...). Instead of
+ * one readv() per part, a read asks for all the bytes available: what
+ * does not belong to the part being read is kept in a buffer of the
+ * socket (read-ahead), where the next parts - and often the next
+ * messages - are then found without any system call.
+ *
+ * The buffers are found from the socket file descriptor, and are released
+ * when the socket is closed (messip_sockbuf_reset). A socket is read by
+ * one thread at a time.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+#include "messip.h"
+#include "messip_private.h"
+#include "messip_sockbuf.h"
+
+#define SOCKBUF_SIZE		8192	// Read-ahead of a socket
+#define SOCKBUF_IOV_MAX		( MESSIP_IOV_MAX + 2 )	// Header and length of a message, then its segments
+#define SOCKBUF_SHIFT		10		// Sockets per chunk of the table: 1024
+#define SOCKBUF_NB_CHUNKS	1024	// File descriptors up to 1M
+
+typedef struct sockbuf {
+    int32_t head;               // First byte not consumed yet
+    int32_t tail;               // End of the bytes read
+    char data[SOCKBUF_SIZE];
+} sockbuf_t;
+
+static sockbuf_t **chunks[SOCKBUF_NB_CHUNKS];   ///< Buffer of each socket, by file descriptor
+
+/**
+ * Buffer of a socket
+ *
+ * @param sockfd Socket file descriptor
+ * @param create Allocate it, if the socket has none yet
+ * @return The buffer, or NULL (none, or out of memory)
+ */
+static sockbuf_t *sockbuf_get( SOCKET sockfd, int create ) {
+    sockbuf_t **chunk, **expected;
+    sockbuf_t *buf;
+
+    if ( ( sockfd < 0 ) || ( ( sockfd >> SOCKBUF_SHIFT ) >= SOCKBUF_NB_CHUNKS ) )
+        return NULL;
+    chunk = __atomic_load_n( &chunks[sockfd >> SOCKBUF_SHIFT], __ATOMIC_ACQUIRE );
+    if ( chunk == NULL ) {
+        if ( !create )
+            return NULL;
+        chunk = ( sockbuf_t ** ) calloc( 1 << SOCKBUF_SHIFT, sizeof( sockbuf_t * ) );
+        if ( chunk == NULL )
+            return NULL;
+        expected = NULL;
+        if ( !__atomic_compare_exchange_n( &chunks[sockfd >> SOCKBUF_SHIFT], &expected, chunk,
+              0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+            free( chunk );
+            chunk = expected;
+        }
+    }
+    buf = chunk[sockfd & ( ( 1 << SOCKBUF_SHIFT ) - 1 )];
+    if ( ( buf == NULL ) && create ) {
+        buf = ( sockbuf_t * ) malloc( sizeof( sockbuf_t ) );
+        if ( buf == NULL )
+            return NULL;
+        buf->head = buf->tail = 0;
+        chunk[sockfd & ( ( 1 << SOCKBUF_SHIFT ) - 1 )] = buf;
+    }
+    return buf;
+}                               // sockbuf_get
+
+/**
+ * Advance segments over the bytes stored into them
+ *
+ * @param iov Segments
+ * @param first Index of the first segment not full (updated)
+ * @param iovcnt Number of segments
+ * @param len Number of bytes stored
+ */
+static void iov_advance( struct iovec *iov, int *first, int iovcnt, size_t len ) {
+    while ( *first < iovcnt ) {
+        if ( len < iov[*first].iov_len ) {
+            iov[*first].iov_base = ( char * ) iov[*first].iov_base + len;
+            iov[*first].iov_len -= len;
+            return;
+        }
+        len -= iov[*first].iov_len;
+        ( *first )++;
+    }                           // while
+}                               // iov_advance
+
+/**
+ * Read from a socket until all the segments are filled: the bytes read ahead are used first,
+ * then one readv() asks for all the bytes available (what follows the segments is read ahead)
+ *
+ * @param sockfd Socket file descriptor
+ * @param iov Segments, at most MESSIP_IOV_MAX + 2
+ * @param iovcnt Number of segments
+ * @param read_ahead Read more than asked, if available. Otherwise only what was read ahead
+ *    before is used: the bytes following the segments stay in the socket.
+ * @return
+ *  - The number of bytes read (the length of the segments)
+ *  - 0 if the connection was closed before the first byte
+ *  - -1 if an error occurred (errno is set: ECONNRESET if the connection was closed
+ *    in the middle of the segments)
+ */
+int messip_sockbuf_readv( SOCKET sockfd, const struct iovec *iov, int iovcnt, int read_ahead ) {
+    struct iovec vec[SOCKBUF_IOV_MAX + 1];
+    sockbuf_t *buf;
+    size_t total, done, len;
+    ssize_t dcount;
+    int first, n;
+
+    if ( ( iovcnt < 0 ) || ( iovcnt > SOCKBUF_IOV_MAX ) ) {
+        errno = EINVAL;
+        return -1;
+    }
+    memcpy( vec, iov, iovcnt * sizeof( struct iovec ) );
+    for ( total = 0, n = 0; n < iovcnt; n++ )
+        total += vec[n].iov_len;
+    first = 0;
+    iov_advance( vec, &first, iovcnt, 0 );
+    done = 0;
+
+    /*--- Bytes read ahead before ---*/
+    buf = sockbuf_get( sockfd, read_ahead );
+    if ( buf != NULL ) {
+        while ( ( buf->head < buf->tail ) && ( first < iovcnt ) ) {
+            len = buf->tail - buf->head;
+            if ( len > vec[first].iov_len )
+                len = vec[first].iov_len;
+            memcpy( vec[first].iov_base, &buf->data[buf->head], len );
+            buf->head += len;
+            done += len;
+            iov_advance( vec, &first, iovcnt, len );
+        }                       // while
+        if ( buf->head == buf->tail )
+            buf->head = buf->tail = 0;
+    }
+
+    /*--- Then the socket: the buffer is empty, so it can take whatever follows ---*/
+    while ( done < total ) {
+        n = iovcnt - first;
+        if ( read_ahead && ( buf != NULL ) ) {
+            vec[iovcnt].iov_base = buf->data;
+            vec[iovcnt].iov_len = SOCKBUF_SIZE;
+            n++;
+        }
+        dcount = readv( sockfd, &vec[first], n );
+        if ( ( dcount == -1 ) && ( errno == EINTR ) )
+            continue;
+        if ( dcount == -1 )
+            return -1;
+        if ( dcount == 0 ) {
+            if ( done == 0 )
+                return 0;
+            errno = ECONNRESET;
+            return -1;
+        }
+        len = ( dcount < total - done ) ? dcount : total - done;
+        iov_advance( vec, &first, iovcnt, len );
+        done += len;
+        if ( dcount > len )
+            buf->tail = dcount - len;
+    }                           // while
+
+    return done;
+}                               // messip_sockbuf_readv
+
+/**
+ * Read and discard data from a socket (part of a message the receiver did not want)
+ *
+ * @param sockfd Socket file descriptor
+ * @param len Number of bytes to discard
+ * @param read_ahead See messip_sockbuf_readv()
+ * @return 0 if no error, or -1 if an error occurred (errno is set)
+ */
+int messip_sockbuf_drain( SOCKET sockfd, int32_t len, int read_ahead ) {
+    char temp[4096];
+    struct iovec iovec[1];
+    int dcount;
+
+    while ( len > 0 ) {
+        iovec[0].iov_base = temp;
+        iovec[0].iov_len = ( len < sizeof( temp ) ) ? len : sizeof( temp );
+        dcount = messip_sockbuf_readv( sockfd, iovec, 1, read_ahead );
+        if ( dcount <= 0 ) {
+            if ( dcount == 0 )
+                errno = ECONNRESET;
+            return -1;
+        }
+        len -= dcount;
+    }                           // while
+    return 0;
+}                               // messip_sockbuf_drain
+
+/**
+ * Number of bytes read ahead on a socket, and not consumed yet
+ *
+ * @param sockfd Socket file descriptor
+ * @return Number of bytes (0 if none: the next ones are still in the socket)
+ */
+int messip_sockbuf_pending( SOCKET sockfd ) {
+    sockbuf_t *buf = sockbuf_get( sockfd, 0 );
+
+    return ( buf != NULL ) ? buf->tail - buf->head : 0;
+}                               // messip_sockbuf_pending
+
+/**
+ * Wait until a socket has data to read: at once if some have been read ahead already
+ *
+ * @param sockfd Socket file descriptor
+ * @param msec_timeout Timeout expressed in milliseconds, or MESSIP_NOTIMEOUT
+ * @return 1 if data can be read, 0 if the operation timed out, or -1 if an error occurred (errno is set)
+ */
+int messip_sockbuf_wait( SOCKET sockfd, int msec_timeout ) {
+    if ( messip_sockbuf_pending( sockfd ) > 0 )
+        return 1;
+    return messip_wait_ready( sockfd, POLLIN, msec_timeout );
+}                               // messip_sockbuf_wait
+
+/**
+ * Release the buffer of a socket, which is being closed: its file descriptor
+ * may be reused by another socket
+ *
+ * @param sockfd Socket file descriptor
+ */
+void messip_sockbuf_reset( SOCKET sockfd ) {
+    sockbuf_t **chunk;
+
+    if ( ( sockfd < 0 ) || ( ( sockfd >> SOCKBUF_SHIFT ) >= SOCKBUF_NB_CHUNKS ) )
+        return;
+    chunk = __atomic_load_n( &chunks[sockfd >> SOCKBUF_SHIFT], __ATOMIC_ACQUIRE );
+    if ( chunk == NULL )
+        return;
+    free( chunk[sockfd & ( ( 1 << SOCKBUF_SHIFT ) - 1 )] );
+    chunk[sockfd & ( ( 1 << SOCKBUF_SHIFT ) - 1 )] = NULL;
+}                               // messip_sockbuf_reset
+
+/**
+ * Write data from multiple buffers over a socket, within a timeout. The write is tried first:
+ * the socket is polled only if it cannot take the data at once (no readiness check per message).
+ *
+ * @param sockfd Socket file descriptor
+ * @param iov Segments, at most MESSIP_IOV_MAX + 2
+ * @param iovcnt Number of segments
+ * @param msec_timeout Timeout expressed in milliseconds, or MESSIP_NOTIMEOUT (then a plain
+ *    blocking write)
+ * @return The number of bytes written, or -1 if an error occurred (errno is set: ETIMEDOUT if
+ *    nothing could be written within the timeout. Once some bytes are written, the rest is
+ *    written whatever the time it takes, not to leave a part of a message in the socket.)
+ */
+ssize_t messip_sockbuf_writev( SOCKET sockfd, const struct iovec *iov, int iovcnt, int msec_timeout ) {
+    struct iovec vec[SOCKBUF_IOV_MAX];
+    struct msghdr msg;
+    size_t total, done;
+    ssize_t dcount;
+    int first, n, status;
+
+    if ( msec_timeout == MESSIP_NOTIMEOUT )
+        return messip_writev( sockfd, iov, iovcnt );
+    if ( ( iovcnt < 0 ) || ( iovcnt > SOCKBUF_IOV_MAX ) ) {
+        errno = EINVAL;
+        return -1;
+    }
+    memcpy( vec, iov, iovcnt * sizeof( struct iovec ) );
+    for ( total = 0, n = 0; n < iovcnt; n++ )
+        total += vec[n].iov_len;
+    first = 0;
+    done = 0;
+
+    while ( done < total ) {
+        memset( &msg, 0, sizeof( msg ) );
+        msg.msg_iov = &vec[first];
+        msg.msg_iovlen = iovcnt - first;
+        dcount = sendmsg( sockfd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL );
+        if ( dcount >= 0 ) {
+            iov_advance( vec, &first, iovcnt, dcount );
+            done += dcount;
+            continue;
+        }
+        if ( errno == EINTR )
+            continue;
+        if ( ( errno != EAGAIN ) && ( errno != EWOULDBLOCK ) )
+            return -1;
+
+        /*--- Socket full: wait until it can take more ---*/
+        status = messip_wait_ready( sockfd, POLLOUT, ( done == 0 ) ? msec_timeout : MESSIP_NOTIMEOUT );
+        if ( status == -1 )
+            return -1;
+        if ( status == 0 ) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+    }                           // while
+
+    return done;
+}                               // messip_sockbuf_writev
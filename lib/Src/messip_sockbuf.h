@@ -0,0 +1,21 @@
+/**
+ * @file messip_sockbuf.h
+ *
+ * MessIP : Message Passing over TCP/IP
+ * Copyright (C) 2001-2007  Olivier Singla
+ * http://messip.sourceforge.net/
+ *
+ **/
+
+#ifndef MESSIP_SOCKBUF_H_
+#define MESSIP_SOCKBUF_H_
+
+int messip_sockbuf_readv( SOCKET sockfd, const struct iovec *iov, int iovcnt, int read_ahead );
+int messip_sockbuf_drain( SOCKET sockfd, int32_t len, int read_ahead );
+int messip_sockbuf_pending( SOCKET sockfd );
+int messip_sockbuf_wait( SOCKET sockfd, int msec_timeout );
+void messip_sockbuf_reset( SOCKET sockfd );
+
+ssize_t messip_sockbuf_writev( SOCKET sockfd, const struct iovec *iov, int iovcnt, int msec_timeout );
+
+#endif /*MESSIP_SOCKBUF_H_*/
@@ -0,0 +1,451 @@
+/**
+ * @file messip_timer.c
+ *
+ * MessIP : Message Passing over TCP/IP
+ * Copyright (C) 2001-2007  Olivier Singla
+ * http://messip.sourceforge.net/
+ *
+ * Timer engine: all the timers of the process are kept in a hierarchical
+ * timer wheel, driven by a single timerfd (CLOCK_MONOTONIC), which is
+ * programmed for the next expiration only. Starting or stopping a timer
+ * is O(1), whatever the number of timers.
+ *
+ * The timerfd is watched by the receive engine of each channel owning
+ * timers: the first one to see it advances the wheel. An expired timer
+ * is queued on the timer queue of its channel, whose eventfd is readable
+ * as long as this queue is not empty, so that messip_receive() returns
+ * the expiration without any message being sent.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+
+#include "messip_timer.h"
+
+#define WHEEL_BITS			8
+#define WHEEL_SIZE			( 1 << WHEEL_BITS )	// Slots per level
+#define WHEEL_MASK			( WHEEL_SIZE - 1 )
+#define WHEEL_LEVELS		4		// Ticks of 1 ms: up to 2^32 ms (49 days) ahead
+
+struct messip_timer {
+    struct messip_timer *prev;  // Slot of the wheel
+    struct messip_timer *next;
+    struct messip_timer **slot; // NULL if not armed
+    struct messip_timer *fired_prev;    // Queue of the expired timers, not received yet
+    struct messip_timer *fired_next;
+    struct messip_timer *queue_prev;    // All the timers of the queue
+    struct messip_timer *queue_next;
+    struct messip_timer_queue *queue;
+    uint64_t expires;           // Tick of the next expiration
+    uint32_t period;            // Ticks between two expirations, 0 if one-shot
+    uint32_t nb_fired;          // Expirations not received yet
+    int32_t type;
+};
+
+struct messip_timer_queue {
+    int eventfd;                // Readable while some expirations have not been received yet
+    messip_timer_t *fired_first;
+    messip_timer_t *fired_last;
+    messip_timer_t *timers;
+};
+
+static struct {
+    pthread_mutex_t lock;       // Protects the wheel, the queues and their timers
+    pthread_once_t once;
+    int timerfd;
+    uint64_t base;              // CLOCK_MONOTONIC when the engine was created, in ms
+    uint64_t now;               // Last tick processed
+    uint64_t programmed;        // Tick the timerfd is programmed for, 0 if disarmed
+    int nb_armed;
+    messip_timer_t *slots[WHEEL_LEVELS][WHEEL_SIZE];
+} wheel = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_ONCE_INIT, -1
+};
+
+/**
+ * Read the monotonic clock
+ *
+ * @return Time elapsed since an unspecified point in the past, in milliseconds
+ */
+static uint64_t monotonic_msec( void ) {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( uint64_t ) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}                               // monotonic_msec
+
+/**
+ * Create the timerfd of the process (called once)
+ */
+static void engine_init( void ) {
+    wheel.base = monotonic_msec(  );
+    wheel.timerfd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+}                               // engine_init
+
+/**
+ * Get the timerfd driving the timers of the process
+ *
+ * @return The file descriptor, or -1 if it could not be created (errno is set)
+ */
+int messip_timer_engine_fd( void ) {
+    pthread_once( &wheel.once, engine_init );
+    return wheel.timerfd;
+}                               // messip_timer_engine_fd
+
+/**
+ * Insert an armed timer in the wheel, at the level matching its expiration
+ * (the wheel lock is owned by the caller)
+ *
+ * @param timer Timer, whose expires field is set
+ */
+static void wheel_insert( messip_timer_t *timer ) {
+    uint64_t delta;
+    int level;
+
+    if ( timer->expires <= wheel.now )
+        timer->expires = wheel.now + 1;
+    delta = timer->expires - wheel.now;
+    for ( level = 0; level < WHEEL_LEVELS - 1; level++ )
+        if ( delta < ( 1ULL << ( WHEEL_BITS * ( level + 1 ) ) ) )
+            break;
+
+    timer->slot = &wheel.slots[level][( timer->expires >> ( WHEEL_BITS * level ) ) & WHEEL_MASK];
+    timer->prev = NULL;
+    timer->next = *timer->slot;
+    if ( timer->next != NULL )
+        timer->next->prev = timer;
+    *timer->slot = timer;
+}                               // wheel_insert
+
+/**
+ * Remove a timer from the slot of the wheel where it is (the wheel lock is owned by the caller)
+ *
+ * @param timer Timer
+ */
+static void wheel_remove( messip_timer_t *timer ) {
+    if ( timer->prev != NULL )
+        timer->prev->next = timer->next;
+    else
+        *timer->slot = timer->next;
+    if ( timer->next != NULL )
+        timer->next->prev = timer->prev;
+    timer->slot = NULL;
+}                               // wheel_remove
+
+/**
+ * Queue an expiration, to be returned by messip_receive() (the wheel lock is owned by the caller).
+ * Expirations not received yet are counted, rather than queued again.
+ *
+ * @param timer Timer which has expired
+ */
+static void queue_fire( messip_timer_t *timer ) {
+    messip_timer_queue_t *queue = timer->queue;
+    uint64_t one = 1;
+
+    if ( timer->nb_fired++ )
+        return;
+    timer->fired_next = NULL;
+    timer->fired_prev = queue->fired_last;
+    if ( queue->fired_last != NULL )
+        queue->fired_last->fired_next = timer;
+    else {
+        queue->fired_first = timer;
+        if ( write( queue->eventfd, &one, sizeof( one ) ) != sizeof( one ) )
+            fprintf( stderr, "messip_timer: unable to signal an expiration (%s)\n", strerror( errno ) );
+    }
+    queue->fired_last = timer;
+}                               // queue_fire
+
+/**
+ * Remove a timer from the expirations of its queue (the wheel lock is owned by the caller)
+ *
+ * @param timer Timer, with some expirations not received yet
+ */
+static void queue_unfire( messip_timer_t *timer ) {
+    messip_timer_queue_t *queue = timer->queue;
+    uint64_t count;
+
+    if ( timer->fired_prev != NULL )
+        timer->fired_prev->fired_next = timer->fired_next;
+    else
+        queue->fired_first = timer->fired_next;
+    if ( timer->fired_next != NULL )
+        timer->fired_next->fired_prev = timer->fired_prev;
+    else
+        queue->fired_last = timer->fired_prev;
+    timer->nb_fired = 0;
+
+    /*--- Nothing left to receive: the eventfd must not be readable anymore ---*/
+    if ( queue->fired_first == NULL )
+        if ( read( queue->eventfd, &count, sizeof( count ) ) == -1 && errno != EAGAIN )
+            fprintf( stderr, "messip_timer: unable to reset an expiration (%s)\n", strerror( errno ) );
+}                               // queue_unfire
+
+/**
+ * Move the timers of a slot of an upper level to the lower levels (the wheel lock is owned by the caller)
+ *
+ * @param level Level of the slot
+ * @param index Index of the slot
+ */
+static void wheel_cascade( int level, int index ) {
+    messip_timer_t *timer = wheel.slots[level][index];
+    messip_timer_t *next;
+
+    wheel.slots[level][index] = NULL;
+    for ( ; timer != NULL; timer = next ) {
+        next = timer->next;
+        wheel_insert( timer );
+    }
+}                               // wheel_cascade
+
+/**
+ * Process all the ticks up to the one specified (the wheel lock is owned by the caller)
+ *
+ * @param target Tick to reach
+ */
+static void wheel_advance( uint64_t target ) {
+    messip_timer_t *timer, *next;
+    int level, index;
+
+    while ( wheel.now < target ) {
+        if ( wheel.nb_armed == 0 ) {
+            wheel.now = target;
+            break;
+        }
+        wheel.now++;
+
+        /*--- Start of a new round: the timers of the next slot of the upper levels come closer ---*/
+        for ( level = 1; level < WHEEL_LEVELS; level++ ) {
+            if ( ( wheel.now >> ( WHEEL_BITS * ( level - 1 ) ) ) & WHEEL_MASK )
+                break;
+            wheel_cascade( level, ( wheel.now >> ( WHEEL_BITS * level ) ) & WHEEL_MASK );
+        }
+
+        /*--- Timers expiring now: periodic ones are inserted again ---*/
+        index = wheel.now & WHEEL_MASK;
+        timer = wheel.slots[0][index];
+        wheel.slots[0][index] = NULL;
+        for ( ; timer != NULL; timer = next ) {
+            next = timer->next;
+            timer->slot = NULL;
+            queue_fire( timer );
+            if ( timer->period ) {
+                timer->expires += timer->period;
+                wheel_insert( timer );
+            }
+            else
+                wheel.nb_armed--;
+        }
+    }                           // while
+}                               // wheel_advance
+
+/**
+ * Program the timerfd for the next tick where something has to be done: either
+ * the next expiration in the current round, or the start of the next round
+ * (the wheel lock is owned by the caller)
+ */
+static void wheel_program( void ) {
+    struct itimerspec its;
+    uint64_t tick, round_end;
+
+    if ( wheel.nb_armed == 0 )
+        tick = 0;
+    else {
+        round_end = ( wheel.now | WHEEL_MASK ) + 1;
+        for ( tick = wheel.now + 1; tick < round_end; tick++ )
+            if ( wheel.slots[0][tick & WHEEL_MASK] != NULL )
+                break;
+    }
+    if ( tick == wheel.programmed )
+        return;
+
+    memset( &its, 0, sizeof( its ) );
+    if ( tick ) {
+        its.it_value.tv_sec = ( wheel.base + tick ) / 1000;
+        its.it_value.tv_nsec = ( ( wheel.base + tick ) % 1000 ) * 1000000;
+    }
+    if ( timerfd_settime( wheel.timerfd, TFD_TIMER_ABSTIME, &its, NULL ) == 0 )
+        wheel.programmed = tick;
+}                               // wheel_program
+
+/**
+ * Process the expired timers of the process, then program the timerfd again.
+ * Called when the timerfd is readable (calling it at any time is harmless).
+ */
+void messip_timer_expire( void ) {
+    uint64_t count;
+
+    pthread_mutex_lock( &wheel.lock );
+    if ( read( wheel.timerfd, &count, sizeof( count ) ) == -1 && errno != EAGAIN )
+        fprintf( stderr, "messip_timer: unable to read the timerfd (%s)\n", strerror( errno ) );
+    wheel.programmed = 0;
+    wheel_advance( monotonic_msec(  ) - wheel.base );
+    wheel_program(  );
+    pthread_mutex_unlock( &wheel.lock );
+}                               // messip_timer_expire
+
+/**
+ * Create a timer queue, which receives the expirations of the timers of a channel
+ *
+ * @return The queue, or NULL if an error occurred (errno is set)
+ */
+messip_timer_queue_t *messip_timer_queue_create( void ) {
+    messip_timer_queue_t *queue;
+
+    if ( messip_timer_engine_fd(  ) == -1 )
+        return NULL;
+    queue = ( messip_timer_queue_t * ) malloc( sizeof( messip_timer_queue_t ) );
+    if ( queue == NULL )
+        return NULL;
+    memset( queue, 0, sizeof( messip_timer_queue_t ) );
+    queue->eventfd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    if ( queue->eventfd == -1 ) {
+        free( queue );
+        return NULL;
+    }
+    return queue;
+}                               // messip_timer_queue_create
+
+/**
+ * Stop and release a timer (the wheel lock is owned by the caller)
+ *
+ * @param timer Timer
+ */
+static void timer_release( messip_timer_t *timer ) {
+    messip_timer_queue_t *queue = timer->queue;
+
+    if ( timer->slot != NULL ) {
+        wheel_remove( timer );
+        wheel.nb_armed--;
+    }
+    if ( timer->nb_fired )
+        queue_unfire( timer );
+    if ( timer->queue_prev != NULL )
+        timer->queue_prev->queue_next = timer->queue_next;
+    else
+        queue->timers = timer->queue_next;
+    if ( timer->queue_next != NULL )
+        timer->queue_next->queue_prev = timer->queue_prev;
+    free( timer );
+}                               // timer_release
+
+/**
+ * Release a timer queue, and all its timers
+ *
+ * @param queue Queue returned by messip_timer_queue_create()
+ */
+void messip_timer_queue_destroy( messip_timer_queue_t *queue ) {
+    pthread_mutex_lock( &wheel.lock );
+    while ( queue->timers != NULL )
+        timer_release( queue->timers );
+    pthread_mutex_unlock( &wheel.lock );
+    close( queue->eventfd );
+    free( queue );
+}                               // messip_timer_queue_destroy
+
+/**
+ * Get the file descriptor which is readable while some expirations of a queue have not been received
+ *
+ * @param queue Queue returned by messip_timer_queue_create()
+ * @return The eventfd of the queue
+ */
+int messip_timer_queue_fd( messip_timer_queue_t *queue ) {
+    return queue->eventfd;
+}                               // messip_timer_queue_fd
+
+/**
+ * Get the next expiration of a queue. Timers which have expired several times
+ * are moved to the end of the queue, so that a fast timer does not starve the others.
+ *
+ * @param queue Queue returned by messip_timer_queue_create()
+ * @param type Set to the type of the timer which has expired
+ * @return 1 if an expiration has been returned, 0 if there is none
+ */
+int messip_timer_queue_pop( messip_timer_queue_t *queue, int32_t *type ) {
+    messip_timer_t *timer;
+    uint32_t nb_fired;
+
+    pthread_mutex_lock( &wheel.lock );
+    timer = queue->fired_first;
+    if ( timer == NULL ) {
+        pthread_mutex_unlock( &wheel.lock );
+        return 0;
+    }
+    *type = timer->type;
+    nb_fired = timer->nb_fired - 1;
+    queue_unfire( timer );
+    if ( nb_fired ) {
+        queue_fire( timer );
+        timer->nb_fired = nb_fired;
+    }
+    pthread_mutex_unlock( &wheel.lock );
+    return 1;
+}                               // messip_timer_queue_pop
+
+/**
+ * Start a timer. Same semantic as timer_settime(): if msec_1st_shot is 0, the
+ * timer is created but never expires.
+ *
+ * @param queue Queue which receives the expirations
+ * @param type Type returned by messip_receive() on each expiration
+ * @param msec_1st_shot Delay before the first expiration, in milliseconds
+ * @param msec_rep_shot Period of the next expirations, in milliseconds, or 0 (one-shot timer)
+ * @return The timer, or NULL if an error occurred (errno is set)
+ */
+messip_timer_t *messip_timer_start( messip_timer_queue_t *queue, int32_t type, int msec_1st_shot, int msec_rep_shot ) {
+    messip_timer_t *timer;
+
+    if ( ( msec_1st_shot < 0 ) || ( msec_rep_shot < 0 ) ) {
+        errno = EINVAL;
+        return NULL;
+    }
+    timer = ( messip_timer_t * ) malloc( sizeof( messip_timer_t ) );
+    if ( timer == NULL )
+        return NULL;
+    memset( timer, 0, sizeof( messip_timer_t ) );
+    timer->queue = queue;
+    timer->type = type;
+    timer->period = msec_rep_shot;
+
+    pthread_mutex_lock( &wheel.lock );
+    timer->queue_next = queue->timers;
+    if ( queue->timers != NULL )
+        queue->timers->queue_prev = timer;
+    queue->timers = timer;
+    if ( msec_1st_shot ) {
+
+        /*--- Catch up first, so that the expiration is relative to the current time ---*/
+        wheel_advance( monotonic_msec(  ) - wheel.base );
+        timer->expires = wheel.now + msec_1st_shot;
+        wheel_insert( timer );
+        wheel.nb_armed++;
+        wheel_program(  );
+    }
+    pthread_mutex_unlock( &wheel.lock );
+    return timer;
+}                               // messip_timer_start
+
+/**
+ * Stop and release a timer. Its expirations not received yet are discarded.
+ *
+ * @param queue Queue the timer belongs to
+ * @param timer Timer returned by messip_timer_start()
+ * @return 0 if no error, or -1 if the timer does not belong to this queue (errno is set to EINVAL)
+ */
+int messip_timer_stop( messip_timer_queue_t *queue, messip_timer_t *timer ) {
+    if ( ( timer == NULL ) || ( timer->queue != queue ) ) {
+        errno = EINVAL;
+        return -1;
+    }
+    pthread_mutex_lock( &wheel.lock );
+    timer_release( timer );
+    pthread_mutex_unlock( &wheel.lock );
+    return 0;
+}                               // messip_timer_stop
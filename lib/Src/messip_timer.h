@@ -0,0 +1,27 @@
+/**
+ * @file messip_timer.h
+ *
+ * MessIP : Message Passing over TCP/IP
+ * Copyright (C) 2001-2007  Olivier Singla
+ * http://messip.sourceforge.net/
+ *
+ **/
+
+#ifndef MESSIP_TIMER_H_
+#define MESSIP_TIMER_H_
+
+typedef struct messip_timer messip_timer_t;
+typedef struct messip_timer_queue messip_timer_queue_t;
+
+int messip_timer_engine_fd( void );
+void messip_timer_expire( void );
+
+messip_timer_queue_t *messip_timer_queue_create( void );
+void messip_timer_queue_destroy( messip_timer_queue_t *queue );
+int messip_timer_queue_fd( messip_timer_queue_t *queue );
+int messip_timer_queue_pop( messip_timer_queue_t *queue, int32_t *type );
+
+messip_timer_t *messip_timer_start( messip_timer_queue_t *queue, int32_t type, int msec_1st_shot, int msec_rep_shot );
+int messip_timer_stop( messip_timer_queue_t *queue, messip_timer_t *timer );
+
+#endif /*MESSIP_TIMER_H_*/
@@ -0,0 +1,551 @@
+/**
+ * @file messip_uring.c
+ *
+ * MessIP : Message Passing over TCP/IP
+ * Copyright (C) 2001-2007  Olivier Singla
+ * http://messip.sourceforge.net/
+ *
+ * Optional io_uring transport engine. A messip_send() is submitted as
+ * a linked write + read (+ timeout) in a single io_uring_enter(), and
+ * a messip_reply() is queued without waiting for its completion:
+ * completions are then reaped in batches, from the shared completion
+ * ring, without any additional system call.
+ *
+ * At most one queued write is in flight on a socket: any other write on
+ * it (queued or not) first waits for its completion, so that the frames
+ * are never interleaved. A queued write which fails, or which is short,
+ * shuts the socket down: the client sees a closed connection, never a
+ * truncated frame.
+ *
+ * Raw system calls are used, so that liburing is not required.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include "messip.h"
+#include "messip_private.h"
+#include "messip_uring.h"
+
+#if MESSIP_USE_IO_URING==1
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#define URING_ENTRIES		16
+#define URING_NB_STAGING	8		// Must be <= 32 (staging_busy bitmask)
+#define URING_STAGING_SZ	4096	// Replies larger than this are written synchronously
+
+enum {
+    URING_OP_WRITE = 1,
+    URING_OP_READ,
+    URING_OP_TIMEOUT,
+    URING_OP_STAGING = 0x100    // + index of the staging buffer
+};
+
+struct messip_uring {
+    int ring_fd;
+    unsigned sq_entries;
+    unsigned sq_mask;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned cq_mask;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *rings;                // SQ and CQ rings (IORING_FEAT_SINGLE_MMAP)
+    size_t rings_sz;
+    size_t sqes_sz;
+    unsigned sqe_tail;          // SQEs prepared, submitted up to *sq_tail
+    uint32_t staging_busy;      // Staging buffers owned by an in-flight write
+    int staging_len[URING_NB_STAGING];
+    SOCKET staging_fd[URING_NB_STAGING];    // Socket written from each of them, or -1 (closed since)
+    char *staging;              // URING_NB_STAGING buffers of URING_STAGING_SZ bytes
+};
+
+/**
+ * Create an io_uring instance
+ *
+ * @return A pointer to the ring, or NULL if io_uring is not available on this system
+ *    (errno is then set).
+ */
+messip_uring_t *messip_uring_create( void ) {
+    struct io_uring_params params;
+    messip_uring_t *ring;
+
+    ring = ( messip_uring_t * ) malloc( sizeof( messip_uring_t ) );
+    if ( ring == NULL )
+        return NULL;
+    memset( ring, 0, sizeof( messip_uring_t ) );
+
+    memset( &params, 0, sizeof( params ) );
+    ring->ring_fd = syscall( __NR_io_uring_setup, URING_ENTRIES, &params );
+    if ( ring->ring_fd < 0 ) {
+        free( ring );
+        return NULL;
+    }
+    if ( !( params.features & IORING_FEAT_SINGLE_MMAP ) || !( params.features & IORING_FEAT_NODROP ) ) {
+        close( ring->ring_fd );
+        free( ring );
+        errno = ENOSYS;
+        return NULL;
+    }
+
+    /*--- Map the submission and completion rings, then the SQE array ---*/
+    ring->rings_sz = params.sq_off.array + params.sq_entries * sizeof( unsigned );
+    if ( params.cq_off.cqes + params.cq_entries * sizeof( struct io_uring_cqe ) > ring->rings_sz )
+        ring->rings_sz = params.cq_off.cqes + params.cq_entries * sizeof( struct io_uring_cqe );
+    ring->rings = mmap( NULL, ring->rings_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+       ring->ring_fd, IORING_OFF_SQ_RING );
+    if ( ring->rings == MAP_FAILED ) {
+        close( ring->ring_fd );
+        free( ring );
+        return NULL;
+    }
+    ring->sqes_sz = params.sq_entries * sizeof( struct io_uring_sqe );
+    ring->sqes = mmap( NULL, ring->sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+       ring->ring_fd, IORING_OFF_SQES );
+    if ( ring->sqes == MAP_FAILED ) {
+        munmap( ring->rings, ring->rings_sz );
+        close( ring->ring_fd );
+        free( ring );
+        return NULL;
+    }
+
+    char *p = ( char * ) ring->rings;
+    ring->sq_entries = params.sq_entries;
+    ring->sq_mask = *( unsigned * ) ( p + params.sq_off.ring_mask );
+    ring->sq_head = ( unsigned * ) ( p + params.sq_off.head );
+    ring->sq_tail = ( unsigned * ) ( p + params.sq_off.tail );
+    ring->sq_array = ( unsigned * ) ( p + params.sq_off.array );
+    ring->cq_mask = *( unsigned * ) ( p + params.cq_off.ring_mask );
+    ring->cq_head = ( unsigned * ) ( p + params.cq_off.head );
+    ring->cq_tail = ( unsigned * ) ( p + params.cq_off.tail );
+    ring->cqes = ( struct io_uring_cqe * ) ( p + params.cq_off.cqes );
+    ring->sqe_tail = *ring->sq_tail;
+
+    ring->staging = ( char * ) malloc( URING_NB_STAGING * URING_STAGING_SZ );
+    if ( ring->staging == NULL ) {
+        messip_uring_destroy( ring );
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    return ring;
+}                               // messip_uring_create
+
+/**
+ * Release an io_uring instance. Writes still in-flight are cancelled.
+ *
+ * @param ring Ring returned by messip_uring_create()
+ */
+void messip_uring_destroy( messip_uring_t *ring ) {
+    munmap( ring->sqes, ring->sqes_sz );
+    munmap( ring->rings, ring->rings_sz );
+    close( ring->ring_fd );
+    free( ring->staging );
+    free( ring );
+}                               // messip_uring_destroy
+
+/**
+ * Get a free submission entry
+ *
+ * @param ring Ring returned by messip_uring_create()
+ * @return The SQE (zeroed), or NULL if the submission ring is full
+ */
+static struct io_uring_sqe *uring_get_sqe( messip_uring_t *ring ) {
+    unsigned head = __atomic_load_n( ring->sq_head, __ATOMIC_ACQUIRE );
+    if ( ring->sqe_tail - head >= ring->sq_entries )
+        return NULL;
+    unsigned index = ring->sqe_tail & ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    ring->sq_array[index] = index;
+    ring->sqe_tail++;
+    memset( sqe, 0, sizeof( struct io_uring_sqe ) );
+    return sqe;
+}                               // uring_get_sqe
+
+/**
+ * Submit the prepared entries, then optionally wait for completions.
+ * This function handles EINTR.
+ *
+ * @param ring Ring returned by messip_uring_create()
+ * @param wait_nr Minimum number of completions to wait for (0: do not wait)
+ * @return 0 if no error, or -1 if an error occurred (errno is set)
+ */
+static int uring_enter( messip_uring_t *ring, unsigned wait_nr ) {
+    unsigned to_submit = ring->sqe_tail - *ring->sq_tail;
+    int status;
+
+    __atomic_store_n( ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE );
+    for ( ;; ) {
+        status = syscall( __NR_io_uring_enter, ring->ring_fd, to_submit, wait_nr,
+           ( wait_nr ) ? IORING_ENTER_GETEVENTS : 0, NULL, 0 );
+        if ( status >= 0 ) {
+            to_submit -= status;
+            if ( !to_submit )
+                return 0;
+            continue;
+        }
+        if ( errno == EINTR ) {
+            if ( !to_submit )
+                return 0;       // The caller checks its completions, then waits again if needed
+            continue;
+        }
+        return -1;
+    }                           // for (;;)
+}                               // uring_enter
+
+/**
+ * Consume one completion, if any. Completions of staging writes release their buffer.
+ *
+ * @param ring Ring returned by messip_uring_create()
+ * @param user_data Set to the tag of the operation completed
+ * @param res Set to the result of the operation completed
+ * @return 1 if a completion has been consumed, 0 if the completion ring is empty
+ */
+static int uring_next_cqe( messip_uring_t *ring, uint64_t *user_data, int *res ) {
+    unsigned head = *ring->cq_head;
+    if ( head == __atomic_load_n( ring->cq_tail, __ATOMIC_ACQUIRE ) )
+        return 0;
+    struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+    *user_data = cqe->user_data;
+    *res = cqe->res;
+    __atomic_store_n( ring->cq_head, head + 1, __ATOMIC_RELEASE );
+
+    if ( *user_data >= URING_OP_STAGING ) {
+        int index = *user_data - URING_OP_STAGING;
+        if ( *res != ring->staging_len[index] ) {
+            messip_log( MESSIP_LOG_WARNING, "messip_uring: reply write %d of %d bytes (%s)\n",
+               *res, ring->staging_len[index], ( *res < 0 ) ? strerror( -*res ) : "short write" );
+            if ( ring->staging_fd[index] != -1 )
+                shutdown( ring->staging_fd[index], SHUT_RDWR );
+        }
+        ring->staging_busy &= ~( 1U << index );
+    }
+    return 1;
+}                               // uring_next_cqe
+
+/**
+ * Reap all the completions available, without any system call.
+ *
+ * @param ring Ring returned by messip_uring_create()
+ */
+void messip_uring_reap( messip_uring_t *ring ) {
+    uint64_t user_data;
+    int res;
+    while ( uring_next_cqe( ring, &user_data, &res ) );
+}                               // messip_uring_reap
+
+/**
+ * Index of the staging buffer being written on a socket
+ *
+ * @param ring Ring returned by messip_uring_create()
+ * @param sockfd Socket file descriptor
+ * @return The index, or -1 if no queued write is in flight on this socket
+ */
+static int uring_staging_of( messip_uring_t *ring, SOCKET sockfd ) {
+    for ( int index = 0; index < URING_NB_STAGING; index++ )
+        if ( ( ring->staging_busy & ( 1U << index ) ) && ( ring->staging_fd[index] == sockfd ) )
+            return index;
+    return -1;
+}                               // uring_staging_of
+
+/**
+ * Wait until the write queued on a socket, if any, is complete: to be called before
+ * writing anything else on this socket
+ *
+ * @param ring Ring returned by messip_uring_create()
+ * @param sockfd Socket file descriptor
+ * @return 0 if no error, or -1 if the queued write failed (errno is then EPIPE), or if
+ *    an error occurred (errno is set)
+ */
+int messip_uring_sync( messip_uring_t *ring, SOCKET sockfd ) {
+    uint64_t user_data;
+    int index, res;
+
+    messip_uring_reap( ring );
+    if ( ( index = uring_staging_of( ring, sockfd ) ) == -1 )
+        return 0;
+    for ( ;; ) {
+        if ( !uring_next_cqe( ring, &user_data, &res ) ) {
+            if ( uring_enter( ring, 1 ) == -1 )
+                return -1;
+            continue;
+        }
+        if ( user_data == URING_OP_STAGING + index )
+            break;
+    }                           // for (;;)
+    if ( res != ring->staging_len[index] ) {
+        errno = EPIPE;
+        return -1;
+    }
+    return 0;
+}                               // messip_uring_sync
+
+/**
+ * A socket is about to be closed: the completion of a write queued on it
+ * must not act on another socket which would get the same descriptor
+ *
+ * @param ring Ring returned by messip_uring_create()
+ * @param sockfd Socket file descriptor
+ */
+void messip_uring_forget( messip_uring_t *ring, SOCKET sockfd ) {
+    int index = uring_staging_of( ring, sockfd );
+
+    if ( index != -1 )
+        ring->staging_fd[index] = -1;
+}                               // messip_uring_forget
+
+/**
+ * Write the part of an iovec which has not been written yet
+ *
+ * @param sockfd Socket file descriptor
+ * @param iov Vector of buffers
+ * @param iovcnt Number of buffers
+ * @param skip Number of bytes already written
+ * @return 0 if no error, or -1 if an error occurred (errno is set)
+ */
+static int writev_remaining( SOCKET sockfd, const struct iovec *iov, int iovcnt, size_t skip ) {
+    for ( int n = 0; n < iovcnt; n++ ) {
+        if ( skip >= iov[n].iov_len ) {
+            skip -= iov[n].iov_len;
+            continue;
+        }
+        struct iovec rem;
+        rem.iov_base = ( char * ) iov[n].iov_base + skip;
+        rem.iov_len = iov[n].iov_len - skip;
+        skip = 0;
+        while ( rem.iov_len > 0 ) {
+            int dcount = messip_writev( sockfd, &rem, 1 );
+            if ( dcount <= 0 )
+                return -1;
+            rem.iov_base = ( char * ) rem.iov_base + dcount;
+            rem.iov_len -= dcount;
+        }
+    }
+    return 0;
+}                               // writev_remaining
+
+/**
+ * Write a request, then read the beginning of the answer, using a single system call
+ * in the usual case: the write and the read are linked, and are submitted together.
+ *
+ * @param ring Ring returned by messip_uring_create()
+ * @param sockfd Socket file descriptor
+ * @param iov_out Buffers to write
+ * @param iovcnt_out Number of buffers to write
+ * @param iov_in Buffers where to read the answer
+ * @param iovcnt_in Number of buffers where to read the answer
+ * @param msec_timeout Timeout on the read, expressed in milliseconds, or MESSIP_NOTIMEOUT
+ * @return
+ *  - On success, returns the number of bytes read (might be less than requested)
+ *  - 0 if the connection has been closed
+ *  - On error, -1 is returned, and errno is set appropriately (ETIMEDOUT if the read timed out)
+ */
+int messip_uring_sendrecv( messip_uring_t *ring, SOCKET sockfd,
+   const struct iovec *iov_out, int iovcnt_out, const struct iovec *iov_in, int iovcnt_in, int msec_timeout ) {
+    struct io_uring_sqe *sqe_write, *sqe_read, *sqe_timeout = NULL;
+    struct __kernel_timespec ts;
+    int res_write = 0, res_read = 0;
+    int pending, timed_out = 0;
+    uint64_t user_data;
+    int res;
+    size_t len_out = 0;
+
+    for ( int n = 0; n < iovcnt_out; n++ )
+        len_out += iov_out[n].iov_len;
+
+    /*--- Not enough room in the submission ring: plain system calls ---*/
+    messip_uring_reap( ring );
+    unsigned head = __atomic_load_n( ring->sq_head, __ATOMIC_ACQUIRE );
+    if ( ring->sq_entries - ( ring->sqe_tail - head ) < 3 ) {
+        if ( writev_remaining( sockfd, iov_out, iovcnt_out, 0 ) == -1 )
+            return -1;
+        if ( ( msec_timeout != MESSIP_NOTIMEOUT ) && ( messip_wait_ready( sockfd, POLLIN, msec_timeout ) <= 0 ) ) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        return messip_readv( sockfd, iov_in, iovcnt_in );
+    }
+
+    /*--- Write, linked to the read (the read starts only if the write succeeded) ---*/
+    sqe_write = uring_get_sqe( ring );
+    sqe_write->opcode = IORING_OP_WRITEV;
+    sqe_write->fd = sockfd;
+    sqe_write->addr = ( uintptr_t ) iov_out;
+    sqe_write->len = iovcnt_out;
+    sqe_write->flags = IOSQE_IO_LINK;
+    sqe_write->user_data = URING_OP_WRITE;
+
+    sqe_read = uring_get_sqe( ring );
+    sqe_read->opcode = IORING_OP_READV;
+    sqe_read->fd = sockfd;
+    sqe_read->addr = ( uintptr_t ) iov_in;
+    sqe_read->len = iovcnt_in;
+    sqe_read->user_data = URING_OP_READ;
+    pending = 2;
+
+    /*--- Timeout on the read ---*/
+    if ( msec_timeout != MESSIP_NOTIMEOUT ) {
+        sqe_read->flags = IOSQE_IO_LINK;
+        ts.tv_sec = msec_timeout / 1000;
+        ts.tv_nsec = ( msec_timeout % 1000 ) * 1000000;
+        sqe_timeout = uring_get_sqe( ring );
+        sqe_timeout->opcode = IORING_OP_LINK_TIMEOUT;
+        sqe_timeout->addr = ( uintptr_t ) &ts;
+        sqe_timeout->len = 1;
+        sqe_timeout->user_data = URING_OP_TIMEOUT;
+        pending++;
+    }
+
+    /*--- Submit, then wait until all these operations are completed ---*/
+    if ( uring_enter( ring, pending ) == -1 )
+        return -1;
+    while ( pending > 0 ) {
+        if ( !uring_next_cqe( ring, &user_data, &res ) ) {
+            if ( uring_enter( ring, 1 ) == -1 )
+                return -1;
+            continue;
+        }
+        switch ( user_data ) {
+            case URING_OP_WRITE:
+                res_write = res;
+                pending--;
+                break;
+            case URING_OP_READ:
+                res_read = res;
+                pending--;
+                break;
+            case URING_OP_TIMEOUT:
+                timed_out = ( res == -ETIME );
+                pending--;
+                break;
+        }                       // switch
+    }                           // while
+
+    /*--- Write failed ---*/
+    if ( res_write < 0 ) {
+        errno = -res_write;
+        return -1;
+    }
+
+    /*--- Short write: the link has been broken, so finish the job synchronously ---*/
+    if ( ( size_t ) res_write < len_out ) {
+        if ( writev_remaining( sockfd, iov_out, iovcnt_out, res_write ) == -1 )
+            return -1;
+        if ( ( msec_timeout != MESSIP_NOTIMEOUT ) && ( messip_wait_ready( sockfd, POLLIN, msec_timeout ) <= 0 ) ) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        return messip_readv( sockfd, iov_in, iovcnt_in );
+    }
+
+    /*--- Read cancelled by the timeout, or failed ---*/
+    if ( res_read < 0 ) {
+        errno = ( timed_out && ( res_read == -ECANCELED ) ) ? ETIMEDOUT : -res_read;
+        return -1;
+    }
+    return res_read;
+}                               // messip_uring_sendrecv
+
+/**
+ * Queue a write, without waiting for its completion. The data are copied,
+ * so the caller can reuse its buffers as soon as this function returns.
+ * The completion will be reaped later, along with other completions.
+ *
+ * If the data are too large, or if there is no staging buffer left, the
+ * data are written synchronously (messip_writev). In any case, a write
+ * still in flight on the socket is waited for first.
+ *
+ * @param ring Ring returned by messip_uring_create()
+ * @param sockfd Socket file descriptor
+ * @param iov Buffers to write
+ * @param iovcnt Number of buffers
+ * @return The number of bytes written (or queued), or -1 if an error occurred (errno is set)
+ */
+int messip_uring_writev( messip_uring_t *ring, SOCKET sockfd, const struct iovec *iov, int iovcnt ) {
+    struct io_uring_sqe *sqe;
+    int index, len = 0;
+
+    for ( int n = 0; n < iovcnt; n++ )
+        len += iov[n].iov_len;
+
+    if ( messip_uring_sync( ring, sockfd ) == -1 )
+        return -1;
+    for ( index = 0; index < URING_NB_STAGING; index++ )
+        if ( !( ring->staging_busy & ( 1U << index ) ) )
+            break;
+    if ( ( len > URING_STAGING_SZ ) || ( index == URING_NB_STAGING ) || ( ( sqe = uring_get_sqe( ring ) ) == NULL ) )
+        return messip_writev( sockfd, iov, iovcnt );
+
+    /*--- Copy into a staging buffer owned by the ring ---*/
+    char *p = &ring->staging[index * URING_STAGING_SZ];
+    for ( int n = 0, off = 0; n < iovcnt; off += iov[n].iov_len, n++ )
+        memcpy( p + off, iov[n].iov_base, iov[n].iov_len );
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = sockfd;
+    sqe->addr = ( uintptr_t ) p;
+    sqe->len = len;
+    sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+    sqe->user_data = URING_OP_STAGING + index;
+    if ( uring_enter( ring, 0 ) == -1 ) {
+
+        /*--- Not submitted: take the entry back, and write synchronously ---*/
+        if ( __atomic_load_n( ring->sq_head, __ATOMIC_ACQUIRE ) != ring->sqe_tail ) {
+            ring->sqe_tail--;
+            __atomic_store_n( ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE );
+            return messip_writev( sockfd, iov, iovcnt );
+        }
+    }
+    ring->staging_busy |= 1U << index;
+    ring->staging_len[index] = len;
+    ring->staging_fd[index] = sockfd;
+
+    return len;
+}                               // messip_uring_writev
+
+#else
+
+/*
+ * io_uring support not compiled: messip_uring_create() always fails,
+ * so that the library falls back to the plain socket calls.
+ */
+
+messip_uring_t *messip_uring_create( void ) {
+    errno = ENOSYS;
+    return NULL;
+}                               // messip_uring_create
+
+void messip_uring_destroy( messip_uring_t *ring ) {
+}                               // messip_uring_destroy
+
+int messip_uring_sendrecv( messip_uring_t *ring, SOCKET sockfd,
+   const struct iovec *iov_out, int iovcnt_out, const struct iovec *iov_in, int iovcnt_in, int msec_timeout ) {
+    errno = ENOSYS;
+    return -1;
+}                               // messip_uring_sendrecv
+
+int messip_uring_writev( messip_uring_t *ring, SOCKET sockfd, const struct iovec *iov, int iovcnt ) {
+    return messip_writev( sockfd, iov, iovcnt );
+}                               // messip_uring_writev
+
+int messip_uring_sync( messip_uring_t *ring, SOCKET sockfd ) {
+    return 0;
+}                               // messip_uring_sync
+
+void messip_uring_forget( messip_uring_t *ring, SOCKET sockfd ) {
+}                               // messip_uring_forget
+
+void messip_uring_reap( messip_uring_t *ring ) {
+}                               // messip_uring_reap
+
+#endif
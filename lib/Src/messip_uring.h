@@ -0,0 +1,31 @@
+/**
+ * @file messip_uring.h
+ *
+ * MessIP : Message Passing over TCP/IP
+ * Copyright (C) 2001-2007  Olivier Singla
+ * http://messip.sourceforge.net/
+ *
+ **/
+
+#ifndef MESSIP_URING_H_
+#define MESSIP_URING_H_
+
+#include <sys/uio.h>
+
+#ifndef MESSIP_USE_IO_URING
+#define MESSIP_USE_IO_URING 0
+#endif
+
+typedef struct messip_uring messip_uring_t;
+
+messip_uring_t *messip_uring_create( void );
+void messip_uring_destroy( messip_uring_t *ring );
+
+int messip_uring_sendrecv( messip_uring_t *ring, SOCKET sockfd,
+   const struct iovec *iov_out, int iovcnt_out, const struct iovec *iov_in, int iovcnt_in, int msec_timeout );
+int messip_uring_writev( messip_uring_t *ring, SOCKET sockfd, const struct iovec *iov, int iovcnt );
+int messip_uring_sync( messip_uring_t *ring, SOCKET sockfd );
+void messip_uring_forget( messip_uring_t *ring, SOCKET sockfd );
+void messip_uring_reap( messip_uring_t *ring );
+
+#endif /*MESSIP_URING_H_*/
@@ -15,6 +15,7 @@
 #include <errno.h>
 #include <stdarg.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <signal.h>
 #include <assert.h>
 #include <unistd.h>
@@ -25,6 +26,8 @@
 #include <netdb.h>
 
 #include "messip.h"
+#include "messip_private.h"
+#include "messip_utils.h"
 
 int read_etc_messip( char *hostname, int *port_used, int *port_http_used ) {
     char line[512], host[80], path[80];
@@ -132,3 +135,185 @@ float get_cpu_clock_speed( void ) {
         speed = cpu_clock_speed(  ) * 1000;
     return speed;
 }                               // get_cpu_clock_speed
+
+
+/* Returns an identifier of the host this process runs on: the boot id
+  of the kernel (/proc/sys/kernel/random/boot_id), or the host name if
+  it is not available, followed by the inode of the network namespace.
+  Abstract AF_UNIX sockets are private to a network namespace, so two
+  processes reporting the same identifier can talk over an AF_UNIX
+  socket instead of TCP/IP. */
+
+const char *get_host_ident( void ) {
+    static char ident[MESSIP_HOST_IDENT_MAXLEN];
+    struct stat st;
+    size_t len;
+    FILE *fp;
+
+    if ( ident[0] )
+        return ident;
+    fp = fopen( "/proc/sys/kernel/random/boot_id", "r" );
+    if ( fp != NULL ) {
+        if ( fgets( ident, sizeof( ident ), fp ) == NULL )
+            ident[0] = 0;
+        fclose( fp );
+        ident[strcspn( ident, "\n" )] = 0;
+    }
+    if ( !ident[0] ) {
+        gethostname( ident, sizeof( ident ) - 1 );
+        ident[sizeof( ident ) - 1] = 0;
+    }
+    if ( stat( "/proc/self/ns/net", &st ) == 0 ) {
+        len = strlen( ident );
+        snprintf( ident + len, sizeof( ident ) - len, ":%lu", ( unsigned long ) st.st_ino );
+    }
+    return ident;
+}                               // get_host_ident
+
+
+/* Hash table of strings (names of channels...): open addressing with
+  linear probing, FNV-1a hash. The table doubles when it is 3/4 full,
+  and deletions shift back the following entries (no tombstones).
+  Keys are not copied: they must remain valid while in the table. */
+
+typedef struct {
+    const char *key;            // NULL if the entry is free
+    void *value;
+    uint32_t hash;
+} hash_entry_t;
+
+struct messip_hash {
+    hash_entry_t *entries;
+    uint32_t mask;              // Number of entries - 1 (a power of 2)
+    uint32_t count;
+};
+
+static uint32_t hash_fnv1a( const char *key ) {
+    uint32_t h = 2166136261u;
+    while ( *key ) {
+        h ^= ( unsigned char ) *key++;
+        h *= 16777619u;
+    }
+    return h;
+}                               // hash_fnv1a
+
+messip_hash_t *messip_hash_create( int size_hint ) {
+    messip_hash_t *h;
+    uint32_t size = 16;
+
+    while ( size * 3 / 4 < ( uint32_t ) size_hint )
+        size *= 2;
+    h = ( messip_hash_t * ) malloc( sizeof( messip_hash_t ) );
+    if ( h == NULL )
+        return NULL;
+    h->entries = ( hash_entry_t * ) calloc( size, sizeof( hash_entry_t ) );
+    if ( h->entries == NULL ) {
+        free( h );
+        return NULL;
+    }
+    h->mask = size - 1;
+    h->count = 0;
+    return h;
+}                               // messip_hash_create
+
+void messip_hash_destroy( messip_hash_t *h ) {
+    if ( h == NULL )
+        return;
+    free( h->entries );
+    free( h );
+}                               // messip_hash_destroy
+
+/* Index of the entry holding key, or of the free entry where to insert it */
+
+static uint32_t hash_lookup( messip_hash_t *h, const char *key, uint32_t hash ) {
+    uint32_t i = hash & h->mask;
+    while ( h->entries[i].key != NULL ) {
+        if ( ( h->entries[i].hash == hash ) && !strcmp( h->entries[i].key, key ) )
+            break;
+        i = ( i + 1 ) & h->mask;
+    }
+    return i;
+}                               // hash_lookup
+
+void *messip_hash_get( messip_hash_t *h, const char *key ) {
+    uint32_t i;
+
+    if ( h == NULL )
+        return NULL;
+    i = hash_lookup( h, key, hash_fnv1a( key ) );
+    return h->entries[i].value;
+}                               // messip_hash_get
+
+static int hash_grow( messip_hash_t *h ) {
+    hash_entry_t *old = h->entries;
+    uint32_t old_size = h->mask + 1, i, j;
+
+    h->entries = ( hash_entry_t * ) calloc( old_size * 2, sizeof( hash_entry_t ) );
+    if ( h->entries == NULL ) {
+        h->entries = old;
+        return -1;
+    }
+    h->mask = old_size * 2 - 1;
+    for ( i = 0; i < old_size; i++ ) {
+        if ( old[i].key == NULL )
+            continue;
+        for ( j = old[i].hash & h->mask; h->entries[j].key != NULL; j = ( j + 1 ) & h->mask );
+        h->entries[j] = old[i];
+    }
+    free( old );
+    return 0;
+}                               // hash_grow
+
+/* Insert (or replace) the value of key. Returns 0, or -1 if out of memory */
+
+int messip_hash_put( messip_hash_t *h, const char *key, void *value ) {
+    uint32_t hash = hash_fnv1a( key ), i;
+
+    i = hash_lookup( h, key, hash );
+    if ( h->entries[i].key != NULL ) {
+        h->entries[i].key = key;
+        h->entries[i].value = value;
+        return 0;
+    }
+    if ( ( h->count + 1 ) > ( h->mask + 1 ) * 3 / 4 ) {
+        if ( hash_grow( h ) == -1 )
+            return -1;
+        i = hash_lookup( h, key, hash );
+    }
+    h->entries[i].key = key;
+    h->entries[i].value = value;
+    h->entries[i].hash = hash;
+    h->count++;
+    return 0;
+}                               // messip_hash_put
+
+/* Remove key. Returns its value, or NULL if it was not in the table */
+
+void *messip_hash_remove( messip_hash_t *h, const char *key ) {
+    uint32_t i, j, k;
+    void *value;
+
+    if ( h == NULL )
+        return NULL;
+    i = hash_lookup( h, key, hash_fnv1a( key ) );
+    if ( h->entries[i].key == NULL )
+        return NULL;
+    value = h->entries[i].value;
+
+    /*--- Shift back the entries which could not be stored at their place ---*/
+    for ( j = ( i + 1 ) & h->mask; h->entries[j].key != NULL; j = ( j + 1 ) & h->mask ) {
+        k = h->entries[j].hash & h->mask;
+        if ( ( ( j > i ) && ( ( k <= i ) || ( k > j ) ) ) || ( ( j < i ) && ( k <= i ) && ( k > j ) ) ) {
+            h->entries[i] = h->entries[j];
+            i = j;
+        }
+    }
+    h->entries[i].key = NULL;
+    h->entries[i].value = NULL;
+    h->count--;
+    return value;
+}                               // messip_hash_remove
+
+int messip_hash_count( messip_hash_t *h ) {
+    return ( h != NULL ) ? ( int ) h->count : 0;
+}                               // messip_hash_count
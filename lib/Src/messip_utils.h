@@ -11,5 +11,15 @@
 #define MESSIP_UTILS_H_
 
 int read_etc_messip( char *hostname, int *port_used, int *port_http_used );
+const char *get_host_ident( void );
+
+typedef struct messip_hash messip_hash_t;
+
+messip_hash_t *messip_hash_create( int size_hint );
+void messip_hash_destroy( messip_hash_t *h );
+void *messip_hash_get( messip_hash_t *h, const char *key );
+int messip_hash_put( messip_hash_t *h, const char *key, void *value );
+void *messip_hash_remove( messip_hash_t *h, const char *key );
+int messip_hash_count( messip_hash_t *h );
 
 #endif /*MESSIP_UTILS_H_*/
@@ -0,0 +1,206 @@
+/**
+ * @file messip_wire.c
+ *
+ * MessIP : Message Passing over TCP/IP
+ * Copyright (C) 2001-2007  Olivier Singla
+ * http://messip.sourceforge.net/
+ *
+ * Headers of the messages on the sockets.
+ *
+ * The legacy headers are messip_datasend_t and messip_datareply_t, written
+ * as they are in memory (the id of the sender, as a string, in each one).
+ * The compact headers have a fixed little-endian layout, with a version
+ * byte first: 16 bytes instead of 24 and 20. Only they carry the request
+ * id of an asynchronous send: with the legacy ones, the replies are matched
+ * to the sends in order.
+ *
+ * A client offers the compact header before its first send, with a ping
+ * whose type is MESSIP_WIRE_OFFER: this is the first exchange on the
+ * connection. A server which understands it gives a number to the id of
+ * the client, and sends it back in a compact reply: the client then uses
+ * it in all its headers. Any other server (even one older than the compact
+ * header, for which this is a mere ping) replies with a legacy header.
+ * The server always replies in the format of the message.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <endian.h>
+#include <pthread.h>
+
+#include "messip.h"
+#include "messip_private.h"
+#include "messip_utils.h"
+#include "messip_wire.h"
+
+#define IDS_SHIFT		8		// Ids per chunk: 256
+#define IDS_NB_CHUNKS	( ( MESSIP_WIRE_MAX_SENDERS >> IDS_SHIFT ) + 1 )
+
+/*
+ * Ids of the senders known by a server channel, by number. Chunks are never moved,
+ * so that an id can be looked up while another one is added.
+ */
+struct messip_wire_ids {
+    pthread_mutex_t mutex;      // Serializes messip_wire_ids_intern()
+    messip_hash_t *numbers;     // Number of each id (+1)
+    messip_id_t *chunks[IDS_NB_CHUNKS];
+    int32_t nb;
+};
+
+/**
+ * Write the header of a message
+ *
+ * @param wire Where to write it (at least sizeof( messip_datasend_t ) bytes)
+ * @param datasend Header
+ * @param version MESSIP_WIRE_V2, or MESSIP_WIRE_LEGACY
+ * @param sender Number of the client (MESSIP_WIRE_V2)
+ * @param reqid Request id of an asynchronous send, or 0 (MESSIP_WIRE_V2)
+ * @return Number of bytes written
+ */
+size_t messip_wire_send_encode( void *wire, const messip_datasend_t *datasend, int version, int sender, uint32_t reqid ) {
+    messip_wire_send_t *hdr = ( messip_wire_send_t * ) wire;
+
+    if ( version != MESSIP_WIRE_V2 ) {
+        memcpy( wire, datasend, sizeof( messip_datasend_t ) );
+        return sizeof( messip_datasend_t );
+    }
+    hdr->version = MESSIP_WIRE_V2;
+    hdr->flag = ( uint8_t ) datasend->flag;
+    hdr->sender = htole16( ( uint16_t ) sender );
+    hdr->type = ( int32_t ) htole32( ( uint32_t ) datasend->type );
+    hdr->datalen = ( int32_t ) htole32( ( uint32_t ) datasend->datalen );
+    hdr->reqid = htole32( reqid );
+    return sizeof( messip_wire_send_t );
+}                               // messip_wire_send_encode
+
+/**
+ * Read a compact header of a message (the id of the sender is not set)
+ *
+ * @param datasend Header
+ * @param reqid Set to the request id
+ * @param wire Compact header, as read
+ * @return Number of the sender
+ */
+int messip_wire_send_decode( messip_datasend_t *datasend, uint32_t *reqid, const void *wire ) {
+    const messip_wire_send_t *hdr = ( const messip_wire_send_t * ) wire;
+
+    datasend->flag = hdr->flag;
+    datasend->type = ( int32_t ) le32toh( ( uint32_t ) hdr->type );
+    datasend->datalen = ( int32_t ) le32toh( ( uint32_t ) hdr->datalen );
+    *reqid = le32toh( hdr->reqid );
+    return le16toh( hdr->sender );
+}                               // messip_wire_send_decode
+
+/**
+ * Write the header of a reply
+ *
+ * @param wire Where to write it (at least sizeof( messip_datareply_t ) bytes)
+ * @param datareply Header
+ * @param version MESSIP_WIRE_V2, or MESSIP_WIRE_LEGACY
+ * @param sender Number of the client replied to (MESSIP_WIRE_V2)
+ * @param reqid Request id of the message replied to (MESSIP_WIRE_V2)
+ * @return Number of bytes written
+ */
+size_t messip_wire_reply_encode( void *wire, const messip_datareply_t *datareply, int version, int sender, uint32_t reqid ) {
+    messip_wire_reply_t *hdr = ( messip_wire_reply_t * ) wire;
+
+    if ( version != MESSIP_WIRE_V2 ) {
+        memcpy( wire, datareply, sizeof( messip_datareply_t ) );
+        return sizeof( messip_datareply_t );
+    }
+    hdr->version = MESSIP_WIRE_V2;
+    hdr->flag = 0;
+    hdr->sender = htole16( ( uint16_t ) sender );
+    hdr->answer = ( int32_t ) htole32( ( uint32_t ) datareply->answer );
+    hdr->datalen = ( int32_t ) htole32( ( uint32_t ) datareply->datalen );
+    hdr->reqid = htole32( reqid );
+    return sizeof( messip_wire_reply_t );
+}                               // messip_wire_reply_encode
+
+/**
+ * Read a compact header of a reply (the id of the server is not set: the client knows it)
+ *
+ * @param datareply Header
+ * @param reqid Set to the request id
+ * @param wire Compact header, as read
+ * @return Number of the client replied to
+ */
+int messip_wire_reply_decode( messip_datareply_t *datareply, uint32_t *reqid, const void *wire ) {
+    const messip_wire_reply_t *hdr = ( const messip_wire_reply_t * ) wire;
+
+    datareply->answer = ( int32_t ) le32toh( ( uint32_t ) hdr->answer );
+    datareply->datalen = ( int32_t ) le32toh( ( uint32_t ) hdr->datalen );
+    *reqid = le32toh( hdr->reqid );
+    return le16toh( hdr->sender );
+}                               // messip_wire_reply_decode
+
+/**
+ * Create an empty table of senders
+ *
+ * @return The table, or NULL if an error occurred (errno is set)
+ */
+messip_wire_ids_t *messip_wire_ids_create( void ) {
+    messip_wire_ids_t *ids = ( messip_wire_ids_t * ) calloc( 1, sizeof( messip_wire_ids_t ) );
+
+    if ( ids == NULL ) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    ids->numbers = messip_hash_create( 0 );
+    if ( ids->numbers == NULL ) {
+        free( ids );
+        errno = ENOMEM;
+        return NULL;
+    }
+    pthread_mutex_init( &ids->mutex, NULL );
+    return ids;
+}                               // messip_wire_ids_create
+
+/**
+ * Number of a sender, given the first time its id is seen
+ *
+ * @param ids Table returned by messip_wire_ids_create()
+ * @param id Id of the sender
+ * @return The number, or -1 if the table is full (the sender then keeps the legacy header)
+ */
+int messip_wire_ids_intern( messip_wire_ids_t *ids, const char *id ) {
+    messip_id_t *chunk;
+    void *number;
+    int sender = -1;
+
+    pthread_mutex_lock( &ids->mutex );
+    number = messip_hash_get( ids->numbers, id );
+    if ( number != NULL )
+        sender = ( int ) ( intptr_t ) number - 1;
+    else if ( ids->nb < MESSIP_WIRE_MAX_SENDERS ) {
+        chunk = ids->chunks[ids->nb >> IDS_SHIFT];
+        if ( chunk == NULL )
+            chunk = ids->chunks[ids->nb >> IDS_SHIFT] = ( messip_id_t * ) malloc( sizeof( messip_id_t ) << IDS_SHIFT );
+        if ( chunk != NULL ) {
+            IDCPY( chunk[ids->nb & ( ( 1 << IDS_SHIFT ) - 1 )], id );
+            if ( messip_hash_put( ids->numbers, chunk[ids->nb & ( ( 1 << IDS_SHIFT ) - 1 )],
+                  ( void * ) ( intptr_t ) ( ids->nb + 1 ) ) == 0 ) {
+                sender = ids->nb;
+                __atomic_store_n( &ids->nb, ids->nb + 1, __ATOMIC_RELEASE );
+            }
+        }
+    }
+    pthread_mutex_unlock( &ids->mutex );
+    return sender;
+}                               // messip_wire_ids_intern
+
+/**
+ * Id of a sender
+ *
+ * @param ids Table returned by messip_wire_ids_create()
+ * @param sender Number returned by messip_wire_ids_intern()
+ * @return The id, or NULL if the number is unknown
+ */
+const char *messip_wire_ids_lookup( messip_wire_ids_t *ids, int sender ) {
+    if ( ( ids == NULL ) || ( sender < 0 ) || ( sender >= __atomic_load_n( &ids->nb, __ATOMIC_ACQUIRE ) ) )
+        return NULL;
+    return ids->chunks[sender >> IDS_SHIFT][sender & ( ( 1 << IDS_SHIFT ) - 1 )];
+}                               // messip_wire_ids_lookup
@@ -0,0 +1,59 @@
+/**
+ * @file messip_wire.h
+ *
+ * MessIP : Message Passing over TCP/IP
+ * Copyright (C) 2001-2007  Olivier Singla
+ * http://messip.sourceforge.net/
+ *
+ **/
+
+#ifndef MESSIP_WIRE_H_
+#define MESSIP_WIRE_H_
+
+/*--- messip_channel_t.wire_version, on a client ---*/
+#define MESSIP_WIRE_UNKNOWN		0	// Not negotiated yet: the first send offers the compact header
+#define MESSIP_WIRE_LEGACY		1	// messip_datasend_t / messip_datareply_t, as they are in memory
+#define MESSIP_WIRE_OFFERED		2	// Offered: the format of the reply tells the answer of the server
+#define MESSIP_WIRE_V2			0xF2	// Compact header: first byte of the header (never a legacy one)
+
+#define MESSIP_WIRE_MAX_SENDERS	65535	// Senders numbered by a server
+
+#define MESSIP_WIRE_OFFER		0x57495245	// Type of the ping which offers the compact header ("WIRE")
+
+// Header to reply with, given the number of the sender of the message (-1: legacy header)
+#define MESSIP_WIRE_OF( sender )	( ( ( sender ) >= 0 ) ? MESSIP_WIRE_V2 : MESSIP_WIRE_LEGACY )
+
+/*
+ * Compact headers: fixed size, little-endian. The id of the sender is given once, when
+ * the compact header is negotiated: the server then numbers it.
+ */
+typedef struct {
+    uint8_t version;            // MESSIP_WIRE_V2
+    uint8_t flag;
+    uint16_t sender;            // Number given by the server to the client
+    int32_t type;
+    int32_t datalen;
+    uint32_t reqid;             // Request id of an asynchronous send, sent back in the reply (0: synchronous send)
+} messip_wire_send_t;
+
+typedef struct {
+    uint8_t version;            // MESSIP_WIRE_V2
+    uint8_t flag;               // Always 0
+    uint16_t sender;            // Number of the client replied to (given to it by the first compact reply)
+    int32_t answer;
+    int32_t datalen;
+    uint32_t reqid;             // Request id of the message replied to
+} messip_wire_reply_t;
+
+typedef struct messip_wire_ids messip_wire_ids_t;
+
+size_t messip_wire_send_encode( void *wire, const messip_datasend_t *datasend, int version, int sender, uint32_t reqid );
+int messip_wire_send_decode( messip_datasend_t *datasend, uint32_t *reqid, const void *wire );
+size_t messip_wire_reply_encode( void *wire, const messip_datareply_t *datareply, int version, int sender, uint32_t reqid );
+int messip_wire_reply_decode( messip_datareply_t *datareply, uint32_t *reqid, const void *wire );
+
+messip_wire_ids_t *messip_wire_ids_create( void );
+int messip_wire_ids_intern( messip_wire_ids_t *ids, const char *id );
+const char *messip_wire_ids_lookup( messip_wire_ids_t *ids, int sender );
+
+#endif /*MESSIP_WIRE_H_*/
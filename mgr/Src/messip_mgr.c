@@ -27,6 +27,7 @@
 #include <fcntl.h>
 #include <assert.h>
 #include <endian.h>
+#include <sys/epoll.h>
 
 #include "messip.h"
 #include "messip_private.h"
@@ -36,12 +37,33 @@
 #include "logg_messip.h"
 
 
-static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+/*
+	The tables of connexions and of channels are protected by a
+	reader-writer lock: looking up a channel only takes it for reading.
+	Each channel has its own mutex, for its buffered messages. The lists
+	of clients of the channels (and of channels of the connexions) are
+	changed under membership_mutex, or with registry_lock held for
+	writing. Always take registry_lock before any other lock.
+*/
+static pthread_rwlock_t registry_lock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t membership_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-#define	LOCK \
-	pthread_mutex_lock( &mutex )
+#define	RDLOCK \
+	pthread_rwlock_rdlock( &registry_lock )
+#define	WRLOCK \
+	pthread_rwlock_wrlock( &registry_lock )
 #define	UNLOCK \
-	pthread_mutex_unlock( &mutex )
+	pthread_rwlock_unlock( &registry_lock )
+
+#define	MEMBERSHIP_LOCK \
+	pthread_mutex_lock( &membership_mutex )
+#define	MEMBERSHIP_UNLOCK \
+	pthread_mutex_unlock( &membership_mutex )
+
+#define	CH_LOCK( ch ) \
+	pthread_mutex_lock( &( ch )->lock )
+#define	CH_UNLOCK( ch ) \
+	pthread_mutex_unlock( &( ch )->lock )
 
 
 /*
@@ -55,6 +77,43 @@ typedef struct buffered_msg_t {
     int32_t datalen;
 } buffered_msg_t;
 
+#define BUFFERED_MSG_MINSIZE	16	// Initial size of the ring of buffered messages...
+#define BUFFERED_MSG_MAXINIT	4096	// ...grown up to maxnb_msg_buffered, within this limit
+#define BUFFERED_MSG_WINDOW		64	// Messages sent to the server and not acknowledged yet
+
+/*
+	Batch of buffered messages being written to a server: the socket does
+	not block, so a batch only partly written is resumed once it is writable
+*/
+typedef struct {
+    messip_datasend_t connecting;   // Written first on a new connection
+    messip_datasend_t datasend[BUFFERED_MSG_WINDOW];
+    int32_t len;                // Maximum length of the reply: none
+    struct iovec iovec[3 * BUFFERED_MSG_WINDOW];
+    int first;                  // First segment not completely written...
+    int iovcnt;                 // ...out of this number of segments
+} delivery_batch_t;
+
+/*
+	Death of a client, notified to the server of a channel: the connection
+	is not waited for, the messages are written by a delivery worker
+*/
+typedef struct {
+    int sockfd;
+    messip_datasend_t datasend[2];  // Fake connection message, then the notification
+    int32_t sent;               // Bytes written so far
+} death_notice_t;
+
+/*
+	Connection of a client to a channel: it is both in the list of the
+	clients of the channel, and in the list of the channels of the
+	connexion. Each entry knows where the other one is.
+*/
+typedef struct {
+    struct channel_t *ch;
+    int index;                  // In ch->clients[]
+} cnx_channel_t;
+
 /*
 	List of active connexions (nodes)
 */
@@ -64,8 +123,13 @@ typedef struct {
     char process_name[MESSIP_CHANNEL_NAME_MAXLEN + 1];
     struct sockaddr_in xclient_addr;
     int sockfd;
-    int nb_cnx_channels;
-    int *sockfd_cnx_channels;
+    int index;                  // In connexions[]
+    int nb_cnx_channels;        // Channels this process is connected to
+    int max_cnx_channels;
+    cnx_channel_t *cnx_channels;
+    int nb_owned_channels;      // Channels created by this process
+    int max_owned_channels;
+    struct channel_t **owned_channels;
 #ifdef DEBUG
     int state;
     messip_id_t id_blocked_on;
@@ -73,8 +137,14 @@ typedef struct {
 #endif
 } connexion_t;
 static int nb_connexions;
+static int max_connexions;      // Allocated size of connexions[]
 static connexion_t **connexions;
 
+typedef struct {
+    connexion_t *cnx;
+    int index;                  // In cnx->cnx_channels[]
+} channel_client_t;
+
 /*--- List of active channels ---*/
 typedef struct channel_t {
     messip_id_t id;
@@ -82,26 +152,69 @@ typedef struct channel_t {
     char channel_name[MESSIP_CHANNEL_NAME_MAXLEN + 1];
     time_t when;                // When this channel has been created
     int sockfd;
+    int index;                  // In channels[]
+    int owned_index;            // In cnx->owned_channels[]
+    int notify_index;           // In notify_deaths[], or -1
+    uint64_t handle;            // Given to its server and to its clients (see search_ch_by_handle)
     in_port_t sin_port;
     in_addr_t sin_addr;
     char sin_addr_str[48];
+    char sun_path[MESSIP_SUN_PATH_MAXLEN];  // Abstract AF_UNIX socket, for same-host clients
+    char host_ident[MESSIP_HOST_IDENT_MAXLEN];
+    int nb_clients;             // Protected by membership_mutex
+    int max_clients;
+    channel_client_t *clients;  // Dynamic Array
+
     int f_notify_deaths;        // Send a Msg on the death of each process
 
+    pthread_mutex_t lock;       // Protects the fields below
+
     // Buffered Messages
-    pthread_t tid_client_send_buffered_msg;
-    int bufferedsend_sockfd;
+    int bufferedsend_sockfd;    // Connection to the server, served by the delivery workers
+    int delivery_busy;          // A delivery worker is serving this channel
+    int delivery_failed;        // The server is gone: messages are no longer delivered
+    int delivery_destroyed;     // Channel destroyed: released by the worker, if busy
+    messip_datareply_t delivery_ack;    // Acknowledgment being read...
+    int32_t delivery_ack_len;   // ...bytes read so far
+    delivery_batch_t *delivery_batch;   // Messages being written, allocated with bufferedsend_sockfd
     int32_t maxnb_msg_buffered;
     int32_t nb_msg_buffered;
+    int32_t inflight_msg_buffered;  // Sent to the server, not acknowledged yet
     int reply_on_release_sockfd;
-    buffered_msg_t **buffered_msg;  // Dynamic Array
-
-    int nb_clients;
-    int *cnx_clients;           // Dynamic Array
+    buffered_msg_t *buffered_msg;   // Ring buffer, oldest message at head_msg_buffered
+    int32_t size_msg_buffered;  // Allocated size of buffered_msg[], a power of 2
+    int32_t head_msg_buffered;
 
 } channel_t;
 static int nb_channels;
+static int max_channels;        // Allocated size of channels[]
 static channel_t **channels;    // This is an array
 
+/*--- Channels which are notified of the death of each process ---*/
+static int nb_notify_deaths;
+static int max_notify_deaths;
+static channel_t **notify_deaths;
+
+/*--- Indexes, maintained with the tables above ---*/
+typedef struct {
+    void **entries;             // Indexed by socket
+    int size;
+} sockfd_index_t;
+static messip_hash_t *channels_by_name;
+static sockfd_index_t channels_by_sockfd;   // 1st channel created on this socket
+static sockfd_index_t connexions_by_sockfd;
+
+/*--- Handles of the channels: the 32 low bits are the index of an entry ---*/
+typedef struct {
+    channel_t *ch;              // NULL if the entry is free
+    uint32_t generation;        // 32 high bits of the handle given with this entry
+    int32_t next_free;          // If free: next free entry, or -1
+} handle_entry_t;
+static int nb_handles;
+static int max_handles;
+static handle_entry_t *handles;
+static int32_t free_handles = -1;
+
 static int f_bye;               // Set to 1 when SIGINT has been applied
 
 static int messip_port;         ///< TBD
@@ -121,43 +234,52 @@ enum {
 };
 
 /**
- * TBD 
+ * Entry of a socket in an index
  * 
- * @param c1 TBD
- * @param c2 TBD
- * @return TBD
+ * @param idx Index
+ * @param sockfd Socket
+ * @return Value associated to this socket, or NULL
  */
-static int qsort_channels( const void *c1, const void *c2 ) {
-    const channel_t **ch1 = ( const channel_t ** ) c1;
-    const channel_t **ch2 = ( const channel_t ** ) c2;
-    return strcmp( ( *ch1 )->channel_name, ( *ch2 )->channel_name );
-}                               // qsort_channels
+static void *sockfd_index_get( sockfd_index_t * idx, int sockfd ) {
+    if ( ( sockfd < 0 ) || ( sockfd >= idx->size ) )
+        return NULL;
+    return idx->entries[sockfd];
+}                               // sockfd_index_get
 
 /**
- * TBD 
+ * Set the entry of a socket in an index (which grows as needed)
  * 
- * @param c1 TBD
- * @param c2 TBD
- * @return TBD
+ * @param idx Index
+ * @param sockfd Socket
+ * @param value Value associated to this socket, or NULL
+ * @return 0 if no error, or -1 if out of memory
  */
-static int bsearch_channels( const void *c1, const void *c2 ) {
-    const channel_t **ch2 = ( const channel_t ** ) c2;
-    return strcmp( c1, ( *ch2 )->channel_name );
-}                               // bsearch_channels
+static int sockfd_index_set( sockfd_index_t * idx, int sockfd, void *value ) {
+    if ( sockfd >= idx->size ) {
+        int size = ( idx->size ) ? idx->size : 64;
+        void **entries;
+
+        while ( size <= sockfd )
+            size *= 2;
+        entries = realloc( idx->entries, size * sizeof( void * ) );
+        if ( entries == NULL )
+            return -1;
+        memset( &entries[idx->size], 0, ( size - idx->size ) * sizeof( void * ) );
+        idx->entries = entries;
+        idx->size = size;
+    }
+    idx->entries[sockfd] = value;
+    return 0;
+}                               // sockfd_index_set
 
 /**
- * TBD 
+ * Search a channel by the socket of the connexion which created it
  * 
- * @param sockfd TBD  
- * @return TBD
+ * @param sockfd Socket of the owner's connexion with the manager
+ * @return The 1st channel created on this socket, or NULL
  */
 static channel_t *search_ch_by_sockfd( int sockfd ) {
-    for ( int index = 0; index < nb_channels; index++ ) {
-    	channel_t *ch = channels[index];
-        if ( ch->sockfd == sockfd )
-            return ch;
-    }
-    return NULL;
+    return ( channel_t * ) sockfd_index_get( &channels_by_sockfd, sockfd );
 }                               // search_ch_by_sockfd
 
 #if 0
@@ -177,20 +299,136 @@ search_ch_by_pid( messip_id_t id ) {
 #endif
 
 /**
- * TBD 
+ * Search a connexion by its socket
  * 
- * @param sockfd TBD
- * @return TBD
+ * @param sockfd Socket of the connexion with the manager
+ * @return The connexion, or NULL
  */
 inline static connexion_t *search_cnx_by_sockfd( int sockfd ) {
-    for ( int index = 0; index < nb_connexions; index++ ) {
-        connexion_t *cnx = connexions[index];
-        if ( cnx->sockfd == sockfd )
-            return cnx;
-    }
-    return NULL;
+    return ( connexion_t * ) sockfd_index_get( &connexions_by_sockfd, sockfd );
 }                               // search_cnx_by_sockfd
 
+/**
+ * Make room for one more element in a dynamic array, doubling its size when it is full
+ * 
+ * @param array Address of the array
+ * @param max Allocated number of elements
+ * @param nb Number of elements used
+ * @param size Size of an element
+ * @return 0 if no error, or -1 if out of memory
+ */
+static int array_reserve( void **array, int *max, int nb, size_t size ) {
+    void *p;
+    int new_max;
+
+    if ( nb < *max )
+        return 0;
+    new_max = ( *max ) ? 2 * *max : 4;
+    p = realloc( *array, new_max * size );
+    if ( p == NULL )
+        return -1;
+    *array = p;
+    *max = new_max;
+    return 0;
+}                               // array_reserve
+
+/**
+ * Give a handle to a new channel (the lock must be held for writing)
+ * 
+ * @param ch Channel
+ * @return 0 if no error, or -1 if out of memory
+ */
+static int handle_alloc( channel_t * ch ) {
+    int32_t index = free_handles;
+
+    if ( index != -1 )
+        free_handles = handles[index].next_free;
+    else {
+        if ( array_reserve( ( void ** ) &handles, &max_handles, nb_handles, sizeof( handle_entry_t ) ) == -1 )
+            return -1;
+        index = nb_handles++;
+        handles[index].generation = 0;
+    }
+    if ( ++handles[index].generation == 0 )
+        ++handles[index].generation;    // MESSIP_HANDLE_NONE is never given
+    handles[index].ch = ch;
+    ch->handle = ( ( uint64_t ) handles[index].generation << 32 ) | ( uint32_t ) index;
+    return 0;
+}                               // handle_alloc
+
+/**
+ * Take back the handle of a channel being destroyed (the lock must be held for writing)
+ * 
+ * @param ch Channel
+ */
+static void handle_release( channel_t * ch ) {
+    int32_t index = ( int32_t ) ( uint32_t ) ch->handle;
+
+    if ( ch->handle == MESSIP_HANDLE_NONE )
+        return;
+    handles[index].ch = NULL;
+    handles[index].next_free = free_handles;
+    free_handles = index;
+    ch->handle = MESSIP_HANDLE_NONE;
+}                               // handle_release
+
+/**
+ * Search a channel by its handle
+ * 
+ * @param handle Handle given when the channel was created
+ * @return The channel, or NULL if the handle is unknown, or if its channel has been destroyed
+ */
+static channel_t *search_ch_by_handle( uint64_t handle ) {
+    uint32_t index = ( uint32_t ) handle;
+
+    if ( ( index >= nb_handles ) || ( handles[index].generation != ( uint32_t ) ( handle >> 32 ) ) )
+        return NULL;
+    return handles[index].ch;
+}                               // search_ch_by_handle
+
+/**
+ * Connect a client to a channel
+ * 
+ * @param ch Channel
+ * @param cnx Connexion of the client
+ * @return 0 if no error, or -1 if out of memory
+ */
+static int membership_add( channel_t * ch, connexion_t * cnx ) {
+    if ( ( array_reserve( ( void ** ) &ch->clients, &ch->max_clients, ch->nb_clients, sizeof( channel_client_t ) ) == -1 )
+       || ( array_reserve( ( void ** ) &cnx->cnx_channels, &cnx->max_cnx_channels, cnx->nb_cnx_channels,
+             sizeof( cnx_channel_t ) ) == -1 ) )
+        return -1;
+    ch->clients[ch->nb_clients].cnx = cnx;
+    ch->clients[ch->nb_clients].index = cnx->nb_cnx_channels;
+    cnx->cnx_channels[cnx->nb_cnx_channels].ch = ch;
+    cnx->cnx_channels[cnx->nb_cnx_channels].index = ch->nb_clients;
+    ch->nb_clients++;
+    cnx->nb_cnx_channels++;
+    return 0;
+}                               // membership_add
+
+/**
+ * Disconnect a client from a channel. The last entry of each list takes the place of the removed one.
+ * 
+ * @param ch Channel
+ * @param index Index of the client in ch->clients[]
+ */
+static void membership_remove( channel_t * ch, int index ) {
+    connexion_t *cnx = ch->clients[index].cnx;
+    int k = ch->clients[index].index;
+
+    if ( k != --cnx->nb_cnx_channels ) {
+        cnx_channel_t *moved = &cnx->cnx_channels[k];
+        *moved = cnx->cnx_channels[cnx->nb_cnx_channels];
+        moved->ch->clients[moved->index].index = k;
+    }
+    if ( index != --ch->nb_clients ) {
+        channel_client_t *moved = &ch->clients[index];
+        *moved = ch->clients[ch->nb_clients];
+        moved->cnx->cnx_channels[moved->index].index = index;
+    }
+}                               // membership_remove
+
 /**
  * TBD 
  * 
@@ -274,10 +512,12 @@ static void debug_show( void ) {
             strftime( when, 32, "%02d-%b-%y %02H:%02M:%02S", localtime( &cnx->when ) );
             printf( "%3d:%-8s %-12s %6d %d %-18s",
                index, cnx->id, inet_ntoa( cnx->xclient_addr.sin_addr ), cnx->xclient_addr.sin_port, cnx->sockfd, when );
+            MEMBERSHIP_LOCK;
             printf( " %d:", cnx->nb_cnx_channels );
             int k;
             for ( k = 0; k < cnx->nb_cnx_channels; k++ )
-                printf( "%s%d", ( k ) ? "-" : "", cnx->sockfd_cnx_channels[k] );
+                printf( "%s%d", ( k ) ? "-" : "", cnx->cnx_channels[k].ch->sockfd );
+            MEMBERSHIP_UNLOCK;
             printf( "\n" );
         }                       // for
     }                           // if
@@ -297,8 +537,9 @@ static void debug_show( void ) {
             ch = channels[index];
             strftime( when, 32, "%02d-%b-%y %02H:%02M:%02S", localtime( &ch->when ) );
             strcpy( tmp, "" );
+            MEMBERSHIP_LOCK;
             for ( k = 0; k < ch->nb_clients; k++ )
-                sprintf( &tmp[strlen( tmp )], "-%d", ch->cnx_clients[k] );
+                sprintf( &tmp[strlen( tmp )], "-%d", ch->clients[k].cnx->sockfd );
             printf( "%c%3d:%-8s %-12s %5d %-16s %5d %-18s %5d/%-5d %d%s\n",
                ( ch->f_notify_deaths ) ? 'D' : ' ',
                index,
@@ -306,6 +547,7 @@ static void debug_show( void ) {
                ch->sin_addr_str,
                ch->sin_port,
                ch->channel_name, ch->sockfd, when, ch->nb_msg_buffered, ch->maxnb_msg_buffered, ch->nb_clients, tmp );
+            MEMBERSHIP_UNLOCK;
         }                       // for
     }                           // if
 
@@ -321,17 +563,13 @@ static void *debug_thread( void *arg ) {
     int sig;
     sigset_t set;
 
-    sigemptyset( &set );
-    sigaddset( &set, SIGUSR2 );
-    pthread_sigmask( SIG_BLOCK, &set, NULL );
-
     /*--- Wait until SIGUSR1 signal ---*/
     fprintf( stdout, "For debugging: kill -s SIGUSR1 %d\n", getpid(  ) );
     for ( ;; ) {
         sigemptyset( &set );
         sigaddset( &set, SIGUSR1 );
         sigwait( &set, &sig );
-        LOCK;
+        RDLOCK;
         debug_show(  );
         UNLOCK;
     }
@@ -493,8 +731,9 @@ static void http_build_table_channels( char *msg ) {
         ch = channels[index];
         strftime( when, 32, "%02d-%b-%y %02H:%02M:%02S", localtime( &ch->when ) );
         strcpy( tmp, "" );
+        MEMBERSHIP_LOCK;
         for ( k = 0; k < ch->nb_clients; k++ )
-            sprintf( &tmp[strlen( tmp )], "-%d", ch->cnx_clients[k] );
+            sprintf( &tmp[strlen( tmp )], "-%d", ch->clients[k].cnx->sockfd );
         sprintf( &msg[strlen( msg )], "    <tr>\n" "      <td valign=\"top\" align=\"right\" >%d<br>\n" // index
            "      </td>\n" "      <td valign=\"top\" align=\"right\" >%s<br>\n" // id
            "      </td>\n" "      <td valign=\"top\" align=\"right\" >%s<br>\n" // sin_addr_str
@@ -512,6 +751,7 @@ static void http_build_table_channels( char *msg ) {
            ch->sin_addr_str,
            ch->sin_port,
            ch->channel_name, ch->sockfd, when, ch->nb_msg_buffered, ch->maxnb_msg_buffered, ch->nb_clients, tmp );
+        MEMBERSHIP_UNLOCK;
     }                           // for
 
     strcat( msg, "  </tbody>\n" "</table>\n" );
@@ -549,6 +789,7 @@ static int http_send_status( int sockfd, int version, int subversion, int key )
     strcat( msg2, "<hr width=\"100%\" size=\"2\"><br>" );
 
     /*--- Active connections ---*/
+    RDLOCK;
     sprintf( &msg2[strlen( msg2 )],
        "<body text=\"#000000\" bgcolor=\"#dddddd\" link=\"#000099\" vlink=\"#990099\" alink=\"#000099\">\n"
        "%d active connection%s:<br>\n", nb_connexions, ( nb_connexions > 1 ) ? "s" : "" );
@@ -559,6 +800,7 @@ static int http_send_status( int sockfd, int version, int subversion, int key )
     sprintf( &msg2[strlen( msg2 )], "<p>%d active channel%s:<br>\n", nb_channels, ( nb_channels > 1 ) ? "s" : "" );
     if ( nb_channels > 0 )
         http_build_table_channels( msg2 );
+    UNLOCK;
 
     /*--- End of page ---*/
     strcat( msg2, "<br>\n" "<br>\n" "</body>\n" "</html>\n" "\n" );
@@ -588,8 +830,31 @@ typedef struct {
     int sockfd_accept;
     struct sockaddr_in client_addr;
     unsigned client_addr_len;
+
+    // Client connections only (served by a reactor thread)
+    char *rx_buffer;            // Bytes received, not yet handled
+    int rx_len;
+    int rx_size;
+    connexion_t *new_cnx;
+    int search_socket;          // A connexion may have been registered
 } clientdescr_t;
 
+/*--- Delivery workers: they send the buffered messages of all the channels ---*/
+#define MESSIP_MGR_DELIVERY_WORKERS	2	// Default number of delivery workers (see -w)
+
+static int nb_delivery_workers;
+static int delivery_epoll;      // Connection to the server of each channel with buffered messages
+static int notice_epoll;        // Death notifications being written, watched through delivery_epoll
+
+/*--- Reactor threads: each one serves its share of the client connections ---*/
+#define MESSIP_MGR_REACTORS		4	// Default number of reactor threads (see -r)
+#define RX_BUFFER_SIZE			512	// Initial size of a receive buffer
+#define RX_BUFFER_MAXKEEP		65536	// Larger buffers are released once empty
+#define REACTOR_MAX_EVENTS		64
+
+static int nb_reactors;
+static int *reactors;           // epoll descriptor of each reactor thread
+
 /**
  * TBD 
  * 
@@ -655,15 +920,10 @@ static void *thread_http_thread( void *arg ) {
  * @return TBD
  */
 static void *http_thread( void *arg ) {
-    sigset_t set;
     int sockfd;
     int status;
     struct sockaddr_in server_addr;
 
-    sigemptyset( &set );
-    sigaddset( &set, SIGUSR2 );
-    pthread_sigmask( SIG_BLOCK, &set, NULL );
-
     /*--- Create socket ---*/
     sockfd = socket( AF_INET, SOCK_STREAM, 0 );
     if ( sockfd < 0 ) {
@@ -731,45 +991,50 @@ static void *http_thread( void *arg ) {
  * 
  * @param sockfd TBD  
  * @param client_addr TBD
+ * @param body Data specific to this message, following the op
  * @param new_cnx TBD
  * @return TBD
  */
-static int handle_client_connect( int sockfd, struct sockaddr_in *client_addr, connexion_t ** new_cnx ) {
+static int handle_client_connect( int sockfd, struct sockaddr_in *client_addr, const void *body, connexion_t ** new_cnx ) {
     struct iovec iovec[1];
     messip_send_connect_t msg;
     messip_reply_connect_t reply;
     connexion_t *cnx;
     ssize_t dcount;
 
-    /*--- Read additional data specific to this message ---*/
-    iovec[0].iov_base = &msg;
-    iovec[0].iov_len = sizeof( msg );
-    dcount = do_readv( sockfd, iovec, 1 );
-    if ( dcount == -1 ) {
-        fprintf( stderr, "%s %d: errno=%d\n", __FILE__, __LINE__, errno );
-        return -1;
-    }
-    if ( dcount != sizeof( msg ) ) {
-        fprintf( stderr, "%s %d\n\tread %d of %d - errno=%d\n", __FILE__, __LINE__, dcount, sizeof( msg ), errno );
-        return -1;
-    }
+    /*--- Additional data specific to this message ---*/
+    memmove( &msg, body, sizeof( msg ) );
 
-    /*--- Allocate a new connexion ---*/
-    cnx = malloc( sizeof( connexion_t ) );
-    time( &cnx->when );
-    IDCPY( cnx->id, msg.id );
-    memmove( &cnx->xclient_addr, client_addr, sizeof( struct sockaddr_in ) );
-    cnx->nb_cnx_channels = 0;
-    cnx->sockfd_cnx_channels = NULL;
-    cnx->sockfd = sockfd;
-    LOCK;
-    if ( connexions == NULL )
-        connexions = malloc( sizeof( connexion_t * ) );
-    else
-        connexions = realloc( connexions, ( nb_connexions + 1 ) * sizeof( connexion_t * ) );
-    connexions[nb_connexions++] = cnx;
-    UNLOCK;
-    *new_cnx = cnx;
+    /*--- Out of memory ? ---*/
+    WRLOCK;
+    if ( ( ( cnx = malloc( sizeof( connexion_t ) ) ) == NULL )
+       || ( array_reserve( ( void ** ) &connexions, &max_connexions, nb_connexions, sizeof( connexion_t * ) ) == -1 )
+       || ( sockfd_index_set( &connexions_by_sockfd, sockfd, cnx ) == -1 ) ) {
+
+        UNLOCK;
+        free( cnx );
+        reply.ok = MESSIP_NOK;
+
+    }                           // if
+    else {
+
+        /*--- Allocate a new connexion ---*/
+        time( &cnx->when );
+        IDCPY( cnx->id, msg.id );
+        memmove( &cnx->xclient_addr, client_addr, sizeof( struct sockaddr_in ) );
+        cnx->nb_cnx_channels = 0;
+        cnx->max_cnx_channels = 0;
+        cnx->cnx_channels = NULL;
+        cnx->nb_owned_channels = 0;
+        cnx->max_owned_channels = 0;
+        cnx->owned_channels = NULL;
+        cnx->sockfd = sockfd;
+        cnx->index = nb_connexions;
+        connexions[nb_connexions++] = cnx;
+        UNLOCK;
+        *new_cnx = cnx;
+        reply.ok = MESSIP_OK;
+    }                           // else
 
 #if 0
     logg( LOG_MESSIP_DEBUG_LEVEL1, "handle_msg_connect: pid=%d[%X] tid=%ld ip=%s port=%d\n",
@@ -777,7 +1042,6 @@ static int handle_client_connect( int sockfd, struct sockaddr_in *client_addr, c
 #endif
 
     /*--- Reply to the client ---*/
-    reply.ok = MESSIP_OK;
     iovec[0].iov_base = &reply;
     iovec[0].iov_len = sizeof( reply );
     dcount = do_writev( sockfd, iovec, 1 );
@@ -792,49 +1056,48 @@ static int handle_client_connect( int sockfd, struct sockaddr_in *client_addr, c
  * 
  * @param sockfd TBD  
  * @param client_addr TBD
+ * @param body Data specific to this message, following the op
  * @param cnx TBD
  * @return TBD
  */
-static int client_channel_create( int sockfd, struct sockaddr_in *client_addr, connexion_t ** cnx ) {
-    channel_t **pch, *ch;
+static int client_channel_create( int sockfd, struct sockaddr_in *client_addr, const void *body, connexion_t ** cnx ) {
+    channel_t *ch = NULL;
     struct iovec iovec[1];
     messip_send_channel_create_t msg;
     messip_reply_channel_create_t reply;
     ssize_t dcount;
 
-    /*--- Read additional data specific to this message ---*/
-    iovec[0].iov_base = &msg;
-    iovec[0].iov_len = sizeof( msg );
-    dcount = do_readv( sockfd, iovec, 1 );
-    if ( dcount == -1 ) {
-        fprintf( stderr, "%s %d: errno=%d\n", __FILE__, __LINE__, errno );
-        return -1;
-    }
-    if ( dcount != sizeof( msg ) ) {
-        fprintf( stderr, "%s %d: read %d of %d - errno=%d\n", __FILE__, __LINE__, dcount, sizeof( msg ), errno );
-        return -1;
-    }
+    /*--- Additional data specific to this message ---*/
+    memmove( &msg, body, sizeof( msg ) );
 
     logg( LOG_MESSIP_INFORMATIVE, "channel_create: id=%s ip=%s port=%d name=%s\n",
        msg.id, inet_ntoa( client_addr->sin_addr ), client_addr->sin_port, msg.channel_name );
 
     /*--- Is there any channel with this name ? ---*/
-    LOCK;
-    pch = bsearch( msg.channel_name, channels, nb_channels, sizeof( channel_t * ), bsearch_channels );
-    if ( pch != NULL ) {
+    WRLOCK;
+    msg.channel_name[MESSIP_CHANNEL_NAME_MAXLEN] = 0;
+    if ( messip_hash_get( channels_by_name, msg.channel_name ) != NULL ) {
 
         UNLOCK;
         reply.ok = MESSIP_NOK;
 
     }                           // if
+
+    /*--- Out of memory, or no handle left to give ? ---*/
+    else if ( ( array_reserve( ( void ** ) &channels, &max_channels, nb_channels, sizeof( channel_t * ) ) == -1 )
+       || ( ( *cnx != NULL ) && ( array_reserve( ( void ** ) &( *cnx )->owned_channels, &( *cnx )->max_owned_channels,
+                ( *cnx )->nb_owned_channels, sizeof( channel_t * ) ) == -1 ) )
+       || ( ( ch = malloc( sizeof( channel_t ) ) ) == NULL ) || ( handle_alloc( ch ) == -1 ) ) {
+
+        free( ch );
+        UNLOCK;
+        reply.ok = MESSIP_NOK;
+
+    }                           // else if
     else {
 
         /*--- Allocate a new channel ---*/
-        if ( channels == NULL )
-            channels = malloc( sizeof( channel_t * ) );
-        else
-            channels = realloc( channels, ( nb_channels + 1 ) * sizeof( channel_t * ) );
-        ch = malloc( sizeof( channel_t ) );
+        ch->index = nb_channels;
         channels[nb_channels++] = ch;
 
         /*--- Create a new channel ---*/
@@ -843,25 +1106,46 @@ static int client_channel_create( int sockfd, struct sockaddr_in *client_addr, c
         IDCPY( ch->id, msg.id );
         ch->maxnb_msg_buffered = msg.maxnb_msg_buffered;
         ch->sockfd = sockfd;
-        ch->tid_client_send_buffered_msg = 0;
+        pthread_mutex_init( &ch->lock, NULL );
         ch->bufferedsend_sockfd = 0;
+        ch->delivery_busy = 0;
+        ch->delivery_failed = 0;
+        ch->delivery_destroyed = 0;
+        ch->delivery_ack_len = 0;
+        ch->delivery_batch = NULL;
         ch->nb_msg_buffered = 0;
+        ch->inflight_msg_buffered = 0;
         ch->buffered_msg = NULL;
+        ch->size_msg_buffered = 0;
+        ch->head_msg_buffered = 0;
         ch->nb_clients = 0;
-        ch->cnx_clients = NULL;
+        ch->max_clients = 0;
+        ch->clients = NULL;
+        ch->notify_index = -1;
         ch->f_notify_deaths = MESSIP_FALSE; // Send a Msg on the death of each process
         strncpy( ch->channel_name, msg.channel_name, MESSIP_CHANNEL_NAME_MAXLEN );
         ch->channel_name[MESSIP_CHANNEL_NAME_MAXLEN] = 0;
         ch->sin_port = msg.sin_port;
         ch->sin_addr = client_addr->sin_addr.s_addr;
         strcpy( ch->sin_addr_str, inet_ntoa( client_addr->sin_addr ) );
-
-        /*--- Keep the channels sorted ---*/
-        qsort( channels, nb_channels, sizeof( channel_t * ), qsort_channels );
+        memmove( ch->sun_path, msg.sun_path, sizeof( ch->sun_path ) );
+        ch->sun_path[MESSIP_SUN_PATH_MAXLEN - 1] = 0;
+        memmove( ch->host_ident, msg.host_ident, sizeof( ch->host_ident ) );
+        ch->host_ident[MESSIP_HOST_IDENT_MAXLEN - 1] = 0;
+
+        /*--- Update the indexes ---*/
+        if ( ch->cnx != NULL ) {
+            ch->owned_index = ch->cnx->nb_owned_channels;
+            ch->cnx->owned_channels[ch->cnx->nb_owned_channels++] = ch;
+        }
+        messip_hash_put( channels_by_name, ch->channel_name, ch );
+        if ( search_ch_by_sockfd( sockfd ) == NULL )
+            sockfd_index_set( &channels_by_sockfd, sockfd, ch );
         reply.ok = MESSIP_OK;
         reply.sin_port = ch->sin_port;
         reply.sin_addr = ch->sin_addr;
         strcpy( reply.sin_addr_str, ch->sin_addr_str );
+        reply.handle = ch->handle;
 
         UNLOCK;
     }                           // else
@@ -877,44 +1161,104 @@ static int client_channel_create( int sockfd, struct sockaddr_in *client_addr, c
 }                               // client_channel_create
 
 /**
- * TBD 
+ * Close the connection used to deliver the buffered messages of a channel, and discard 
+ * the messages not delivered. The lock of the channel must be held, and no delivery 
+ * worker must be serving the channel.
  * 
- * @param ch TBD
- * @param  index TBD
+ * @param ch Channel
  */
-static void destroy_channel( channel_t * ch, int index ) {
+static void delivery_release( channel_t * ch ) {
     int k;
 
-#if 0
-    logg( LOG_MESSIP_NON_FATAL_ERROR, "Destroy channel %d [%s] index=%d\n", index, ch->name, index );
-#endif
-
-    if ( ch->tid_client_send_buffered_msg ) {
-        pthread_cancel( ch->tid_client_send_buffered_msg );
+    if ( ch->bufferedsend_sockfd ) {
         if ( closesocket( ch->bufferedsend_sockfd ) == -1 )
             fprintf( stderr, "Error %d while closing socket %d\n", errno, ch->bufferedsend_sockfd );
-    }                           // if
+        ch->bufferedsend_sockfd = 0;
+    }
+    free( ch->delivery_batch );
+    ch->delivery_batch = NULL;
+    for ( k = 0; k < ch->nb_msg_buffered; k++ )
+        free( ch->buffered_msg[( ch->head_msg_buffered + k ) & ( ch->size_msg_buffered - 1 )].data );
+    free( ch->buffered_msg );
+    ch->buffered_msg = NULL;
+    ch->size_msg_buffered = 0;
+    ch->head_msg_buffered = 0;
+    ch->nb_msg_buffered = 0;
+    ch->inflight_msg_buffered = 0;
+}                               // delivery_release
 
-    if ( ch->nb_msg_buffered > 0 ) {
-        for ( k = 0; k < ch->nb_msg_buffered; k++ )
-            free( ch->buffered_msg[k] );
-        free( ch->buffered_msg );
-    }                           // if
+/**
+ * Have a delivery worker serve a channel once its server acknowledges some messages, or as soon 
+ * as its socket is writable if messages are waiting to be sent, or are partly written (EPOLLOUT). The event is one-shot: a channel is served 
+ * by a single worker at a time. The lock of the channel must be held.
+ * 
+ * @param ch Channel
+ * @param op EPOLL_CTL_ADD for a new connection, otherwise EPOLL_CTL_MOD
+ * @return 0 if no error, or -1 if an error occurred (errno is set)
+ */
+static int delivery_arm( channel_t * ch, int op ) {
+    struct epoll_event event;
+
+    event.events = EPOLLIN | EPOLLONESHOT;
+    if ( ch->delivery_batch->first < ch->delivery_batch->iovcnt )
+        event.events |= EPOLLOUT;
+    else if ( ( ch->nb_msg_buffered > ch->inflight_msg_buffered ) && ( ch->inflight_msg_buffered < BUFFERED_MSG_WINDOW ) )
+        event.events |= EPOLLOUT;
+    event.data.ptr = ch;
+    return epoll_ctl( delivery_epoll, op, ch->bufferedsend_sockfd, &event );
+}                               // delivery_arm
 
-    if ( index == -1 ) {
-        for ( k = 0; k < nb_channels; k++ ) {
-            if ( channels[k] == ch ) {
-                index = k;
-                break;
-            }
-        }
-        assert( index != -1 );
-    }                           // if
+/**
+ * Destroy a channel, and disconnect its clients (the lock must be held for writing)
+ * 
+ * @param ch Channel to destroy
+ */
+static void destroy_channel( channel_t * ch ) {
+    channel_t *last;
+
+#if 0
+    logg( LOG_MESSIP_NON_FATAL_ERROR, "Destroy channel %d [%s]\n", ch->index, ch->channel_name );
+#endif
 
-    for ( k = index + 1; k < nb_channels; k++ )
-        channels[k - 1] = channels[k];
+    /*--- Stop the delivery of its buffered messages ---*/
+    CH_LOCK( ch );
+    if ( ch->bufferedsend_sockfd )
+        epoll_ctl( delivery_epoll, EPOLL_CTL_DEL, ch->bufferedsend_sockfd, NULL );
+    ch->delivery_destroyed = 1;
+    if ( !ch->delivery_busy )
+        delivery_release( ch );
+    CH_UNLOCK( ch );
+
+    /*--- Disconnect its clients ---*/
+    while ( ch->nb_clients > 0 )
+        membership_remove( ch, ch->nb_clients - 1 );
+    free( ch->clients );
+    ch->clients = NULL;
+    ch->max_clients = 0;
+
+    /*--- Update the indexes ---*/
+    messip_hash_remove( channels_by_name, ch->channel_name );
+    handle_release( ch );
+    if ( ch->notify_index != -1 ) {
+        notify_deaths[ch->notify_index] = notify_deaths[--nb_notify_deaths];
+        notify_deaths[ch->notify_index]->notify_index = ch->notify_index;
+        ch->notify_index = -1;
+    }
+    if ( ch->cnx != NULL ) {
+        connexion_t *cnx = ch->cnx;
+        cnx->owned_channels[ch->owned_index] = cnx->owned_channels[--cnx->nb_owned_channels];
+        cnx->owned_channels[ch->owned_index]->owned_index = ch->owned_index;
+        if ( search_ch_by_sockfd( ch->sockfd ) == ch )
+            sockfd_index_set( &channels_by_sockfd, ch->sockfd, ( cnx->nb_owned_channels ) ? cnx->owned_channels[0] : NULL );
+    }                           // if
+    else if ( search_ch_by_sockfd( ch->sockfd ) == ch ) {
+        sockfd_index_set( &channels_by_sockfd, ch->sockfd, NULL );
+    }
 
-    nb_channels--;
+    /*--- The last channel takes its place ---*/
+    last = channels[--nb_channels];
+    channels[ch->index] = last;
+    last->index = ch->index;
 
 }                               // destroy_channel
 
@@ -923,59 +1267,40 @@ static void destroy_channel( channel_t * ch, int index ) {
  * 
  * @param sockfd TBD  
  * @param client_addr TBD
+ * @param body Data specific to this message, following the op
  * @return TBD
  */
-static int client_channel_delete( int sockfd, struct sockaddr_in *client_addr ) {
-    channel_t **pch, *ch;
+static int client_channel_delete( int sockfd, struct sockaddr_in *client_addr, const void *body ) {
+    channel_t *ch;
     struct iovec iovec[1];
     messip_send_channel_delete_t msg;
     messip_reply_channel_delete_t reply;
     ssize_t dcount;
 
-    /*--- Read additional data specific to this message ---*/
-    iovec[0].iov_base = &msg;
-    iovec[0].iov_len = sizeof( msg );
-    dcount = do_readv( sockfd, iovec, 1 );
-    if ( dcount == -1 ) {
-        fprintf( stderr, "%s %d: errno=%d\n", __FILE__, __LINE__, errno );
-        return -1;
-    }
-    if ( dcount != sizeof( messip_send_channel_delete_t ) ) {
-        fprintf( stderr, "%s %d: read %d of %d - errno=%d\n",
-           __FILE__, __LINE__, dcount, sizeof( messip_send_channel_delete_t ), errno );
-        return -1;
-    }
+    /*--- Additional data specific to this message ---*/
+    memmove( &msg, body, sizeof( msg ) );
 
 #if 0
     logg( LOG_MESSIP_NON_FATAL_ERROR, "channel_delete: pid=%d tid=%ld name=%s\n", msg.pid, msg.tid, msg.name );
 #endif
 
-    /*--- Search this channel name ---*/
-    LOCK;
-    pch = bsearch( msg.name, channels, nb_channels, sizeof( channel_t * ), bsearch_channels );
-    ch = ( pch ) ? *pch : NULL;
-    UNLOCK;
+    /*--- Search this channel ---*/
+    WRLOCK;
+    ch = search_ch_by_handle( msg.handle );
 
-    /*--- Reply to the client ---*/
+    /*--- Reply to the client: only the connexion which created the channel can delete it ---*/
     if ( ch == NULL ) {
         reply.nb_clients = -1;
     }
+    else if ( ch->sockfd != sockfd ) {
+        reply.nb_clients = -1;
+    }
     else {
-        LOCK;
-        if ( strcmp( ch->id, msg.id ) ) {
-            reply.nb_clients = -1;
-        }                       // if
-        else {
-            if ( ch->nb_clients > 0 ) {
-                reply.nb_clients = ch->nb_clients;
-            }
-            else {
-                destroy_channel( ch, -1 );
-                reply.nb_clients = 0;
-            }
-        }                       // else
-        UNLOCK;
+        reply.nb_clients = ch->nb_clients;
+        if ( reply.nb_clients == 0 )
+            destroy_channel( ch );
     }                           // else
+    UNLOCK;
     iovec[0].iov_base = &reply;
     iovec[0].iov_len = sizeof( reply );
     dcount = do_writev( sockfd, iovec, 1 );
@@ -990,89 +1315,65 @@ static int client_channel_delete( int sockfd, struct sockaddr_in *client_addr )
  * 
  * @param sockfd TBD
  * @param client_addr TBD
+ * @param body Data specific to this message, following the op
  * @return TBD
  */
-static int client_channel_connect( int sockfd, struct sockaddr_in *client_addr ) {
-    channel_t **pch, *ch;
+static int client_channel_connect( int sockfd, struct sockaddr_in *client_addr, const void *body ) {
+    channel_t *ch;
     struct iovec iovec[1];
     messip_send_channel_connect_t msg;
     messip_reply_channel_connect_t reply;
+    connexion_t *cnx;
     ssize_t dcount;
     int k;
 
-    /*--- Read additional data specific to this message ---*/
-    iovec[0].iov_base = &msg;
-    iovec[0].iov_len = sizeof( msg );
-    dcount = do_readv( sockfd, iovec, 1 );
-    if ( dcount == -1 ) {
-        fprintf( stderr, "%s %d: errno=%d\n", __FILE__, __LINE__, errno );
-        return -1;
-    }
-    if ( dcount != sizeof( messip_send_channel_connect_t ) ) {
-        fprintf( stderr, "%s %d: read %d of %d - errno=%d\n",
-           __FILE__, __LINE__, dcount, sizeof( messip_send_channel_connect_t ), errno );
-        return -1;
-    }
+    /*--- Additional data specific to this message ---*/
+    memmove( &msg, body, sizeof( msg ) );
 
 #if 0
     logg( LOG_MESSIP_NON_FATAL_ERROR, "channel_connect: pid=%d tid=%ld name=%s\n", msg.pid, msg.tid, msg.name );
 #endif
 
     /*--- Search this channel name ---*/
-    LOCK;
-    pch = bsearch( msg.name, channels, nb_channels, sizeof( channel_t * ), bsearch_channels );
-    ch = ( pch ) ? *pch : NULL;
-    UNLOCK;
+    RDLOCK;
+    msg.name[MESSIP_CHANNEL_NAME_MAXLEN] = 0;
+    ch = ( channel_t * ) messip_hash_get( channels_by_name, msg.name );
+    cnx = search_cnx_by_sockfd( sockfd );
 
     /*--- Reply to the client ---*/
-    if ( ch == NULL ) {
+    if ( ( ch == NULL ) || ( cnx == NULL ) ) {
         reply.ok = MESSIP_NOK;
     }
     else {
 
-        /*--- Is this client already connected ? ---*/
-        for ( reply.f_already_connected = 0, k = 0; k < ch->nb_clients; k++ ) {
-            if ( ch->cnx_clients[k] == sockfd ) {
+        /*--- Is this client already connected ? Otherwise add it to the clients of the channel ---*/
+        MEMBERSHIP_LOCK;
+        for ( reply.f_already_connected = 0, k = 0; k < cnx->nb_cnx_channels; k++ ) {
+            if ( cnx->cnx_channels[k].ch == ch ) {
                 reply.f_already_connected = 1;
                 break;
             }
         }
-
         reply.ok = MESSIP_OK;
+        if ( !reply.f_already_connected && ( membership_add( ch, cnx ) == -1 ) )
+            reply.ok = MESSIP_NOK;
+        MEMBERSHIP_UNLOCK;
+
         IDCPY( reply.id, ch->id );
         reply.sin_port = ch->sin_port;
         reply.sin_addr = ch->sin_addr;
         memmove( reply.sin_addr_str, ch->sin_addr_str, sizeof( reply.sin_addr_str ) );
-        reply.mgr_sockfd = ch->sockfd;
+        reply.handle = ch->handle;
+        memmove( reply.sun_path, ch->sun_path, sizeof( reply.sun_path ) );
+        memmove( reply.host_ident, ch->host_ident, sizeof( reply.host_ident ) );
     }
+    UNLOCK;
+
     iovec[0].iov_base = &reply;
     iovec[0].iov_len = sizeof( reply );
     dcount = do_writev( sockfd, iovec, 1 );
     assert( dcount == sizeof( reply ) );
 
-    /*--- Maintain a list of clients connected to this connection ---*/
-    if ( ch ) {
-        if ( !reply.f_already_connected ) {
-            LOCK;
-
-            if ( ch->nb_clients == 0 )
-                ch->cnx_clients = malloc( sizeof( int ) );
-            else
-                ch->cnx_clients = realloc( ch->cnx_clients, ( ch->nb_clients + 1 ) * sizeof( int ) );
-            ch->cnx_clients[ch->nb_clients++] = sockfd;
-
-            connexion_t *cnx = search_cnx_by_sockfd( sockfd );
-            if ( cnx->nb_cnx_channels == 0 )
-                cnx->sockfd_cnx_channels = malloc( sizeof( int ) );
-            else
-                cnx->sockfd_cnx_channels = realloc( cnx->sockfd_cnx_channels, ( cnx->nb_cnx_channels + 1 ) * sizeof( int ) );
-            cnx->sockfd_cnx_channels[cnx->nb_cnx_channels++] = ch->sockfd;
-
-            UNLOCK;
-
-        }                       // if
-    }                           // if
-
     return MESSIP_OK;
 
 }                               // client_channel_connect
@@ -1082,77 +1383,47 @@ static int client_channel_connect( int sockfd, struct sockaddr_in *client_addr )
  * 
  * @param sockfd TBD
  * @param client_addr TBD
+ * @param body Data specific to this message, following the op
  * @return TBD
  */
-static int client_channel_disconnect( int sockfd, struct sockaddr_in *client_addr ) {
-    channel_t **pch, *ch;
+static int client_channel_disconnect( int sockfd, struct sockaddr_in *client_addr, const void *body ) {
+    channel_t *ch;
     struct iovec iovec[1];
     messip_send_channel_disconnect_t msg;
     messip_reply_channel_disconnect_t reply;
+    connexion_t *cnx;
     ssize_t dcount;
-    int index, k;
-
-    /*--- Read additional data specific to this message ---*/
-    iovec[0].iov_base = &msg;
-    iovec[0].iov_len = sizeof( msg );
-    dcount = do_readv( sockfd, iovec, 1 );
-    if ( dcount == -1 ) {
-        fprintf( stderr, "%s %d: errno=%d\n", __FILE__, __LINE__, errno );
-        return -1;
-    }
-    if ( dcount != sizeof( messip_send_channel_disconnect_t ) ) {
-        fprintf( stderr, "%s %d: read %d of %d - errno=%d\n",
-           __FILE__, __LINE__, dcount, sizeof( messip_send_channel_disconnect_t ), errno );
-        return -1;
-    }
+    int k;
+
+    /*--- Additional data specific to this message ---*/
+    memmove( &msg, body, sizeof( msg ) );
 
 #if 0
     logg( LOG_MESSIP_NON_FATAL_ERROR, "channel_disconnect: pid=%d tid=%ld name=%s  sockfd=%d\n",
        msg.pid, msg.tid, msg.name, sockfd );
 #endif
 
-    /*--- Search this channel name ---*/
-    LOCK;
-    pch = bsearch( msg.name, channels, nb_channels, sizeof( channel_t * ), bsearch_channels );
-    ch = ( pch ) ? *pch : NULL;
-    UNLOCK;
+    /*--- Search this channel ---*/
+    RDLOCK;
+    ch = search_ch_by_handle( msg.handle );
 
-    /*--- Reply to the client ---*/
-    if ( ch == NULL ) {
+    /*--- Disconnect this client from the channel ---*/
+    cnx = search_cnx_by_sockfd( sockfd );
+    if ( ( ch == NULL ) || ( cnx == NULL ) ) {
         reply.ok = MESSIP_NOK;
     }
     else {
-        LOCK;
-        for ( index = 0; index < nb_channels; index++ ) {
-            int nb, new_nb;
-            channel_t *channel;
-
-            channel = channels[index];
-            for ( nb = 0, k = 0; k < channel->nb_clients; k++ )
-                if ( channel->cnx_clients[k] == sockfd )
-                    nb++;
-            new_nb = channel->nb_clients - nb;
-            if ( new_nb == 0 ) {
-                channel->nb_clients = 0;
-                free( channel->cnx_clients );
-                channel->cnx_clients = NULL;
-            }
-            else {
-                int w, *clients;
-                clients = malloc( sizeof( int ) * new_nb );
-                for ( w = 0, k = 0; k < channel->nb_clients; k++ ) {
-                    if ( channel->cnx_clients[k] != sockfd )
-                        clients[w++] = channel->cnx_clients[k];
-                }               // for (k)
-                assert( w == new_nb );
-                channel->nb_clients = new_nb;
-                free( channel->cnx_clients );
-                channel->cnx_clients = clients;
+        MEMBERSHIP_LOCK;
+        for ( k = 0; k < cnx->nb_cnx_channels; k++ ) {
+            if ( cnx->cnx_channels[k].ch == ch ) {
+                membership_remove( ch, cnx->cnx_channels[k].index );
+                break;
             }
-        }                       // for (ch)
+        }
+        MEMBERSHIP_UNLOCK;
         reply.ok = MESSIP_OK;
-        UNLOCK;
     }                           // else
+    UNLOCK;
     iovec[0].iov_base = &reply;
     iovec[0].iov_len = sizeof( reply );
     dcount = do_writev( sockfd, iovec, 1 );
@@ -1163,134 +1434,327 @@ static int client_channel_disconnect( int sockfd, struct sockaddr_in *client_add
 }                               // client_channel_disconnect
 
 /**
- * TBD 
+ * Make room in the ring buffer of the buffered messages of a channel.
+ * It is first sized from maxnb_msg_buffered; it only has to grow when
+ * several clients have queued messages beyond this limit.
+ * The lock of the channel must be held.
  * 
- * @param arg TBD
- * @return TBD
+ * @param ch Channel
+ * @return 0 if no error, or -1 if out of memory
  */
-static void *thread_client_send_buffered_msg( void *arg ) {
-    channel_t *ch = ( channel_t * ) arg;
-    messip_datasend_t datasend;
-    messip_datareply_t datareply;
-    struct iovec iovec[3];
+static int buffered_msg_grow( channel_t * ch ) {
+    buffered_msg_t *ring;
+    int32_t size, k;
+
+    if ( ch->size_msg_buffered == 0 ) {
+        for ( size = BUFFERED_MSG_MINSIZE; ( size < ch->maxnb_msg_buffered ) && ( size < BUFFERED_MSG_MAXINIT ); )
+            size *= 2;
+    }
+    else {
+        size = 2 * ch->size_msg_buffered;
+    }
+    ring = malloc( size * sizeof( buffered_msg_t ) );
+    if ( ring == NULL )
+        return -1;
+
+    /*--- Unwrap the messages already queued ---*/
+    for ( k = 0; k < ch->nb_msg_buffered; k++ )
+        ring[k] = ch->buffered_msg[( ch->head_msg_buffered + k ) & ( ch->size_msg_buffered - 1 )];
+    free( ch->buffered_msg );
+    ch->buffered_msg = ring;
+    ch->size_msg_buffered = size;
+    ch->head_msg_buffered = 0;
+    return 0;
+}                               // buffered_msg_grow
+
+/**
+ * Serve a channel, on behalf of a delivery worker: read the acknowledgments received so far 
+ * (each one covers one or several messages), then send at once, with a single writev(), 
+ * the queued messages which fit in the window of BUFFERED_MSG_WINDOW messages in flight.
+ * Nothing here waits for the server: the socket does not block, and what does not fit in 
+ * it is written by a next call (the channel is then armed for EPOLLOUT).
+ * 
+ * @param ch Channel, marked as busy by the caller
+ */
+static void delivery_serve( channel_t * ch ) {
+    delivery_batch_t *batch = ch->delivery_batch;
     buffered_msg_t *bmsg;
-    int status;
     ssize_t dcount;
-    uint32_t len;
-    fd_set ready;
-    int sockfd;
-    int nb, k;
-    int do_reply;
-    int sig;
-    sigset_t set;
-
-    logg( LOG_MESSIP_NON_FATAL_ERROR, "thread_client_send_buffered_msg: pid=%d tid=%ld\n", getpid(  ), pthread_self(  ) );
+    int sockfd, reply_sockfd;
+    int nb, nb_tosend, nb_acked, k;
+    int do_reply, failed;
+
+    /*--- Acknowledgments from the server, possibly partial ---*/
+    sockfd = ch->bufferedsend_sockfd;
+    nb_acked = 0;
+    failed = 0;
     for ( ;; ) {
+        dcount = recv( sockfd, ( char * ) &ch->delivery_ack + ch->delivery_ack_len,
+           sizeof( messip_datareply_t ) - ch->delivery_ack_len, MSG_DONTWAIT );
+        if ( dcount > 0 ) {
+            ch->delivery_ack_len += dcount;
+            if ( ch->delivery_ack_len == sizeof( messip_datareply_t ) ) {
+                nb_acked += ( ch->delivery_ack.answer > 0 ) ? ch->delivery_ack.answer : 1;
+                ch->delivery_ack_len = 0;
+            }
+            continue;
+        }
+        if ( ( dcount == -1 ) && ( errno == EINTR ) )
+            continue;
+        if ( ( dcount == -1 ) && ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) )
+            break;
+        failed = 1;             // The server is gone
+        break;
+    }                           // for (;;)
 
-        /*--- Wait until SIGUSR2 is applied to the thread ---*/
-        sigemptyset( &set );
-        sigaddset( &set, SIGUSR2 );
-        sigwait( &set, &sig );
+    /*--- Clean-up the messages acknowledged (all of them, if the server is gone) ---*/
+    CH_LOCK( ch );
+    if ( failed ) {
+        ch->delivery_failed = 1;
+        nb_acked = ch->nb_msg_buffered;
+        batch->first = batch->iovcnt = 0;
+    }
+    else if ( nb_acked > ch->inflight_msg_buffered ) {
+        nb_acked = ch->inflight_msg_buffered;
+    }
+    for ( k = 0; k < nb_acked; k++ ) {
+        bmsg = &ch->buffered_msg[ch->head_msg_buffered];
+        if ( bmsg->data )
+            free( bmsg->data );
+        ch->head_msg_buffered = ( ch->head_msg_buffered + 1 ) & ( ch->size_msg_buffered - 1 );
+    }                           // for (k)
+    do_reply = ( ch->nb_msg_buffered >= ch->maxnb_msg_buffered )
+       && ( ch->nb_msg_buffered - nb_acked < ch->maxnb_msg_buffered );
+    ch->nb_msg_buffered -= nb_acked;
+    ch->inflight_msg_buffered = ( failed ) ? 0 : ch->inflight_msg_buffered - nb_acked;
+    nb = ch->nb_msg_buffered;
+    reply_sockfd = ch->reply_on_release_sockfd;
+
+    /*--- Messages queued but not sent yet, as many as the window allows, once the previous batch is written ---*/
+    nb_tosend = 0;
+    if ( !failed && ( batch->first == batch->iovcnt ) ) {
+        nb_tosend = nb - ch->inflight_msg_buffered;
+        if ( nb_tosend > BUFFERED_MSG_WINDOW - ch->inflight_msg_buffered )
+            nb_tosend = BUFFERED_MSG_WINDOW - ch->inflight_msg_buffered;
+        for ( k = 0; k < nb_tosend; k++ ) {
+            bmsg = &ch->buffered_msg[( ch->head_msg_buffered + ch->inflight_msg_buffered + k ) & ( ch->size_msg_buffered - 1 )];
+            batch->datasend[k].flag = MESSIP_FLAG_BUFFERED;
+            IDCPY( batch->datasend[k].id, bmsg->id_from );
+            batch->datasend[k].type = bmsg->type;
+            batch->datasend[k].datalen = bmsg->datalen;
+            batch->iovec[3 * k].iov_base = &batch->datasend[k];
+            batch->iovec[3 * k].iov_len = sizeof( messip_datasend_t );
+            batch->iovec[3 * k + 1].iov_base = &batch->len;
+            batch->iovec[3 * k + 1].iov_len = sizeof( int32_t );
+            batch->iovec[3 * k + 2].iov_base = bmsg->data;   // Freed once acknowledged, by the worker serving the channel
+            batch->iovec[3 * k + 2].iov_len = bmsg->datalen;
+        }                       // for (k)
+        batch->len = 0;
+        batch->first = 0;
+        batch->iovcnt = 3 * nb_tosend;
+        ch->inflight_msg_buffered += nb_tosend;
+    }
+    CH_UNLOCK( ch );
 
-        LOCK;
-        nb = ch->nb_msg_buffered;
-        sockfd = ch->bufferedsend_sockfd;
-        UNLOCK;
+    /*--- Reply to the client, which was blocked because too many buffered messages ---*/
+    if ( do_reply ) {
+        messip_reply_buffered_send_t msgreply;
+        struct iovec iovec_reply[1];
 
-        while ( nb > 0 ) {
+        msgreply.ok = MESSIP_OK;
+        msgreply.nb_msg_buffered = nb;
+        iovec_reply[0].iov_base = &msgreply;
+        iovec_reply[0].iov_len = sizeof( msgreply );
+        dcount = do_writev( reply_sockfd, iovec_reply, 1 );
+        if ( dcount != sizeof( msgreply ) )
+            fprintf( stderr, "%s: unable to release client socket %d - errno=%d\n", __FUNCTION__, reply_sockfd, errno );
+    }                           // if
 
-            /*--- Wait until ready to write ---*/
-            FD_ZERO( &ready );
-            FD_SET( sockfd, &ready );
-            status = select( FD_SETSIZE, NULL, &ready, NULL, NULL );
+    /*--- Send the batch to the 'server', as much as the socket takes (a failure is seen with the next acknowledgment) ---*/
+    while ( !failed && ( batch->first < batch->iovcnt ) ) {
+        dcount = writev( sockfd, &batch->iovec[batch->first], batch->iovcnt - batch->first );
+        if ( ( dcount == -1 ) && ( errno == EINTR ) )
+            continue;
+        if ( dcount == -1 ) {
+            if ( ( errno != EAGAIN ) && ( errno != EWOULDBLOCK ) )
+                logg( LOG_MESSIP_NON_FATAL_ERROR, "%s: writev failed on channel %s - errno=%d\n",
+                   __FUNCTION__, ch->channel_name, errno );
+            break;
+        }
 
-            LOCK;
-            if ( ch->nb_msg_buffered == 0 ) {
-                UNLOCK;
-                break;
-            }
-            bmsg = ch->buffered_msg[0];
+        /*--- Skip what has been written: the rest is written now, or once the socket is writable ---*/
+        while ( ( batch->first < batch->iovcnt ) && ( dcount >= batch->iovec[batch->first].iov_len ) )
+            dcount -= batch->iovec[batch->first++].iov_len;
+        if ( dcount > 0 ) {
+            batch->iovec[batch->first].iov_base = ( char * ) batch->iovec[batch->first].iov_base + dcount;
+            batch->iovec[batch->first].iov_len -= dcount;
+        }
+    }                           // while
 
-            /*--- Message to send ---*/
-            datasend.flag = MESSIP_FLAG_BUFFERED;
-            IDCPY( datasend.id, bmsg->id_from );
-            datasend.type = bmsg->type;
-            datasend.datalen = bmsg->datalen;
-            UNLOCK;
+}                               // delivery_serve
 
-            /*--- Send a message to the 'server' ---*/
-            iovec[0].iov_base = &datasend;
-            iovec[0].iov_len = sizeof( datasend );
-            iovec[1].iov_base = &len;
-            iovec[1].iov_len = sizeof( int32_t );
-            iovec[2].iov_base = bmsg->data;
-            iovec[2].iov_len = bmsg->datalen;
-            dcount = do_writev( sockfd, iovec, 3 );
-            if ( dcount != sizeof( datasend ) + bmsg->datalen + sizeof( int32_t ) ) {
-                printf( "dcount=%d expected=%d datalen=%d\n",
-                   dcount, sizeof( datasend ) + bmsg->datalen + sizeof( int32_t ), bmsg->datalen );
-            }
-            assert( dcount == sizeof( datasend ) + bmsg->datalen + sizeof( int32_t ) );
-
-            /*--- Now wait for an answer from the server ---*/
-            errno = -1;
-            iovec[0].iov_base = &datareply;
-            iovec[0].iov_len = sizeof( datareply );
-            dcount = do_readv( sockfd, iovec, 1 );
-
-            /*--- Clean-up this message ---*/
-            LOCK;
-            if ( bmsg->data )
-                free( bmsg->data );
-            free( bmsg );
-            if ( --ch->nb_msg_buffered == 0 ) {
-                free( ch->buffered_msg );
-                ch->buffered_msg = NULL;
-            }
-            else {
-                for ( k = 1; k <= ch->nb_msg_buffered; k++ )
-                    ch->buffered_msg[k - 1] = ch->buffered_msg[k];
-                ch->buffered_msg = realloc( ch->buffered_msg, sizeof( buffered_msg_t * ) * ch->nb_msg_buffered );
-            }
+/**
+ * Notify the server of a channel that a client is gone. Only the connection is started here: 
+ * the messages are written by a delivery worker, once the socket is writable (see notice_serve).
+ * 
+ * @param ch Channel whose server is notified
+ * @param id Identifier of the client
+ * @param code MESSIP_FLAG_DISMISSED or MESSIP_FLAG_DEATH_PROCESS
+ * @return 0 if no error, or -1 if an error occurred (errno is set)
+ */
+static int notify_server_death_client( channel_t * ch, messip_id_t id, int code ) {
+    death_notice_t *notice;
+    int sockfd;
+    struct epoll_event event;
+    struct sockaddr_in sockaddr;
 
-            nb = ch->nb_msg_buffered;
-            do_reply = ( nb + 1 == ch->maxnb_msg_buffered );
-            UNLOCK;
+    sockfd = socket( AF_INET, SOCK_STREAM, 0 );
+    if ( sockfd < 0 ) {
+        fprintf( stderr, "%s %d\n\tUnable to open a socket!\n", __FILE__, __LINE__ );
+        return -1;
+    }
+    fcntl( sockfd, F_SETFL, fcntl( sockfd, F_GETFL ) | O_NONBLOCK );
 
-            if ( ( dcount <= 0 ) && ( errno == ECONNRESET ) )
-                continue;
-            assert( dcount == sizeof( messip_datareply_t ) );
+    /*--- Connect socket using name specified ---*/
+    memset( &sockaddr, 0, sizeof( sockaddr ) );
+    sockaddr.sin_family = AF_INET;
+    sockaddr.sin_port = htons( ch->sin_port );
+    sockaddr.sin_addr.s_addr = ch->sin_addr;
+    if ( ( connect( sockfd, ( const struct sockaddr * ) &sockaddr, sizeof( sockaddr ) ) < 0 ) && ( errno != EINPROGRESS ) ) {
+        if ( errno != ECONNREFUSED )
+            fprintf( stderr, "%s %d\n\tUnable to connect to host %s, port %d - errno=%d\n",
+               __FILE__, __LINE__, inet_ntoa( sockaddr.sin_addr ), sockaddr.sin_port, errno );
+        if ( closesocket( sockfd ) == -1 )
+            fprintf( stderr, "Error %d while closing socket %d\n", errno, sockfd );
+        return -1;
+    }
 
-            /*--- Reply to the server, which was blocked because too many buffered messages ---*/
-            if ( do_reply ) {
-                messip_reply_buffered_send_t msgreply;
+    /*--- A fake message, then the notification ---*/
+    notice = calloc( 1, sizeof( death_notice_t ) );
+    if ( notice == NULL ) {
+        closesocket( sockfd );
+        return -1;
+    }
+    notice->sockfd = sockfd;
+    notice->datasend[0].flag = MESSIP_FLAG_CONNECTING;
+    notice->datasend[1].flag = code;
+    IDCPY( notice->datasend[1].id, id );
+    notice->datasend[1].type = -1;
+    notice->datasend[1].datalen = 0;
+
+    /*--- Written by a delivery worker ---*/
+    event.events = EPOLLOUT | EPOLLONESHOT;
+    event.data.ptr = notice;
+    if ( epoll_ctl( notice_epoll, EPOLL_CTL_ADD, sockfd, &event ) == -1 ) {
+        closesocket( sockfd );
+        free( notice );
+        return -1;
+    }
+    return 0;
 
-                msgreply.ok = MESSIP_OK;
-                msgreply.nb_msg_buffered = nb;
-                iovec[0].iov_base = &msgreply;
-                iovec[0].iov_len = sizeof( msgreply );
-                dcount = do_writev( ch->reply_on_release_sockfd, iovec, 1 );
-                assert( dcount == sizeof( msgreply ) );
-            }                   // if
+}                               // notify_server_death_client
 
-        }                       // while (nb > 0)
+/**
+ * Write a death notification, on behalf of a delivery worker: as much as the socket takes. 
+ * Once written, or if the server is gone, the connection is closed.
+ * 
+ * @param notice Notification, from notice_epoll
+ */
+static void notice_serve( death_notice_t * notice ) {
+    struct epoll_event event;
+    ssize_t dcount;
 
-    }                           // for (;;)
+    while ( notice->sent < sizeof( notice->datasend ) ) {
+        dcount = send( notice->sockfd, ( char * ) notice->datasend + notice->sent,
+           sizeof( notice->datasend ) - notice->sent, MSG_NOSIGNAL );
+        if ( ( dcount == -1 ) && ( errno == EINTR ) )
+            continue;
+        if ( ( dcount == -1 ) && ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) ) {
+            event.events = EPOLLOUT | EPOLLONESHOT;
+            event.data.ptr = notice;
+            if ( epoll_ctl( notice_epoll, EPOLL_CTL_MOD, notice->sockfd, &event ) == 0 )
+                return;
+            break;
+        }
+        if ( dcount == -1 )
+            break;              // The server is exiting too
+        notice->sent += dcount;
+    }                           // while
 
     /*--- Done ---*/
-    pthread_exit( NULL );
+    if ( closesocket( notice->sockfd ) == -1 )
+        fprintf( stderr, "Error %d while closing socket %d\n", errno, notice->sockfd );
+    free( notice );
+}                               // notice_serve
+
+/**
+ * Delivery worker: serve the channels whose buffered messages can be sent, or have been acknowledged,
+ * and write the death notifications. The number of workers does not depend on the number of channels.
+ * 
+ * @param arg Not used
+ * @return NULL
+ */
+static void *delivery_worker( void *arg ) {
+    struct epoll_event event;
+    channel_t *ch;
+    int nb;
+
+    for ( ;; ) {
+        nb = epoll_wait( delivery_epoll, &event, 1, -1 );
+        if ( nb == -1 ) {
+            if ( errno != EINTR )
+                fprintf( stderr, "%s %d\n\tepoll_wait failed - errno=%d\n", __FILE__, __LINE__, errno );
+            continue;
+        }
+        if ( nb == 0 )
+            continue;
+
+        /*--- A death notification can be written ---*/
+        if ( event.data.ptr == NULL ) {
+            if ( epoll_wait( notice_epoll, &event, 1, 0 ) == 1 )
+                notice_serve( ( death_notice_t * ) event.data.ptr );
+            continue;
+        }
+
+        /*
+         * One-shot event: no other worker serves this channel until it is armed again.
+         * It may have been armed by client_buffered_send() after the event fired, but before 
+         * the worker which got it marked the channel as busy: that worker re-arms it once done.
+         */
+        ch = ( channel_t * ) event.data.ptr;
+        CH_LOCK( ch );
+        if ( ch->delivery_destroyed || ch->delivery_busy ) {
+            CH_UNLOCK( ch );
+            continue;
+        }
+        ch->delivery_busy = 1;
+        CH_UNLOCK( ch );
+
+        delivery_serve( ch );
+
+        CH_LOCK( ch );
+        ch->delivery_busy = 0;
+        if ( ch->delivery_destroyed )
+            delivery_release( ch );
+        else if ( !ch->delivery_failed )
+            delivery_arm( ch, EPOLL_CTL_MOD );
+        CH_UNLOCK( ch );
+    }                           // for (;;)
+
+    /*--- Never exit anyway ---*/
     return NULL;
 
-}                               // thread_client_send_buffered_msg
+}                               // delivery_worker
 
 /**
  * TBD 
  * 
  * @param sockfd TBD
  * @param client_addr TBD
+ * @param body Data specific to this message, following the op
  * @return TBD
  */
-static int client_death_notify( int sockfd, struct sockaddr_in *client_addr ) {
+static int client_death_notify( int sockfd, struct sockaddr_in *client_addr, const void *body ) {
     ssize_t dcount;
     channel_t *ch;
     struct iovec iovec[1];
@@ -1298,18 +1762,8 @@ static int client_death_notify( int sockfd, struct sockaddr_in *client_addr ) {
     messip_reply_death_notify_t msgreply;
     connexion_t *cnx;
 
-    /*--- Read additional data specific to this message ---*/
-    iovec[0].iov_base = &msgsend;
-    iovec[0].iov_len = sizeof( msgsend );
-    dcount = do_readv( sockfd, iovec, 1 );
-    if ( dcount == -1 ) {
-        fprintf( stderr, "%s %d: errno=%d\n", __FILE__, __LINE__, errno );
-        return -1;
-    }
-    if ( dcount != sizeof( msgsend ) ) {
-        fprintf( stderr, "%s %d: read %d of %d - errno=%d\n", __FILE__, __LINE__, dcount, sizeof( msgsend ), errno );
-        return -1;
-    }
+    /*--- Additional data specific to this message ---*/
+    memmove( &msgsend, body, sizeof( msgsend ) );
 
 #if 0
     logg( LOG_MESSIP_NON_FATAL_ERROR, "client_death_notify: pid=%d tid=%ld status=%d\n",
@@ -1317,15 +1771,29 @@ static int client_death_notify( int sockfd, struct sockaddr_in *client_addr ) {
 #endif
 
     /*--- Update internal data ---*/
-    LOCK;
+    WRLOCK;
     ch = search_ch_by_sockfd( sockfd );
     assert( ch != NULL );
     ch->f_notify_deaths = msgsend.status;
     cnx = ch->cnx;
+    msgreply.ok = MESSIP_OK;
+    if ( ch->f_notify_deaths && ( ch->notify_index == -1 )
+       && ( array_reserve( ( void ** ) &notify_deaths, &max_notify_deaths, nb_notify_deaths, sizeof( channel_t * ) ) == -1 ) ) {
+        ch->f_notify_deaths = MESSIP_FALSE;
+        msgreply.ok = MESSIP_NOK;
+    }
+    else if ( ch->f_notify_deaths && ( ch->notify_index == -1 ) ) {
+        ch->notify_index = nb_notify_deaths;
+        notify_deaths[nb_notify_deaths++] = ch;
+    }
+    else if ( !ch->f_notify_deaths && ( ch->notify_index != -1 ) ) {
+        notify_deaths[ch->notify_index] = notify_deaths[--nb_notify_deaths];
+        notify_deaths[ch->notify_index]->notify_index = ch->notify_index;
+        ch->notify_index = -1;
+    }
     UNLOCK;
 
     /*--- Reply to the client ---*/
-    msgreply.ok = MESSIP_OK;
     iovec[0].iov_base = &msgreply;
     iovec[0].iov_len = sizeof( msgreply );
     dcount = do_writev( sockfd, iovec, 1 );
@@ -1340,121 +1808,138 @@ static int client_death_notify( int sockfd, struct sockaddr_in *client_addr ) {
  * 
  * @param sockfd TBD  
  * @param client_addr TBD
+ * @param body Data specific to this message, following the op
  * @return TBD
  */
-static int client_buffered_send( int sockfd, struct sockaddr_in *client_addr ) {
+static int client_buffered_send( int sockfd, struct sockaddr_in *client_addr, const void *body ) {
     ssize_t dcount;
     channel_t *ch;
     buffered_msg_t *bmsg;
     connexion_t *cnx;
-    pthread_attr_t attr;
     void *data;
     struct iovec iovec[1];
     messip_send_buffered_send_t msg;
     messip_reply_buffered_send_t msgreply;
+    messip_id_t id_from;
     int nb;
-    int do_reply;
+    int do_reply, new_connection;
     struct sockaddr_in sockaddr;
 
-    /*--- Read additional data specific to this message ---*/
-    iovec[0].iov_base = &msg;
-    iovec[0].iov_len = sizeof( msg );
-    dcount = do_readv( sockfd, iovec, 1 );
-    if ( dcount == -1 ) {
-        fprintf( stderr, "%s %d: errno=%d\n", __FILE__, __LINE__, errno );
-        return -1;
-    }
-    if ( dcount != sizeof( msg ) ) {
-        fprintf( stderr, "%s %d: read %d of %d - errno=%d\n", __FILE__, __LINE__, dcount, sizeof( msg ), errno );
-        return -1;
-    }
+    /*--- Additional data specific to this message ---*/
+    memmove( &msg, body, sizeof( msg ) );
 
-    /*--- Read the private message ---*/
+    /*--- The private message follows ---*/
     if ( msg.datalen == 0 ) {
         data = NULL;
     }
     else {
         data = malloc( msg.datalen );
-        dcount = read( sockfd, data, msg.datalen );
-        if ( dcount != msg.datalen ) {
-            fprintf( stderr, "Should have read %d bytes - only %d have been read\n", msg.datalen, dcount );
-            return -1;
-        }
+        memmove( data, ( const char * ) body + sizeof( msg ), msg.datalen );
     }
 
 #if 0
     logg( "client_buffered_send: pid=%d tid=%d type=%d %d [%s]\n", msg.pid_from, msg.tid_from, msg.type, msg.datalen, data );
 #endif
 
-    /*--- Create a thread to manage buffered messages ? ---*/
-    LOCK;
-    ch = search_ch_by_sockfd( msg.mgr_sockfd );
+    /*--- Channel the message is sent to, and its sender ---*/
+    RDLOCK;
+    ch = search_ch_by_handle( msg.handle );
+    cnx = search_cnx_by_sockfd( sockfd );
+    IDCPY( id_from, ( cnx != NULL ) ? cnx->id : "" );
+    UNLOCK;
     if ( ch == NULL ) {
-        UNLOCK;
-        fprintf( stderr, "%s: socket %d not found\n", __FUNCTION__, msg.mgr_sockfd );
+        fprintf( stderr, "%s: channel %llx not found\n", __FUNCTION__, ( unsigned long long ) msg.handle );
+        free( data );
         return -1;
     }
+    CH_LOCK( ch );
     cnx = ch->cnx;
 
-    /*--- Create socket then connection ---*/
-    if ( ch->bufferedsend_sockfd == 0 ) {
-        messip_datasend_t datasend;
-        struct iovec iovec[1];
-        ssize_t dcount;
+    /*--- The server is gone, or the channel has been destroyed since it was looked up: the message is discarded ---*/
+    if ( ch->delivery_failed || ch->delivery_destroyed ) {
+        nb = ch->nb_msg_buffered;
+        CH_UNLOCK( ch );
+        free( data );
+        msgreply.ok = MESSIP_OK;
+        msgreply.nb_msg_buffered = nb;
+        iovec[0].iov_base = &msgreply;
+        iovec[0].iov_len = sizeof( msgreply );
+        dcount = do_writev( sockfd, iovec, 1 );
+        assert( dcount == sizeof( msgreply ) );
+        return 0;
+    }
+
+    /*--- Create socket then connection: a delivery worker writes once it is established ---*/
+    new_connection = ( ch->bufferedsend_sockfd == 0 );
+    if ( new_connection ) {
+        delivery_batch_t *batch;
 
         ch->bufferedsend_sockfd = socket( AF_INET, SOCK_STREAM, 0 );
         if ( ch->bufferedsend_sockfd < 0 ) {
-            UNLOCK;
+            CH_UNLOCK( ch );
             fprintf( stderr, "%s %d\n\tUnable to open a socket!\n", __FILE__, __LINE__ );
+            free( data );
             return -1;
         }
 
+        /*--- From now on, neither this thread nor the delivery workers wait for the server ---*/
+        fcntl( ch->bufferedsend_sockfd, F_SETFL, fcntl( ch->bufferedsend_sockfd, F_GETFL ) | O_NONBLOCK );
+
         /*--- Connect socket using name specified ---*/
         memset( &sockaddr, 0, sizeof( sockaddr ) );
         sockaddr.sin_family = AF_INET;
         sockaddr.sin_port = htons( ch->sin_port );
         sockaddr.sin_addr.s_addr = ch->sin_addr;
-        if ( connect( ch->bufferedsend_sockfd, ( const struct sockaddr * ) &sockaddr, sizeof( sockaddr ) ) < 0 ) {
-            UNLOCK;
+        batch = calloc( 1, sizeof( delivery_batch_t ) );
+        if ( ( batch == NULL )
+           || ( ( connect( ch->bufferedsend_sockfd, ( const struct sockaddr * ) &sockaddr, sizeof( sockaddr ) ) < 0 )
+              && ( errno != EINPROGRESS ) ) ) {
             fprintf( stderr, "%s %d\n\tUnable to connect to host %s, port %d - errno=%d\n",
                __FILE__, __LINE__, inet_ntoa( sockaddr.sin_addr ), sockaddr.sin_port, errno );
             if ( closesocket( ch->bufferedsend_sockfd ) == -1 )
                 fprintf( stderr, "Error %d while closing socket %d\n", errno, ch->bufferedsend_sockfd );
+            ch->bufferedsend_sockfd = 0;
+            CH_UNLOCK( ch );
+            free( batch );
+            free( data );
             return -1;
         }
 
-        /*--- Send a fake message ---*/
-        datasend.flag = MESSIP_FLAG_CONNECTING;
-        iovec[0].iov_base = &datasend;
-        iovec[0].iov_len = sizeof( datasend );
-        dcount = do_writev( ch->bufferedsend_sockfd, iovec, 1 );
-        assert( dcount == sizeof( datasend ) );
+        /*--- A fake message first ---*/
+        batch->connecting.flag = MESSIP_FLAG_CONNECTING;
+        batch->iovec[0].iov_base = &batch->connecting;
+        batch->iovec[0].iov_len = sizeof( messip_datasend_t );
+        batch->first = 0;
+        batch->iovcnt = 1;
+        ch->delivery_batch = batch;
 
     }                           // if
 
-    /*--- Update internal queue, managed by the thread client_send_buffered_msg ---*/
-    bmsg = malloc( sizeof( buffered_msg_t ) );
+    /*--- Update internal queue, served by the delivery workers ---*/
+    nb = ch->nb_msg_buffered;
+    if ( ( nb == ch->size_msg_buffered ) && ( buffered_msg_grow( ch ) == -1 ) ) {
+        CH_UNLOCK( ch );
+        fprintf( stderr, "%s: unable to queue a message on channel %s\n", __FUNCTION__, ch->channel_name );
+        free( data );
+        return -1;
+    }
+    bmsg = &ch->buffered_msg[( ch->head_msg_buffered + nb ) & ( ch->size_msg_buffered - 1 )];
     bmsg->type = msg.type;
-    IDCPY( bmsg->id_from, msg.id_from );
+    IDCPY( bmsg->id_from, id_from );
     IDCPY( bmsg->id_to, cnx->id );
     bmsg->datalen = msg.datalen;
     bmsg->data = data;
-    if ( ( nb = ch->nb_msg_buffered ) == 0 )
-        ch->buffered_msg = malloc( sizeof( buffered_msg_t * ) );
-    else
-        ch->buffered_msg = realloc( ch->buffered_msg, sizeof( buffered_msg_t * ) * ( ch->nb_msg_buffered + 1 ) );
-    ch->buffered_msg[ch->nb_msg_buffered++] = bmsg;
+    ch->nb_msg_buffered++;
     do_reply = ( ch->nb_msg_buffered < ch->maxnb_msg_buffered );
-    UNLOCK;
-
-    if ( ch->tid_client_send_buffered_msg == 0 ) {
-        pthread_attr_init( &attr );
-        pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
-        pthread_create( &ch->tid_client_send_buffered_msg, &attr, thread_client_send_buffered_msg, ch );
-    }                           // if
+    if ( !do_reply )
+        ch->reply_on_release_sockfd = sockfd;
 
-    /*--- Signal the buffered msg send thread that there is something ---*/
-    pthread_kill( ch->tid_client_send_buffered_msg, SIGUSR2 );
+    /*--- Have a delivery worker send it (if one is serving the channel, it arms it once done) ---*/
+    if ( new_connection )
+        delivery_arm( ch, EPOLL_CTL_ADD );
+    else if ( !ch->delivery_busy )
+        delivery_arm( ch, EPOLL_CTL_MOD );
+    CH_UNLOCK( ch );
 
     /*--- Reply to the client ---*/
     if ( do_reply ) {
@@ -1465,9 +1950,6 @@ static int client_buffered_send( int sockfd, struct sockaddr_in *client_addr ) {
         dcount = do_writev( sockfd, iovec, 1 );
         assert( dcount == sizeof( msgreply ) );
     }                           // if
-    else {
-        ch->reply_on_release_sockfd = sockfd;
-    }
 
     return 0;
 
@@ -1479,43 +1961,44 @@ static int client_buffered_send( int sockfd, struct sockaddr_in *client_addr ) {
  * @param sockfd TBD
  * @param client_addr TBD
  * @param op TBD
+ * @param body Data specific to this message, following the op
  * @param new_cnx TBD
  * @return TBD
  */
-static int handle_client_msg( int sockfd, struct sockaddr_in *client_addr, int32_t op, connexion_t ** new_cnx ) {
+static int handle_client_msg( int sockfd, struct sockaddr_in *client_addr, int32_t op, const void *body, connexion_t ** new_cnx ) {
 
     switch ( op ) {
 
         case MESSIP_OP_CONNECT:
-            handle_client_connect( sockfd, client_addr, new_cnx );
+            handle_client_connect( sockfd, client_addr, body, new_cnx );
             return 1;
 
         case MESSIP_OP_CHANNEL_CREATE:
-            client_channel_create( sockfd, client_addr, new_cnx );
+            client_channel_create( sockfd, client_addr, body, new_cnx );
             return 1;
 
         case MESSIP_OP_CHANNEL_DELETE:
-            client_channel_delete( sockfd, client_addr );
+            client_channel_delete( sockfd, client_addr, body );
             return 1;
 
         case MESSIP_OP_CHANNEL_CONNECT:
-            client_channel_connect( sockfd, client_addr );
+            client_channel_connect( sockfd, client_addr, body );
             return 1;
 
         case MESSIP_OP_CHANNEL_DISCONNECT:
-            client_channel_disconnect( sockfd, client_addr );
+            client_channel_disconnect( sockfd, client_addr, body );
             return 1;
 
         case MESSIP_OP_BUFFERED_SEND:
-            client_buffered_send( sockfd, client_addr );
+            client_buffered_send( sockfd, client_addr, body );
             return 1;
 
         case MESSIP_OP_DEATH_NOTIFY:
-            client_death_notify( sockfd, client_addr );
+            client_death_notify( sockfd, client_addr, body );
             return 1;
 
         case MESSIP_OP_SIN:
-            LOCK;
+            RDLOCK;
             debug_show(  );
             UNLOCK;
             return 0;
@@ -1530,216 +2013,229 @@ static int handle_client_msg( int sockfd, struct sockaddr_in *client_addr, int32
 }                               // handle_client_msg
 
 /**
- * TBD 
+ * Length of the data following an op, which must be received before handling the message
  * 
- * @param ch TBD
- * @param id TBD
- * @param code TBD
- * @return TBD
+ * @param op Code of the message
+ * @param body Data received so far after the op
+ * @param len Number of bytes in body
+ * @return Number of bytes, or -1 if the message is invalid
  */
-static int notify_server_death_client( channel_t * ch, messip_id_t id, int code ) {
-    messip_datasend_t datasend;
-    int sockfd;
-    struct iovec iovec[1];
-    int status;
-    ssize_t dcount;
-    fd_set ready;
-    struct sockaddr_in sockaddr;
-
-    sockfd = socket( AF_INET, SOCK_STREAM, 0 );
-    if ( sockfd < 0 ) {
-        fprintf( stderr, "%s %d\n\tUnable to open a socket!\n", __FILE__, __LINE__ );
-        return -1;
-    }
-
-    /*--- Connect socket using name specified ---*/
-    memset( &sockaddr, 0, sizeof( sockaddr ) );
-    sockaddr.sin_family = AF_INET;
-    sockaddr.sin_port = htons( ch->sin_port );
-    sockaddr.sin_addr.s_addr = ch->sin_addr;
-    if ( connect( sockfd, ( const struct sockaddr * ) &sockaddr, sizeof( sockaddr ) ) < 0 ) {
-        if ( errno != ECONNREFUSED )
-            fprintf( stderr, "%s %d\n\tUnable to connect to host %s, port %d - errno=%d\n",
-               __FILE__, __LINE__, inet_ntoa( sockaddr.sin_addr ), sockaddr.sin_port, errno );
-        if ( closesocket( sockfd ) == -1 )
-            fprintf( stderr, "Error %d while closing socket %d\n", errno, sockfd );
-        return -1;
-    }
-
-    /*--- Wait until enable to write ---*/
-    FD_ZERO( &ready );
-    FD_SET( sockfd, &ready );
-    status = select( FD_SETSIZE, NULL, &ready, NULL, NULL );
-
-    /*--- Send a fake message ---*/
-    memset( &datasend, 0, sizeof( messip_datasend_t ) );
-    datasend.flag = MESSIP_FLAG_CONNECTING;
-    iovec[0].iov_base = &datasend;
-    iovec[0].iov_len = sizeof( datasend );
-    dcount = do_writev( sockfd, iovec, 1 );
-    assert( dcount == sizeof( datasend ) );
-
-    /*--- Message to send ---*/
-    datasend.flag = code;
-    IDCPY( datasend.id, id );
-    datasend.type = -1;
-    datasend.datalen = 0;
+static int request_length( int32_t op, const char *body, int len ) {
+    messip_send_buffered_send_t msg;
 
-    /*--- Send a message to the 'server' ---*/
-    iovec[0].iov_base = &datasend;
-    iovec[0].iov_len = sizeof( datasend );
-    dcount = do_writev( sockfd, iovec, 1 );
-//  assert( dcount == sizeof( datasend ) );
+    switch ( op ) {
+        case MESSIP_OP_CONNECT:
+            return sizeof( messip_send_connect_t );
+        case MESSIP_OP_CHANNEL_CREATE:
+            return sizeof( messip_send_channel_create_t );
+        case MESSIP_OP_CHANNEL_DELETE:
+            return sizeof( messip_send_channel_delete_t );
+        case MESSIP_OP_CHANNEL_CONNECT:
+            return sizeof( messip_send_channel_connect_t );
+        case MESSIP_OP_CHANNEL_DISCONNECT:
+            return sizeof( messip_send_channel_disconnect_t );
+        case MESSIP_OP_DEATH_NOTIFY:
+            return sizeof( messip_send_death_notify_t );
 
-    /*--- ok ---*/
-    if ( closesocket( sockfd ) == -1 )
-        fprintf( stderr, "Error %d while closing socket %d\n", errno, sockfd );
-    return 0;
+        case MESSIP_OP_BUFFERED_SEND:
+            if ( len < sizeof( msg ) )
+                return sizeof( msg );
+            memmove( &msg, body, sizeof( msg ) );
+            if ( msg.datalen < 0 )
+                return -1;
+            return sizeof( msg ) + msg.datalen;
 
-}                               // notify_server_death_client
+        default:
+            return 0;           // MESSIP_OP_SIN, or unknown (reported by handle_client_msg)
+    }                           // switch (op)
+}                               // request_length
 
 /**
- * TBD 
+ * The socket of a client is readable: receive what is available, then handle all the complete messages
  * 
- * @param arg TBD
- * @return TBD
+ * @param descr Connection with the client
+ * @return 0 if no error, or -1 if the connection must be closed
  */
-static void *thread_client_thread( void *arg ) {
-    clientdescr_t *descr = ( clientdescr_t * ) arg;
+static int client_receive( clientdescr_t * descr ) {
     ssize_t dcount;
     int32_t op;
-    int index, found;
-    connexion_t *new_cnx, **cnx, *connexion;
-    channel_t **ch, *channel;
-    int k;
-    struct iovec iovec[1];
-    messip_id_t id;
-    int search_socket = 0;
+    int offset, len, needed;
 
-#if 0
-    logg( LOG_MESSIP_NON_FATAL_ERROR, "thread_client_thread: pid=%d tid=%ld\n", getpid(  ), pthread_self(  ) );
-#endif
-
-    for ( new_cnx = NULL;; ) {
-
-        iovec[0].iov_base = &op;
-        iovec[0].iov_len = sizeof( int32_t );
-        dcount = do_readv( descr->sockfd_accept, iovec, 1 );
-        if ( dcount <= 0 )
-            break;
-
-        if ( dcount != sizeof( int32_t ) ) {
-            fprintf( stderr, "%s %d:\n\tread %d byte[%08X], should have read %d bytes\n",
-               __FILE__, __LINE__, dcount, op, sizeof( int32_t ) );
+    /*--- Read what is available, without blocking ---*/
+    if ( descr->rx_len == descr->rx_size ) {
+        char *buffer = realloc( descr->rx_buffer, descr->rx_size * 2 );
+        if ( buffer == NULL )
+            return -1;
+        descr->rx_buffer = buffer;
+        descr->rx_size *= 2;
+    }
+    dcount = recv( descr->sockfd_accept, descr->rx_buffer + descr->rx_len, descr->rx_size - descr->rx_len, MSG_DONTWAIT );
+    if ( ( dcount == -1 ) && ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) || ( errno == EINTR ) ) )
+        return 0;
+    if ( dcount <= 0 )
+        return -1;
+    descr->rx_len += dcount;
+
+    /*--- Handle the complete messages ---*/
+    for ( offset = 0, needed = 0; descr->rx_len - offset >= sizeof( int32_t ); ) {
+        memmove( &op, descr->rx_buffer + offset, sizeof( int32_t ) );
+        len = descr->rx_len - offset - sizeof( int32_t );
+        needed = request_length( op, descr->rx_buffer + offset + sizeof( int32_t ), len );
+        if ( needed == -1 )
+            return -1;
+        if ( len < needed )
             break;
+        if ( handle_client_msg( descr->sockfd_accept, &descr->client_addr, op,
+              descr->rx_buffer + offset + sizeof( int32_t ), &descr->new_cnx ) )
+            descr->search_socket = 1;
+        offset += sizeof( int32_t ) + needed;
+        needed = 0;
+    }                           // for (offset)
+
+    /*--- Keep the beginning of the next message ---*/
+    descr->rx_len -= offset;
+    if ( offset && descr->rx_len )
+        memmove( descr->rx_buffer, descr->rx_buffer + offset, descr->rx_len );
+    if ( sizeof( int32_t ) + needed > descr->rx_size ) {
+        char *buffer = realloc( descr->rx_buffer, sizeof( int32_t ) + needed );
+        if ( buffer == NULL )
+            return -1;
+        descr->rx_buffer = buffer;
+        descr->rx_size = sizeof( int32_t ) + needed;
+    }
+    else if ( ( descr->rx_len == 0 ) && ( descr->rx_size > RX_BUFFER_MAXKEEP ) ) {
+        char *buffer = realloc( descr->rx_buffer, RX_BUFFER_SIZE );
+        if ( buffer != NULL ) {
+            descr->rx_buffer = buffer;
+            descr->rx_size = RX_BUFFER_SIZE;
         }
+    }
 
-        search_socket = handle_client_msg( descr->sockfd_accept, &descr->client_addr, op, &new_cnx );
+    return 0;
+}                               // client_receive
 
-    }                           // for (;;)
+/**
+ * The connection with a client has been closed: forget it, and all its channels
+ * 
+ * @param descr Connection with the client
+ */
+static void client_close( clientdescr_t * descr ) {
+    int index;
+    connexion_t *connexion;
+    channel_t *channel;
+    int k;
+    messip_id_t id;
+    channel_t **notify;
+    int *notify_code, nb_notify;
 
     /*--- Close the connection ---*/
     shutdown( descr->sockfd_accept, SHUT_RDWR );
+    free( descr->rx_buffer );
 
-    if ( !search_socket ) {
+    if ( !descr->search_socket ) {
         if ( close( descr->sockfd_accept ) == -1 )
             fprintf( stderr, "Error %d while closing socket %d\n", errno, descr->sockfd_accept );
         free( descr );
-        pthread_exit( NULL );
-        return NULL;
+        return;
     }
 
     /*--- Destroy this connection ---*/
-    LOCK;
-    for ( cnx = connexions, found = 0, index = 0; index < nb_connexions; index++, cnx++ ) {
-        if ( ( *cnx )->sockfd == descr->sockfd_accept ) {
-            found = 1;
-            break;
-        }
-    }
-    if ( !found ) {
+    WRLOCK;
+    connexion = search_cnx_by_sockfd( descr->sockfd_accept );
+    if ( connexion == NULL ) {
         fprintf( stderr, "%s %d:\n\tfound should be true\n", __FILE__, __LINE__ );
         UNLOCK;
         if ( close( descr->sockfd_accept ) == -1 )
             fprintf( stderr, "Error %d while closing socket %d\n", errno, descr->sockfd_accept );
         free( descr );
-        pthread_exit( NULL );
-        return NULL;
+        return;
     }
-    connexion = connexions[index];
 
     logg( LOG_MESSIP_INFORMATIVE, "Destroy connexion #%d sockfd=%-3d id=%s [%s]\n",
-       index, connexion->sockfd, connexion->id, connexion->process_name );
+       connexion->index, connexion->sockfd, connexion->id, connexion->process_name );
     if ( closesocket( connexion->sockfd ) == -1 )
         fprintf( stderr, "Unable to close socket %d: errno=%d\n", connexion->sockfd, errno );
     IDCPY( id, connexion->id );
-    for ( k = index + 1; k < nb_connexions; k++ )
-        connexions[k - 1] = connexions[k];
-    if ( connexion->nb_cnx_channels )
-        free( connexion->sockfd_cnx_channels );
-    free( connexion );
-    if ( --nb_connexions == 0 )
-        connexions = NULL;
+    sockfd_index_set( &connexions_by_sockfd, connexion->sockfd, NULL );
+    connexions[connexion->index] = connexions[--nb_connexions];
+    connexions[connexion->index]->index = connexion->index;
+
+    /*--- The notifications are sent once the lock is released ---*/
+    notify = malloc( ( connexion->nb_cnx_channels + nb_notify_deaths + 1 ) * sizeof( channel_t * ) );
+    notify_code = malloc( ( connexion->nb_cnx_channels + nb_notify_deaths + 1 ) * sizeof( int ) );
+    nb_notify = 0;
 
     /*--- Notify all owners of connected channels that this client dismissed ---*/
-    for ( index = 0; index < nb_channels; index++ ) {
-        int nb, new_nb;
-
-        channel = channels[index];
-        for ( nb = 0, k = 0; k < channel->nb_clients; k++ ) {
-            if ( channel->cnx_clients[k] == descr->sockfd_accept ) {
-                notify_server_death_client( channel, id, MESSIP_FLAG_DISMISSED );
-                nb++;
-            }                   // if
-        }                       // for (k)
-        new_nb = channel->nb_clients - nb;
-        if ( new_nb == 0 ) {
-            channel->nb_clients = 0;
-            free( channel->cnx_clients );
-            channel->cnx_clients = NULL;
-        }
-        else {
-            int w, *clients;
-            clients = malloc( sizeof( int ) * new_nb );
-            for ( w = 0, k = 0; k < channel->nb_clients; k++ ) {
-                if ( channel->cnx_clients[k] != descr->sockfd_accept )
-                    clients[w++] = channel->cnx_clients[k];
-            }                   // for (k)
-            assert( w == new_nb );
-            channel->nb_clients = new_nb;
-            free( channel->cnx_clients );
-            channel->cnx_clients = clients;
-        }
-    }                           // for (index)
+    MEMBERSHIP_LOCK;
+    while ( connexion->nb_cnx_channels > 0 ) {
+        cnx_channel_t m = connexion->cnx_channels[connexion->nb_cnx_channels - 1];
 
-    /*--- Notify other processes (optional) that this process is now dead---*/
-    for ( ch = channels, index = 0; index < nb_channels; index++, ch++ ) {
-        if ( ( *ch )->cnx == connexion )
-            continue;
+        notify[nb_notify] = m.ch;
+        notify_code[nb_notify++] = MESSIP_FLAG_DISMISSED;
+        membership_remove( m.ch, m.index );
+    }                           // while
+    MEMBERSHIP_UNLOCK;
 
-        channel = channels[index];
-        if ( !channel->f_notify_deaths )
+    /*--- Notify other processes (optional) that this process is now dead---*/
+    for ( index = 0; index < nb_notify_deaths; index++ ) {
+        channel = notify_deaths[index];
+        if ( channel->cnx == connexion )
             continue;
-
-        notify_server_death_client( channel, id, MESSIP_FLAG_DEATH_PROCESS );
-
+        notify[nb_notify] = channel;
+        notify_code[nb_notify++] = MESSIP_FLAG_DEATH_PROCESS;
     }                           // for (index)
 
     /*--- Destroy all channels related to this connection, if any ---*/
-    for ( ch = channels, index = 0; index < nb_channels; index++, ch++ ) {
-        if ( ( *ch )->cnx == connexion ) {
-            channel = channels[index];
-            destroy_channel( channel, index );
-            index--;
-        }                       // if
-    }                           // for (ch)
+    while ( connexion->nb_owned_channels > 0 )
+        destroy_channel( connexion->owned_channels[connexion->nb_owned_channels - 1] );
     UNLOCK;
 
+    free( connexion->cnx_channels );
+    free( connexion->owned_channels );
+    free( connexion );
+
+    /*--- Channels are never freed: they can be used without the lock ---*/
+    for ( k = 0; k < nb_notify; k++ )
+        notify_server_death_client( notify[k], id, notify_code[k] );
+    free( notify );
+    free( notify_code );
+
     /*--- Done ---*/
     free( descr );
+}                               // client_close
+
+/**
+ * Reactor thread: handle the messages of the clients it has been given by main()
+ * 
+ * @param arg epoll descriptor of this reactor
+ * @return NULL
+ */
+static void *reactor_thread( void *arg ) {
+    int epoll_fd = *( int * ) arg;
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    int nb, n;
+
+    for ( ;; ) {
+        nb = epoll_wait( epoll_fd, events, REACTOR_MAX_EVENTS, -1 );
+        if ( nb == -1 ) {
+            if ( errno == EINTR )
+                continue;
+            fprintf( stderr, "%s %d:\n\tepoll_wait failed - errno=%d\n", __FILE__, __LINE__, errno );
+            break;
+        }
+
+        for ( n = 0; n < nb; n++ ) {
+            clientdescr_t *descr = ( clientdescr_t * ) events[n].data.ptr;
+            if ( client_receive( descr ) == 0 )
+                continue;
+            epoll_ctl( epoll_fd, EPOLL_CTL_DEL, descr->sockfd_accept, NULL );
+            client_close( descr );
+        }                       // for (n)
+    }                           // for (;;)
+
     pthread_exit( NULL );
     return NULL;
-}                               // thread_client_thread
+}                               // reactor_thread
 
 /**
  * TBD 
@@ -1752,11 +2248,11 @@ static void sigint_sighandler( int signum ) {
     channel_t *ch;
     int index;
 
-    LOCK;
+    WRLOCK;
 
-    for ( index = 0; index < nb_channels; index++ ) {
+    for ( index = nb_channels - 1; index >= 0; index-- ) {
         ch = channels[index];
-        destroy_channel( ch, index );
+        destroy_channel( ch );
     }                           // for
 
     for ( index = 0; index < nb_connexions; index++ ) {
@@ -1774,9 +2270,11 @@ static void sigint_sighandler( int signum ) {
  * TBD 
  */
 static void help( void ) {
-    printf( "messip-mgr [-p] [-l]\n" );
+    printf( "messip-mgr [-p] [-l] [-r] [-w]\n" );
     printf( "-p port : TCP port used between the library and the manager\n" );
     printf( "-l n    : logging value\n" );
+    printf( "-r n    : number of threads serving the clients (default %d)\n", MESSIP_MGR_REACTORS );
+    printf( "-w n    : number of threads delivering the buffered messages (default %d)\n", MESSIP_MGR_DELIVERY_WORKERS );
     exit( -1 );
 }                               // help
 
@@ -1792,6 +2290,8 @@ static void get_options( int argc, char *argv[] ) {
     static struct option long_options[] = {
         {"port", 1, NULL, 'p'},
         {"log", 1, NULL, 'l'},
+        {"reactors", 1, NULL, 'r'},
+        {"workers", 1, NULL, 'w'},
         {NULL, 0, NULL, 0}
     };
 
@@ -1803,8 +2303,10 @@ static void get_options( int argc, char *argv[] ) {
 
     /*--- Any parameter ? ---*/
     logg_dir = NULL;
+    nb_reactors = MESSIP_MGR_REACTORS;
+    nb_delivery_workers = MESSIP_MGR_DELIVERY_WORKERS;
     for ( ;; ) {
-        c = getopt_long( argc, argv, "p:l:", long_options, &option_index );
+        c = getopt_long( argc, argv, "p:l:r:w:", long_options, &option_index );
         if ( c == -1 )
             break;
 //      printf( "c=%d option_index=%d arg=[%s]\n", c, option_index, optarg );
@@ -1815,6 +2317,16 @@ static void get_options( int argc, char *argv[] ) {
             case 'l':
                 logg_dir = optarg;
                 break;
+            case 'r':
+                nb_reactors = atoi( optarg );
+                if ( nb_reactors < 1 )
+                    help(  );
+                break;
+            case 'w':
+                nb_delivery_workers = atoi( optarg );
+                if ( nb_delivery_workers < 1 )
+                    help(  );
+                break;
             case 'h':
                 messip_port_http = atoi( optarg );
                 break;
@@ -1838,13 +2350,12 @@ static void get_options( int argc, char *argv[] ) {
  *  @return 0 if no error
  */
 int main( int argc, char *argv[] ) {
-    int sockfd;
+    int sockfd, index;
     struct sockaddr_in server_addr;
     int status;
     pthread_t tid;
     pthread_attr_t attr;
     struct sigaction sa;
-    sigset_t set;
 
     fprintf( stdout, "To stop It:    kill -s SIGINT  %d\n", getpid(  ) );
     f_bye = 0;                  // Set to 1 when SIGINT has been applied
@@ -1852,9 +2363,12 @@ int main( int argc, char *argv[] ) {
 
     // Initialize active connexions and channels
     nb_connexions = 0;
+    max_connexions = 0;
     connexions = NULL;
     nb_channels = 0;
+    max_channels = 0;
     channels = NULL;
+    channels_by_name = messip_hash_create( 0 );
 
     // Register a function that clean-up opened sockets when exiting
     sa.sa_handler = sigint_sighandler;
@@ -1862,13 +2376,13 @@ int main( int argc, char *argv[] ) {
     sigemptyset( &sa.sa_mask );
     sigaction( SIGINT, &sa, NULL );
 
-    sigemptyset( &set );
-    sigaddset( &set, SIGUSR2 );
-    pthread_sigmask( SIG_BLOCK, &set, NULL );
+    // A client or a server may exit while being written to
+    sa.sa_handler = SIG_IGN;
+    sigaction( SIGPIPE, &sa, NULL );
 
-    // Create a mutex, in order to protect shared table of data
-    if ( pthread_mutex_init( &mutex, NULL ) == -1 ) {
-        fprintf( stderr, "%s %d\n\tUnable to initialize mutex - errno=%d\n", __FILE__, __LINE__, errno );
+    // Create a reader-writer lock, in order to protect shared table of data
+    if ( pthread_rwlock_init( &registry_lock, NULL ) != 0 ) {
+        fprintf( stderr, "%s %d\n\tUnable to initialize lock - errno=%d\n", __FILE__, __LINE__, errno );
         return -1;
     }
 
@@ -1899,7 +2413,7 @@ int main( int argc, char *argv[] ) {
         return -1;
     }
 
-    listen( sockfd, 8 );
+    listen( sockfd, SOMAXCONN );
 
     // Create a specific thread to debug information (apply SIGUSR1)
     pthread_attr_init( &attr );
@@ -1911,15 +2425,55 @@ int main( int argc, char *argv[] ) {
     pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
     pthread_create( &tid, &attr, &http_thread, NULL );
 
-    for ( ; !f_bye; ) {
+    // Create the reactor threads, which serve the clients
+    reactors = malloc( nb_reactors * sizeof( int ) );
+    for ( index = 0; index < nb_reactors; index++ ) {
+        reactors[index] = epoll_create1( EPOLL_CLOEXEC );
+        if ( reactors[index] == -1 ) {
+            fprintf( stderr, "%s %d\n\tUnable to create an epoll descriptor - errno=%d\n", __FILE__, __LINE__, errno );
+            return -1;
+        }
+        pthread_attr_init( &attr );
+        pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+        pthread_create( &tid, &attr, &reactor_thread, &reactors[index] );
+    }                           // for (index)
+
+    // Create the delivery workers, which send the buffered messages
+    delivery_epoll = epoll_create1( EPOLL_CLOEXEC );
+    if ( delivery_epoll == -1 ) {
+        fprintf( stderr, "%s %d\n\tUnable to create an epoll descriptor - errno=%d\n", __FILE__, __LINE__, errno );
+        return -1;
+    }
+    notice_epoll = epoll_create1( EPOLL_CLOEXEC );
+    if ( notice_epoll != -1 ) {
+        struct epoll_event event;
+
+        event.events = EPOLLIN;
+        event.data.ptr = NULL;
+        if ( epoll_ctl( delivery_epoll, EPOLL_CTL_ADD, notice_epoll, &event ) == -1 ) {
+            close( notice_epoll );
+            notice_epoll = -1;
+        }
+    }
+    if ( notice_epoll == -1 ) {
+        fprintf( stderr, "%s %d\n\tUnable to create an epoll descriptor - errno=%d\n", __FILE__, __LINE__, errno );
+        return -1;
+    }
+    for ( index = 0; index < nb_delivery_workers; index++ ) {
+        pthread_attr_init( &attr );
+        pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+        pthread_create( &tid, &attr, &delivery_worker, NULL );
+    }                           // for (index)
+
+    for ( index = 0; !f_bye; ) {
         clientdescr_t *descr;
-        pthread_t tid;
-        pthread_attr_t attr;
+        struct epoll_event event;
 
         descr = malloc( sizeof( clientdescr_t ) );
         descr->client_addr_len = sizeof( struct sockaddr_in );
         descr->sockfd_accept = accept( sockfd, ( struct sockaddr * ) &descr->client_addr, &descr->client_addr_len );
         if ( descr->sockfd_accept == -1 ) {
+            free( descr );
             if ( errno == EINTR )   // A signal has been applied
                 continue;
             fprintf( stderr, "Socket non accepted - errno=%d\n", errno );
@@ -1931,9 +2485,23 @@ int main( int argc, char *argv[] ) {
         logg( LOG_MESSIP_DEBUG_LEVEL1, "accepted a msg from %s, port=%d, socket=%d\n",
            inet_ntoa( descr->client_addr.sin_addr ), descr->client_addr.sin_port, descr->sockfd_accept );
 #endif
-        pthread_attr_init( &attr );
-        pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
-        pthread_create( &tid, &attr, &thread_client_thread, descr );
+        descr->rx_buffer = malloc( RX_BUFFER_SIZE );
+        descr->rx_len = 0;
+        descr->rx_size = RX_BUFFER_SIZE;
+        descr->new_cnx = NULL;
+        descr->search_socket = 0;
+
+        /*--- Give this client to the next reactor thread ---*/
+        event.events = EPOLLIN;
+        event.data.ptr = descr;
+        if ( epoll_ctl( reactors[index], EPOLL_CTL_ADD, descr->sockfd_accept, &event ) == -1 ) {
+            fprintf( stderr, "%s %d\n\tepoll_ctl failed - errno=%d\n", __FILE__, __LINE__, errno );
+            close( descr->sockfd_accept );
+            free( descr->rx_buffer );
+            free( descr );
+            continue;
+        }
+        index = ( index + 1 ) % nb_reactors;
     }                           // for (;;)
 
     if ( closesocket( sockfd ) == -1 )